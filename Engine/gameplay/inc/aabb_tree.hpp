@@ -0,0 +1,245 @@
+#pragma once
+
+#include "camera.hpp"
+#include "material.hpp"
+#include "non_copyable.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace Humongous
+{
+/***
+ * dynamic bounding volume hierarchy over world space boxes, each leaf is a proxy carrying some user data (game object ids).
+ * leaves store their box fattened by a margin, so objects moving a little don't touch the tree at all. once a box leaves its
+ * fattened one the leaf is reinserted and the tree is rebalanced with rotations on the way back up.
+ * queries walk the hierarchy, whole subtrees are rejected (or accepted) with a single test
+ * */
+class AABBTree : NonCopyable
+{
+public:
+    static constexpr s32 NULL_NODE = -1;
+
+    // owns a proxy, it leaves the tree together with the handle. moving the handle hands the proxy over
+    class ProxyHandle
+    {
+    public:
+        ProxyHandle() = default;
+        ProxyHandle(AABBTree* tree, s32 proxy) : m_tree{tree}, m_proxy{proxy} {}
+        ~ProxyHandle() { Reset(); }
+
+        ProxyHandle(const ProxyHandle&) = delete;
+        ProxyHandle& operator=(const ProxyHandle&) = delete;
+        ProxyHandle(ProxyHandle&& other) noexcept : m_tree{other.m_tree}, m_proxy{other.m_proxy} { other.Release(); }
+        ProxyHandle& operator=(ProxyHandle&& other) noexcept
+        {
+            if(this != &other)
+            {
+                Reset();
+                m_tree = other.m_tree;
+                m_proxy = other.m_proxy;
+                other.Release();
+            }
+            return *this;
+        }
+
+        void Reset()
+        {
+            if(m_tree) { m_tree->DestroyProxy(m_proxy); }
+            Release();
+        }
+
+        AABBTree* GetTree() const { return m_tree; }
+        s32       Get() const { return m_proxy; }
+        explicit  operator bool() const { return m_tree != nullptr; }
+
+    private:
+        AABBTree* m_tree{nullptr};
+        s32       m_proxy{NULL_NODE};
+
+        void Release()
+        {
+            m_tree = nullptr;
+            m_proxy = NULL_NODE;
+        }
+    };
+
+    s32  CreateProxy(const BoundingBox& box, n32 userData);
+    void DestroyProxy(s32 proxy);
+    // the proxy is only reinserted once box has left its fattened box, the new one is stretched along displacement.
+    // returns whether it was reinserted
+    bool MoveProxy(s32 proxy, const BoundingBox& box, glm::vec3 displacement = glm::vec3(0.0f));
+
+    n32                GetUserData(s32 proxy) const { return m_nodes[proxy].userData; }
+    const BoundingBox& GetFatBox(s32 proxy) const { return m_nodes[proxy].box; }
+    n32                GetProxyCount() const { return m_proxyCount; }
+    s32                GetHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+
+    static bool IsOutsideFrustum(const std::array<Plane, 6>& planes, const BoundingBox& box);
+
+    // visit(userData) for every proxy whose fattened box intersects the frustum
+    template <typename Visitor> void QueryFrustum(const std::array<Plane, 6>& planes, Visitor&& visit) const;
+    // visit(userData) for every proxy whose fattened box overlaps box
+    template <typename Visitor> void QueryBox(const BoundingBox& box, Visitor&& visit) const;
+    // visit(userData) for every proxy whose fattened box overlaps the sphere
+    template <typename Visitor> void QuerySphere(glm::vec3 center, f32 radius, Visitor&& visit) const;
+    // visit(userData, distance) for every proxy whose fattened box the ray enters within maxDistance, in no particular order.
+    // it returns the new maximum distance, so a closest hit search returns the distance of its exact hit and 0 stops the cast
+    template <typename Visitor> void RayCast(glm::vec3 origin, glm::vec3 direction, f32 maxDistance, Visitor&& visit) const;
+
+private:
+    // added around every leaf box, and how far ahead of a moving box its fattened one reaches
+    static constexpr f32 FAT_MARGIN = 0.1f;
+    static constexpr f32 DISPLACEMENT_MULTIPLIER = 2.0f;
+
+    struct TreeNode
+    {
+        BoundingBox box; // fattened for leaves
+        s32         parent{NULL_NODE}; // the next free node while the node is unused
+        s32         child1{NULL_NODE};
+        s32         child2{NULL_NODE};
+        s32         height{-1}; // 0 for leaves, -1 for unused nodes
+        n32         userData{0};
+
+        bool IsLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    std::vector<TreeNode> m_nodes;
+    s32                   m_root{NULL_NODE};
+    s32                   m_freeList{NULL_NODE};
+    n32                   m_proxyCount{0};
+
+    s32  AllocateNode();
+    void FreeNode(s32 node);
+    void InsertLeaf(s32 leaf);
+    void RemoveLeaf(s32 leaf);
+    // walks up from node, rebalancing and refitting every ancestor
+    void Refit(s32 node);
+    // rotates the taller grandchild up when the children's heights differ by more than one, returns the subtree's new root
+    s32  Balance(s32 node);
+};
+
+template <typename Visitor> void AABBTree::QueryFrustum(const std::array<Plane, 6>& planes, Visitor&& visit) const
+{
+    if(m_root == NULL_NODE) { return; }
+
+    // a node entirely in front of a plane has its children there too, so the planes left to test shrink on the way down
+    struct Entry
+    {
+        s32 node;
+        n8  planeMask;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({m_root, 0x3F});
+
+    while(!stack.empty())
+    {
+        const Entry entry = stack.back();
+        stack.pop_back();
+
+        const TreeNode& node = m_nodes[entry.node];
+        n8              planeMask = entry.planeMask;
+        bool            outside = false;
+        for(n32 p = 0; p < 6 && !outside; p++)
+        {
+            if(!(planeMask & (1 << p))) { continue; }
+
+            const Plane&     plane = planes[p];
+            const glm::bvec3 positive = glm::greaterThanEqual(plane.normal, glm::vec3(0.0f));
+            outside = glm::dot(plane.normal, glm::mix(node.box.min, node.box.max, positive)) + plane.distance < 0.0f;
+            if(glm::dot(plane.normal, glm::mix(node.box.max, node.box.min, positive)) + plane.distance >= 0.0f) { planeMask &= ~(1 << p); }
+        }
+        if(outside) { continue; }
+
+        if(node.IsLeaf()) { visit(node.userData); }
+        else
+        {
+            stack.push_back({node.child1, planeMask});
+            stack.push_back({node.child2, planeMask});
+        }
+    }
+}
+
+template <typename Visitor> void AABBTree::QueryBox(const BoundingBox& box, Visitor&& visit) const
+{
+    if(m_root == NULL_NODE) { return; }
+
+    std::vector<s32> stack;
+    stack.reserve(64);
+    stack.push_back(m_root);
+
+    while(!stack.empty())
+    {
+        const TreeNode& node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        if(glm::any(glm::lessThan(node.box.max, box.min)) || glm::any(glm::greaterThan(node.box.min, box.max))) { continue; }
+
+        if(node.IsLeaf()) { visit(node.userData); }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+template <typename Visitor> void AABBTree::QuerySphere(glm::vec3 center, f32 radius, Visitor&& visit) const
+{
+    if(m_root == NULL_NODE) { return; }
+
+    std::vector<s32> stack;
+    stack.reserve(64);
+    stack.push_back(m_root);
+
+    while(!stack.empty())
+    {
+        const TreeNode& node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        if(glm::length2(glm::clamp(center, node.box.min, node.box.max) - center) > radius * radius) { continue; }
+
+        if(node.IsLeaf()) { visit(node.userData); }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+template <typename Visitor> void AABBTree::RayCast(glm::vec3 origin, glm::vec3 direction, f32 maxDistance, Visitor&& visit) const
+{
+    if(m_root == NULL_NODE) { return; }
+
+    // slab test, a zero component gives an infinite reciprocal which the min/max below handle
+    const glm::vec3 inverseDirection = 1.0f / direction;
+
+    std::vector<s32> stack;
+    stack.reserve(64);
+    stack.push_back(m_root);
+
+    while(!stack.empty() && maxDistance > 0.0f)
+    {
+        const TreeNode& node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        const glm::vec3 t1 = (node.box.min - origin) * inverseDirection;
+        const glm::vec3 t2 = (node.box.max - origin) * inverseDirection;
+        const glm::vec3 tMin = glm::min(t1, t2);
+        const glm::vec3 tMax = glm::max(t1, t2);
+        const f32       entry = std::max({tMin.x, tMin.y, tMin.z, 0.0f});
+        const f32       exit = std::min({tMax.x, tMax.y, tMax.z, maxDistance});
+        if(entry > exit) { continue; }
+
+        if(node.IsLeaf()) { maxDistance = visit(node.userData, entry); }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+} // namespace Humongous
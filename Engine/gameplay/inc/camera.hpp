@@ -22,6 +22,8 @@ struct ProjectionUBO
     glm::mat4 projection;
     glm::mat4 view;
     glm::vec3 cameraPos;
+    // normalized, xyz is the normal and w the distance. read by the culling compute shader
+    alignas(16) glm::vec4 frustumPlanes[6];
 };
 
 struct UboParams
@@ -71,6 +73,9 @@ public:
     bool        IsAABBOutsidePlane(const Plane& plane, const glm::vec3& aabbMin, const glm::vec3& aabbMax);
     bool        IsAABBInsideFrustum(const glm::vec3& aabbMin, const glm::vec3& aabbMax);
 
+    // extracted once after the view or projection changed, not on every test
+    const std::array<Plane, 6>& GetFrustumPlanes();
+
 private:
     std::vector<std::unique_ptr<Buffer>> m_projectionBuffers;
     std::vector<std::unique_ptr<Buffer>> m_paramBuffers;
@@ -86,6 +91,9 @@ private:
     glm::mat4 m_projectionMatrix{1.f};
     glm::mat4 m_viewMatrix{1.0f};
 
+    std::array<Plane, 6> m_frustumPlanes{};
+    bool                 m_frustumDirty{true};
+
     void InitDescriptorThings(LogicalDevice* logicalDevice);
 };
 } // namespace Humongous
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "camera.hpp"
+#include "material.hpp"
+
+#include <array>
+#include <vector>
+
+namespace Humongous
+{
+/***
+ * frustum culls a batch of boxes at once. the boxes are kept as centers and half extents, one array per component, so one
+ * register holds the same component of 8 (AVX) or 4 (SSE) boxes and every plane is tested against all of them together.
+ * builds without either test one box at a time
+ * */
+class FrustumCuller
+{
+public:
+    void Clear();
+    void Reserve(n32 count);
+    // index is what Cull reports when the box is visible
+    void Add(const BoundingBox& box, n32 index);
+    n32  GetCount() const { return static_cast<n32>(m_indices.size()); }
+
+    // appends the index of every box intersecting the frustum to visible, in the order they were added
+    void Cull(const std::array<Plane, 6>& planes, std::vector<n32>& visible) const;
+    // one box at a time, what the simd paths are checked and timed against
+    void CullScalar(const std::array<Plane, 6>& planes, std::vector<n32>& visible) const;
+
+    // times both against random boxes around center, 1k, 10k and 100k of them, and logs the results
+    static void Benchmark(const std::array<Plane, 6>& planes, glm::vec3 center);
+
+private:
+    std::vector<f32> m_centerX;
+    std::vector<f32> m_centerY;
+    std::vector<f32> m_centerZ;
+    std::vector<f32> m_extentX;
+    std::vector<f32> m_extentY;
+    std::vector<f32> m_extentZ;
+    std::vector<n32> m_indices;
+
+    bool IsOutside(const std::array<Plane, 6>& planes, n32 box) const;
+};
+} // namespace Humongous
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "aabb_tree.hpp"
 #include "logger.hpp"
 #include "material.hpp"
 #include <defines.hpp>
@@ -61,8 +62,15 @@ public:
     RigidBodyComponent rigidBody{};
 
     void        SetModel(std::shared_ptr<Model> model);
-    void        Update();
+    // refits the object's proxy in tree when it moved, objects join the tree once their model's bounds are known
+    void        Update(AABBTree* tree = nullptr);
     BoundingBox GetBoundingBox() const { return m_aabb; }
+    // the model is still streaming in, failed loads don't count
+    bool        IsLoading() const { return m_modelPending && model && model->GetLoadState() == Model::LoadState::LOADING; }
+    // the model's node and primitive bounds where this object puts them, Model::Draw keeps them up to date
+    WorldBounds& GetWorldBounds() { return m_worldBounds; }
+    // bumped by Update whenever the transform changed, lets renderers keep copies of the matrix around
+    n32          GetTransformVersion() const { return m_transformVersion; }
 
     static std::vector<glm::vec3> TransformAABBToWorldSpace(const Model::Dimensions& modelBB, const glm::mat4& modelMatrix);
     static BoundingBox            ComputeWorldAABB(const std::vector<glm::vec3>& worldCorners);
@@ -74,8 +82,15 @@ private:
 
     GameObject(id_t objId) : m_id{objId} {};
     BoundingBox m_aabb;
+    WorldBounds m_worldBounds;
+
+    AABBTree::ProxyHandle m_proxy;
 
     TransformComponent m_prevFrameTransform{};
+    n32                m_transformVersion{0};
+
+    // the model was still loading when it was set, its bounds aren't known yet
+    bool m_modelPending{false};
 };
 
 } // namespace Humongous
@@ -7,6 +7,7 @@
 #include "abstractions/descriptor_pool.hpp"
 #include "instance.hpp"
 #include "logical_device.hpp"
+#include "model.hpp"
 #include "render_pipeline.hpp"
 #include "renderer.hpp"
 #include "singleton.hpp"
@@ -32,7 +33,7 @@ public:
 
     static void BeginUIFrame(vk::CommandBuffer cmd) { Get().Internal_BeginUIFrame(cmd); }
     static void EndUIFRame(vk::CommandBuffer cmd) { Get().Internal_EndUIFRame(cmd); }
-    static void Debug_DrawMetrics(const s16& draws) { Get().Internal_Debug_DrawMetrics(draws); }
+    static void Debug_DrawMetrics(const n32& draws, const RenderStats& stats) { Get().Internal_Debug_DrawMetrics(draws, stats); }
 
 private:
     bool m_hasInited{false};
@@ -54,6 +55,6 @@ private:
     void Internal_Shutdown();
     void Internal_BeginUIFrame(vk::CommandBuffer cmd);
     void Internal_EndUIFRame(vk::CommandBuffer cmd);
-    void Internal_Debug_DrawMetrics(const s16& draws);
+    void Internal_Debug_DrawMetrics(const n32& draws, const RenderStats& stats);
 };
 }; // namespace Humongous
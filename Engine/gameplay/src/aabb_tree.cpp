@@ -0,0 +1,241 @@
+#include "aabb_tree.hpp"
+#include "asserts.hpp"
+
+namespace Humongous
+{
+static BoundingBox Union(const BoundingBox& a, const BoundingBox& b) { return BoundingBox(glm::min(a.min, b.min), glm::max(a.max, b.max)); }
+
+// half the surface area, the cost the insertion heuristic minimizes
+static f32 GetArea(const BoundingBox& box)
+{
+    const glm::vec3 extent = box.max - box.min;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+static bool Contains(const BoundingBox& outer, const BoundingBox& inner)
+{
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+
+bool AABBTree::IsOutsideFrustum(const std::array<Plane, 6>& planes, const BoundingBox& box)
+{
+    // the box is outside once the corner furthest along a plane's normal is behind it
+    for(const Plane& plane: planes)
+    {
+        const glm::vec3 corner = glm::mix(box.min, box.max, glm::greaterThanEqual(plane.normal, glm::vec3(0.0f)));
+        if(glm::dot(plane.normal, corner) + plane.distance < 0.0f) { return true; }
+    }
+    return false;
+}
+
+s32 AABBTree::AllocateNode()
+{
+    if(m_freeList == NULL_NODE)
+    {
+        m_nodes.emplace_back();
+        m_nodes.back().height = 0;
+        return static_cast<s32>(m_nodes.size()) - 1;
+    }
+
+    const s32 node = m_freeList;
+    m_freeList = m_nodes[node].parent;
+    m_nodes[node] = TreeNode{};
+    m_nodes[node].height = 0;
+    return node;
+}
+
+void AABBTree::FreeNode(s32 node)
+{
+    m_nodes[node].parent = m_freeList;
+    m_nodes[node].height = -1;
+    m_freeList = node;
+}
+
+s32 AABBTree::CreateProxy(const BoundingBox& box, n32 userData)
+{
+    const s32 proxy = AllocateNode();
+    m_nodes[proxy].box = BoundingBox(box.min - FAT_MARGIN, box.max + FAT_MARGIN);
+    m_nodes[proxy].userData = userData;
+    InsertLeaf(proxy);
+    m_proxyCount++;
+    return proxy;
+}
+
+void AABBTree::DestroyProxy(s32 proxy)
+{
+    HGASSERT(proxy >= 0 && proxy < static_cast<s32>(m_nodes.size()) && m_nodes[proxy].height == 0 && "Not a proxy of this tree");
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    m_proxyCount--;
+}
+
+bool AABBTree::MoveProxy(s32 proxy, const BoundingBox& box, glm::vec3 displacement)
+{
+    HGASSERT(proxy >= 0 && proxy < static_cast<s32>(m_nodes.size()) && m_nodes[proxy].height == 0 && "Not a proxy of this tree");
+    if(Contains(m_nodes[proxy].box, box)) { return false; }
+
+    RemoveLeaf(proxy);
+
+    // objects tend to keep moving the way they did, reaching ahead saves the next few reinsertions
+    BoundingBox fat(box.min - FAT_MARGIN, box.max + FAT_MARGIN);
+    const glm::vec3 ahead = displacement * DISPLACEMENT_MULTIPLIER;
+    fat.min += glm::min(ahead, glm::vec3(0.0f));
+    fat.max += glm::max(ahead, glm::vec3(0.0f));
+    m_nodes[proxy].box = fat;
+
+    InsertLeaf(proxy);
+    return true;
+}
+
+void AABBTree::InsertLeaf(s32 leaf)
+{
+    if(m_root == NULL_NODE)
+    {
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // descend towards the sibling that makes the tree's surface area grow the least
+    const BoundingBox leafBox = m_nodes[leaf].box;
+    s32               index = m_root;
+    while(!m_nodes[index].IsLeaf())
+    {
+        const TreeNode& node = m_nodes[index];
+        const f32       area = GetArea(node.box);
+        const f32       combinedArea = GetArea(Union(node.box, leafBox));
+
+        // pairing the leaf with this node makes a new parent the size of both
+        const f32 cost = 2.0f * combinedArea;
+        // going further down grows this node either way
+        const f32 inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](s32 child) {
+            const TreeNode& childNode = m_nodes[child];
+            const f32       childArea = GetArea(Union(leafBox, childNode.box));
+            return (childNode.IsLeaf() ? childArea : childArea - GetArea(childNode.box)) + inheritanceCost;
+        };
+        const f32 cost1 = descendCost(node.child1);
+        const f32 cost2 = descendCost(node.child2);
+
+        if(cost < cost1 && cost < cost2) { break; }
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    const s32 sibling = index;
+    const s32 oldParent = m_nodes[sibling].parent;
+    const s32 newParent = AllocateNode();
+
+    TreeNode& parent = m_nodes[newParent];
+    parent.parent = oldParent;
+    parent.box = Union(leafBox, m_nodes[sibling].box);
+    parent.height = m_nodes[sibling].height + 1;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    if(oldParent == NULL_NODE) { m_root = newParent; }
+    else if(m_nodes[oldParent].child1 == sibling) { m_nodes[oldParent].child1 = newParent; }
+    else { m_nodes[oldParent].child2 = newParent; }
+
+    // the new parent can be out of balance itself, a leaf next to a deep sibling
+    Refit(newParent);
+}
+
+void AABBTree::RemoveLeaf(s32 leaf)
+{
+    if(leaf == m_root)
+    {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    const s32 parent = m_nodes[leaf].parent;
+    const s32 grandParent = m_nodes[parent].parent;
+    const s32 sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    // the sibling takes the parent's place
+    m_nodes[sibling].parent = grandParent;
+    FreeNode(parent);
+
+    if(grandParent == NULL_NODE)
+    {
+        m_root = sibling;
+        return;
+    }
+
+    if(m_nodes[grandParent].child1 == parent) { m_nodes[grandParent].child1 = sibling; }
+    else { m_nodes[grandParent].child2 = sibling; }
+
+    Refit(grandParent);
+}
+
+void AABBTree::Refit(s32 node)
+{
+    while(node != NULL_NODE)
+    {
+        node = Balance(node);
+
+        TreeNode&       current = m_nodes[node];
+        const TreeNode& child1 = m_nodes[current.child1];
+        const TreeNode& child2 = m_nodes[current.child2];
+        current.height = 1 + std::max(child1.height, child2.height);
+        current.box = Union(child1.box, child2.box);
+
+        node = current.parent;
+    }
+}
+
+s32 AABBTree::Balance(s32 iA)
+{
+    TreeNode& a = m_nodes[iA];
+    if(a.IsLeaf() || a.height < 2) { return iA; }
+
+    const s32 iB = a.child1;
+    const s32 iC = a.child2;
+    TreeNode& b = m_nodes[iB];
+    TreeNode& c = m_nodes[iC];
+
+    const s32 balance = c.height - b.height;
+    if(balance >= -1 && balance <= 1) { return iA; }
+
+    // the taller child (up) takes A's place, A keeps the shorter child and the shorter of up's children
+    const bool rotateC = balance > 1;
+    const s32  iUp = rotateC ? iC : iB;
+    TreeNode&  up = rotateC ? c : b;
+    TreeNode&  kept = rotateC ? b : c;
+
+    const s32 iF = up.child1;
+    const s32 iG = up.child2;
+    TreeNode& f = m_nodes[iF];
+    TreeNode& g = m_nodes[iG];
+
+    up.child1 = iA;
+    up.parent = a.parent;
+    a.parent = iUp;
+
+    if(up.parent == NULL_NODE) { m_root = iUp; }
+    else if(m_nodes[up.parent].child1 == iA) { m_nodes[up.parent].child1 = iUp; }
+    else { m_nodes[up.parent].child2 = iUp; }
+
+    const bool keepF = f.height > g.height;
+    const s32  iTall = keepF ? iF : iG;
+    const s32  iShort = keepF ? iG : iF;
+    TreeNode&  tall = keepF ? f : g;
+    TreeNode&  low = keepF ? g : f;
+
+    up.child2 = iTall;
+    if(rotateC) { a.child2 = iShort; }
+    else { a.child1 = iShort; }
+    low.parent = iA;
+
+    a.box = Union(kept.box, low.box);
+    a.height = 1 + std::max(kept.height, low.height);
+    up.box = Union(a.box, tall.box);
+    up.height = 1 + std::max(a.height, tall.height);
+
+    return iUp;
+}
+
+} // namespace Humongous
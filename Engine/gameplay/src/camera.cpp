@@ -25,7 +25,7 @@ void Camera::InitDescriptorThings(LogicalDevice* logicalDevice)
     m_projectionPool = builder.Build();
 
     DescriptorSetLayout::Builder builder2{*logicalDevice};
-    builder2.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
+    builder2.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
     m_projectionLayout = builder2.build();
 
     DescriptorSetLayout::Builder builder3{*logicalDevice};
@@ -64,10 +64,13 @@ void Camera::UpdateUBO(n32 index, const glm::vec3& camPos)
     ubo.view = m_viewMatrix;
     ubo.cameraPos = camPos;
 
-    m_projectionBuffers[index]->WriteToBuffer(&ubo);
+    const std::array<Plane, 6>& planes = GetFrustumPlanes();
+    for(n32 i = 0; i < 6; i++) { ubo.frustumPlanes[i] = glm::vec4(planes[i].normal, planes[i].distance); }
+
+    m_projectionBuffers[index]->WriteToBuffer(&ubo, sizeof(ubo));
 
     UboParams params{};
-    m_paramBuffers[index]->WriteToBuffer(&params);
+    m_paramBuffers[index]->WriteToBuffer(&params, sizeof(params));
 }
 
 void Camera::SetOrthographicProjection(float left, float right, float top, float bottom, float near, float far)
@@ -79,6 +82,7 @@ void Camera::SetOrthographicProjection(float left, float right, float top, float
     m_projectionMatrix[3][0] = -(right + left) / (right - left);
     m_projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
     m_projectionMatrix[3][2] = -near / (far - near);
+    m_frustumDirty = true;
 }
 
 void Camera::SetPerspectiveProjection(float fovy, float aspect, float near, float far)
@@ -91,6 +95,7 @@ void Camera::SetPerspectiveProjection(float fovy, float aspect, float near, floa
     m_projectionMatrix[2][2] = far / (far - near);
     m_projectionMatrix[2][3] = 1.f;
     m_projectionMatrix[3][2] = -(far * near) / (far - near);
+    m_frustumDirty = true;
 }
 
 void Camera::SetViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3 up)
@@ -112,6 +117,7 @@ void Camera::SetViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3
     m_viewMatrix[3][0] = -glm::dot(u, position);
     m_viewMatrix[3][1] = -glm::dot(v, position);
     m_viewMatrix[3][2] = -glm::dot(w, position);
+    m_frustumDirty = true;
 }
 
 void Camera::SetViewTarget(glm::vec3 position, glm::vec3 target, glm::vec3 up) { SetViewDirection(position, target - position, up); }
@@ -140,6 +146,7 @@ void Camera::SetViewYXZ(glm::vec3 position, glm::vec3 rotation)
     m_viewMatrix[3][0] = -glm::dot(u, position);
     m_viewMatrix[3][1] = -glm::dot(v, position);
     m_viewMatrix[3][2] = -glm::dot(w, position);
+    m_frustumDirty = true;
 }
 
 void Camera::ExtractFrustumPlanes(const glm::mat4& projectionViewMatrix, std::array<Plane, 6>& frustumPlanes)
@@ -219,11 +226,20 @@ bool Camera::IsAABBOutsidePlane(const Plane& plane, const glm::vec3& aabbMin, co
     return false; // AABB is at least partially inside
 }
 
+const std::array<Plane, 6>& Camera::GetFrustumPlanes()
+{
+    if(m_frustumDirty)
+    {
+        ExtractFrustumPlanes(GetVPM(), m_frustumPlanes);
+        m_frustumDirty = false;
+    }
+    return m_frustumPlanes;
+}
+
 // Check if an AABB is inside the frustum
 bool Camera::IsAABBInsideFrustum(const glm::vec3& aabbMin, const glm::vec3& aabbMax)
 {
-    std::array<Plane, 6> frustumPlanes;
-    Camera::ExtractFrustumPlanes(GetVPM(), frustumPlanes);
+    const std::array<Plane, 6>& frustumPlanes = GetFrustumPlanes();
 
     for(int i = 0; i < 6; i++)
     {
@@ -0,0 +1,211 @@
+#include "frustum_culler.hpp"
+#include "logger.hpp"
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__AVX__)
+#define HG_CULL_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define HG_CULL_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Humongous
+{
+#if defined(HG_CULL_AVX)
+using Lanes = __m256;
+static constexpr n32         LANE_COUNT = 8;
+static constexpr const char* SIMD_NAME = "avx";
+
+static Lanes SplatLanes(f32 value) { return _mm256_set1_ps(value); }
+static Lanes LoadLanes(const f32* values) { return _mm256_loadu_ps(values); }
+static Lanes AddLanes(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static Lanes MulLanes(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static Lanes OrLanes(Lanes a, Lanes b) { return _mm256_or_ps(a, b); }
+static Lanes IsNegativeLanes(Lanes a) { return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ); }
+static n32   GetLaneMask(Lanes a) { return static_cast<n32>(_mm256_movemask_ps(a)); }
+#elif defined(HG_CULL_SSE)
+using Lanes = __m128;
+static constexpr n32         LANE_COUNT = 4;
+static constexpr const char* SIMD_NAME = "sse";
+
+static Lanes SplatLanes(f32 value) { return _mm_set1_ps(value); }
+static Lanes LoadLanes(const f32* values) { return _mm_loadu_ps(values); }
+static Lanes AddLanes(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static Lanes MulLanes(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static Lanes OrLanes(Lanes a, Lanes b) { return _mm_or_ps(a, b); }
+static Lanes IsNegativeLanes(Lanes a) { return _mm_cmplt_ps(a, _mm_setzero_ps()); }
+static n32   GetLaneMask(Lanes a) { return static_cast<n32>(_mm_movemask_ps(a)); }
+#else
+static constexpr const char* SIMD_NAME = "scalar";
+#endif
+
+void FrustumCuller::Clear()
+{
+    m_centerX.clear();
+    m_centerY.clear();
+    m_centerZ.clear();
+    m_extentX.clear();
+    m_extentY.clear();
+    m_extentZ.clear();
+    m_indices.clear();
+}
+
+void FrustumCuller::Reserve(n32 count)
+{
+    m_centerX.reserve(count);
+    m_centerY.reserve(count);
+    m_centerZ.reserve(count);
+    m_extentX.reserve(count);
+    m_extentY.reserve(count);
+    m_extentZ.reserve(count);
+    m_indices.reserve(count);
+}
+
+void FrustumCuller::Add(const BoundingBox& box, n32 index)
+{
+    const glm::vec3 center = (box.min + box.max) * 0.5f;
+    const glm::vec3 extent = (box.max - box.min) * 0.5f;
+    m_centerX.push_back(center.x);
+    m_centerY.push_back(center.y);
+    m_centerZ.push_back(center.z);
+    m_extentX.push_back(extent.x);
+    m_extentY.push_back(extent.y);
+    m_extentZ.push_back(extent.z);
+    m_indices.push_back(index);
+}
+
+// the box reaches as far along a plane's normal as its extents dotted with the normal's absolute value, the same as testing
+// the corner furthest along the normal
+bool FrustumCuller::IsOutside(const std::array<Plane, 6>& planes, n32 box) const
+{
+    for(const Plane& plane: planes)
+    {
+        const f32 distance = plane.normal.x * m_centerX[box] + plane.normal.y * m_centerY[box] + plane.normal.z * m_centerZ[box] + plane.distance;
+        const f32 radius =
+            std::abs(plane.normal.x) * m_extentX[box] + std::abs(plane.normal.y) * m_extentY[box] + std::abs(plane.normal.z) * m_extentZ[box];
+        if(distance + radius < 0.0f) { return true; }
+    }
+    return false;
+}
+
+void FrustumCuller::Cull(const std::array<Plane, 6>& planes, std::vector<n32>& visible) const
+{
+    const n32 count = GetCount();
+    visible.reserve(visible.size() + count);
+
+    n32 box = 0;
+#if defined(HG_CULL_AVX) || defined(HG_CULL_SSE)
+    struct PlaneLanes
+    {
+        Lanes normalX, normalY, normalZ;
+        Lanes absX, absY, absZ;
+        Lanes distance;
+    };
+    std::array<PlaneLanes, 6> planeLanes;
+    for(n32 p = 0; p < 6; p++)
+    {
+        const Plane& plane = planes[p];
+        planeLanes[p] = {SplatLanes(plane.normal.x),
+                         SplatLanes(plane.normal.y),
+                         SplatLanes(plane.normal.z),
+                         SplatLanes(std::abs(plane.normal.x)),
+                         SplatLanes(std::abs(plane.normal.y)),
+                         SplatLanes(std::abs(plane.normal.z)),
+                         SplatLanes(plane.distance)};
+    }
+
+    constexpr n32 ALL_LANES = (1u << LANE_COUNT) - 1;
+    for(; box + LANE_COUNT <= count; box += LANE_COUNT)
+    {
+        const Lanes centerX = LoadLanes(m_centerX.data() + box);
+        const Lanes centerY = LoadLanes(m_centerY.data() + box);
+        const Lanes centerZ = LoadLanes(m_centerZ.data() + box);
+        const Lanes extentX = LoadLanes(m_extentX.data() + box);
+        const Lanes extentY = LoadLanes(m_extentY.data() + box);
+        const Lanes extentZ = LoadLanes(m_extentZ.data() + box);
+
+        Lanes outside = SplatLanes(0.0f);
+        for(const PlaneLanes& plane: planeLanes)
+        {
+            const Lanes distance = AddLanes(AddLanes(MulLanes(plane.normalX, centerX), MulLanes(plane.normalY, centerY)),
+                                            AddLanes(MulLanes(plane.normalZ, centerZ), plane.distance));
+            const Lanes radius = AddLanes(AddLanes(MulLanes(plane.absX, extentX), MulLanes(plane.absY, extentY)), MulLanes(plane.absZ, extentZ));
+            outside = OrLanes(outside, IsNegativeLanes(AddLanes(distance, radius)));
+        }
+
+        // one bit per visible box, written out lowest first to keep the order
+        n32 mask = GetLaneMask(outside) ^ ALL_LANES;
+        while(mask)
+        {
+            visible.push_back(m_indices[box + std::countr_zero(mask)]);
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for(; box < count; box++)
+    {
+        if(!IsOutside(planes, box)) { visible.push_back(m_indices[box]); }
+    }
+}
+
+void FrustumCuller::CullScalar(const std::array<Plane, 6>& planes, std::vector<n32>& visible) const
+{
+    const n32 count = GetCount();
+    visible.reserve(visible.size() + count);
+    for(n32 box = 0; box < count; box++)
+    {
+        if(!IsOutside(planes, box)) { visible.push_back(m_indices[box]); }
+    }
+}
+
+void FrustumCuller::Benchmark(const std::array<Plane, 6>& planes, glm::vec3 center)
+{
+    // enough runs that the 1k case isn't just timer noise
+    constexpr n32 RUNS = 20;
+
+    std::mt19937                        random{1234};
+    std::uniform_real_distribution<f32> offset(-200.0f, 200.0f);
+    std::uniform_real_distribution<f32> size(0.1f, 4.0f);
+
+    FrustumCuller    culler;
+    std::vector<n32> scalarVisible;
+    std::vector<n32> simdVisible;
+    for(n32 count: {1000u, 10000u, 100000u})
+    {
+        culler.Clear();
+        culler.Reserve(count);
+        for(n32 i = 0; i < count; i++)
+        {
+            const glm::vec3 boxCenter = center + glm::vec3(offset(random), offset(random), offset(random));
+            const glm::vec3 extent = glm::vec3(size(random), size(random), size(random)) * 0.5f;
+            culler.Add(BoundingBox(boxCenter - extent, boxCenter + extent), i);
+        }
+
+        auto time = [&](std::vector<n32>& visible, auto cull) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for(n32 run = 0; run < RUNS; run++)
+            {
+                visible.clear();
+                cull(visible);
+            }
+            return std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count() / RUNS;
+        };
+        const f32 scalarMs = time(scalarVisible, [&](std::vector<n32>& visible) { culler.CullScalar(planes, visible); });
+        const f32 simdMs = time(simdVisible, [&](std::vector<n32>& visible) { culler.Cull(planes, visible); });
+
+        HGINFO("Frustum culling %u boxes: scalar %.4fms, %s %.4fms (%.1fx), %u visible", count, scalarMs, SIMD_NAME, simdMs,
+               simdMs > 0.0f ? scalarMs / simdMs : 0.0f, static_cast<n32>(simdVisible.size()));
+        if(scalarVisible != simdVisible)
+        {
+            HGWARN("Scalar and %s culling disagree, %u vs %u visible", SIMD_NAME, static_cast<n32>(scalarVisible.size()),
+                   static_cast<n32>(simdVisible.size()));
+        }
+    }
+}
+} // namespace Humongous
@@ -92,18 +92,41 @@ BoundingBox GameObject::ComputeWorldAABB(const std::vector<glm::vec3>& worldCorn
 void GameObject::SetModel(std::shared_ptr<Model> model)
 {
     this->model = model;
+    m_modelPending = !model->IsReady();
+    if(m_modelPending)
+    {
+        // back into the tree once the new bounds are known
+        m_proxy.Reset();
+        return;
+    }
+
     auto corners = TransformAABBToWorldSpace(model->GetDimensions(), transform.Mat4());
     m_aabb = ComputeWorldAABB(corners);
+    if(m_proxy) { m_proxy.GetTree()->MoveProxy(m_proxy.Get(), m_aabb); }
 }
 
-void GameObject::Update()
+void GameObject::Update(AABBTree* tree)
 {
-    if(m_prevFrameTransform != transform)
+    // bounds only exist once the model has finished loading
+    bool modelArrived = false;
+    if(m_modelPending)
+    {
+        if(!model->IsReady()) { return; }
+        m_modelPending = false;
+        modelArrived = true;
+    }
+
+    if(m_prevFrameTransform != transform || modelArrived)
     {
         auto corners = TransformAABBToWorldSpace(model->GetDimensions(), transform.Mat4());
         m_aabb = ComputeWorldAABB(corners);
+        m_transformVersion++;
+
+        if(m_proxy) { m_proxy.GetTree()->MoveProxy(m_proxy.Get(), m_aabb, transform.translation - m_prevFrameTransform.translation); }
     }
 
+    if(tree && model && m_proxy.GetTree() != tree) { m_proxy = AABBTree::ProxyHandle(tree, tree->CreateProxy(m_aabb, m_id)); }
+
     m_prevFrameTransform = transform;
 }
 
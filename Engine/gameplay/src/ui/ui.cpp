@@ -2,6 +2,7 @@
 #include "asset_manager.hpp"
 #include "globals.hpp"
 #include "logger.hpp"
+#include "model_cache.hpp"
 
 // lib
 #include "imgui_impl_sdl3.h"
@@ -134,10 +135,21 @@ void UI::Internal_EndUIFRame(vk::CommandBuffer cmd)
     m_initedFrame = false;
 }
 
-void UI::Internal_Debug_DrawMetrics(const s16& draws)
+void UI::Internal_Debug_DrawMetrics(const n32& draws, const RenderStats& stats)
 {
-    UiWidget widg{"Metrics", true, {00, 0}, {225, 100}, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize};
-    widg.AddBullet("Drawn Objects: %i", draws);
+    UiWidget widg{"Metrics", true, {00, 0}, {225, 320}, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize};
+    widg.AddBullet("Drawn Objects: %u", draws);
+    widg.AddBullet("Clusters: %u / %u", stats.clustersDrawn, stats.clustersTested);
+    widg.AddBullet("Draws: %u (%u indirect calls)", stats.drawCalls, stats.indirectCalls);
+    widg.AddBullet("Triangles: %u", stats.triangles);
+    widg.AddBullet("Reduced LODs: %u", stats.reducedLods);
+    widg.AddBullet("Too Small: %u", stats.objectsTooSmall);
+    widg.AddBullet("Culling: %s (%u culled)", stats.gpuCulled ? "GPU" : "CPU", stats.primitivesCulled);
+    widg.AddBullet("Loading: %u", stats.objectsLoading);
+    widg.AddBullet("Binds: %u (%u skipped)", stats.bindsIssued, stats.bindsSkipped);
+    widg.AddBullet("Record(ms): %.3f", stats.recordMs);
+    widg.AddBullet("Cull(ms): %.3f", stats.cullMs);
+    widg.AddBullet("Models: %.2f MB", static_cast<f64>(ModelCache::GetResidentBytes()) / (1024.0 * 1024.0));
     widg.AddBullet("FPS: %i", static_cast<int>(std::round((1 / Globals::Time::AverageDeltaTime()))));
     widg.AddBullet("FrameTime(ms): %f", static_cast<float>(Globals::Time::AverageDeltaTime()) * 1000);
     widg.Draw();
@@ -24,6 +24,9 @@ public:
     void Init(LogicalDevice* device, VkDeviceSize m_instanceSize, n32 m_instanceCount, VkBufferUsageFlags usageFlags,
               VkMemoryPropertyFlags memoryPropertyFlags, VmaMemoryUsage memoryUsage, VkDeviceSize minOffsetAlignment = 1);
 
+    // persistently mapped coherent transfer source, host cached where the device offers it so data can be built in place and read back
+    void InitStaging(LogicalDevice* device, VkDeviceSize size);
+
     void                   WriteToBuffer(void* data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
     VkResult               Flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
     VkDescriptorBufferInfo DescriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "logical_device.hpp"
+#include "non_copyable.hpp"
+#include "singleton.hpp"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Humongous
+{
+/***
+ * one global descriptor set every material texture is sampled through. binding 0 is a large array of sampled images, binding 1 an
+ * array of samplers, both partially bound and update after bind so textures can come and go while frames are in flight.
+ * shaders combine an image and a sampler by index, the indices travel with the material (see Model::ShaderMaterial),
+ * so the set is bound once per frame instead of once per material
+ * */
+class BindlessTextures : public Singleton<BindlessTextures>, NonCopyable
+{
+public:
+    static constexpr n32 IMAGE_BINDING = 0;
+    static constexpr n32 SAMPLER_BINDING = 1;
+    static constexpr n32 INVALID_INDEX = ~0u;
+
+    static void Init(LogicalDevice* device) { Get().Internal_Init(device); }
+    static void Shutdown() { Get().Internal_Shutdown(); }
+
+    static VkDescriptorSetLayout GetDescriptorSetLayout() { return Get().m_layout; }
+    static VkDescriptorSet       GetDescriptorSet() { return Get().m_descriptorSet; }
+
+    // the image has to be in imageLayout whenever it's sampled. released slots are handed out again
+    static n32  RegisterImage(VkImageView imageView, VkImageLayout imageLayout) { return Get().Internal_RegisterImage(imageView, imageLayout); }
+    static void ReleaseImage(n32 index) { Get().Internal_ReleaseImage(index); }
+    // samplers come from the SamplerCache and live until shutdown, so their slots are never released
+    static n32 GetSamplerIndex(VkSampler sampler) { return Get().Internal_GetSamplerIndex(sampler); }
+
+private:
+    // upper bounds, devices with lower update after bind limits get smaller arrays
+    static constexpr n32 MAX_IMAGES = 16384;
+    static constexpr n32 MAX_SAMPLERS = 256;
+
+    LogicalDevice*        m_device{nullptr};
+    VkDescriptorSetLayout m_layout{VK_NULL_HANDLE};
+    VkDescriptorPool      m_pool{VK_NULL_HANDLE};
+    VkDescriptorSet       m_descriptorSet{VK_NULL_HANDLE};
+
+    n32                                m_imageCapacity{0};
+    n32                                m_samplerCapacity{0};
+    n32                                m_imageCount{0}; // slots handed out so far, released ones are in m_freeImages
+    std::vector<n32>                   m_freeImages;
+    std::unordered_map<VkSampler, n32> m_samplers;
+    std::mutex                         m_mutex;
+
+    void Internal_Init(LogicalDevice* device);
+    void Internal_Shutdown();
+    n32  Internal_RegisterImage(VkImageView imageView, VkImageLayout imageLayout);
+    void Internal_ReleaseImage(n32 index);
+    n32  Internal_GetSamplerIndex(VkSampler sampler);
+};
+} // namespace Humongous
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "defines.hpp"
+#include <vulkan/vulkan.h>
+
+#include <array>
+
+namespace Humongous
+{
+/***
+ * thin layer over a graphics command buffer that remembers what is bound (pipeline, descriptor sets, index buffer, push constants)
+ * and drops binds that wouldn't change anything. state lives in fixed size arrays, recording never allocates.
+ * commands recorded straight into the command buffer aren't seen by the recorder, call Invalidate after doing that
+ * */
+class CommandRecorder
+{
+public:
+    struct Stats
+    {
+        n32 bindsIssued = 0;
+        n32 bindsSkipped = 0;
+    };
+
+    static constexpr n32 MAX_DESCRIPTOR_SETS = 8;
+    // the smallest maxPushConstantsSize the spec allows
+    static constexpr n32 MAX_PUSH_CONSTANT_BYTES = 128;
+
+    explicit CommandRecorder(VkCommandBuffer commandBuffer) : m_commandBuffer{commandBuffer} {}
+
+    VkCommandBuffer GetCommandBuffer() const { return m_commandBuffer; }
+    const Stats&    GetStats() const { return m_stats; }
+
+    void BindPipeline(VkPipeline pipeline);
+    void BindDescriptorSets(VkPipelineLayout layout, n32 firstSet, n32 setCount, const VkDescriptorSet* descriptorSets);
+    void BindDescriptorSet(VkPipelineLayout layout, n32 set, VkDescriptorSet descriptorSet) { BindDescriptorSets(layout, set, 1, &descriptorSet); }
+    void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+    // offset and size are multiples of four, as vulkan requires
+    void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, n32 offset, n32 size, const void* data);
+
+    // forgets everything that is bound, the next bind of anything is always recorded
+    void Invalidate();
+
+private:
+    VkCommandBuffer m_commandBuffer;
+    Stats           m_stats{};
+
+    VkPipeline m_pipeline{VK_NULL_HANDLE};
+    // sets and push constants recorded with one layout are disturbed by binding with another, they're only compared under the same one
+    VkPipelineLayout                                 m_layout{VK_NULL_HANDLE};
+    std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> m_descriptorSets{};
+
+    VkBuffer     m_indexBuffer{VK_NULL_HANDLE};
+    VkDeviceSize m_indexOffset{0};
+    VkIndexType  m_indexType{VK_INDEX_TYPE_MAX_ENUM};
+
+    // one entry per four bytes, a word is only known while its stage flags aren't zero
+    std::array<n8, MAX_PUSH_CONSTANT_BYTES>                     m_pushConstants{};
+    std::array<VkShaderStageFlags, MAX_PUSH_CONSTANT_BYTES / 4> m_pushConstantStages{};
+
+    void SetLayout(VkPipelineLayout layout);
+};
+} // namespace Humongous
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "abstractions/buffer.hpp"
+#include "model.hpp"
+#include "non_copyable.hpp"
+#include "swapchain.hpp"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Humongous
+{
+/***
+ * culls every primitive of every object in a compute pass, see cull.comp.glsl.
+ * visible primitives are compacted into indirect commands with an atomic counter per model and index type, the render system
+ * draws them with vkCmdDrawIndexedIndirectCount without knowing how many survived.
+ * object matrices live in a persistent buffer, only the ones written since the last pass are copied over. a frame only passes the
+ * indices of the objects that survived the cpu's broad phase, counters the shader keeps are read back once the frame's fence has
+ * been waited on
+ * */
+class GpuCuller : NonCopyable
+{
+public:
+    // the objects drawn with one model, their object indices are contiguous in the frame's instance buffer
+    struct Batch
+    {
+        Model* model{nullptr};
+        n32    firstInstance{0};
+        n32    instanceCount{0};
+    };
+
+    struct Settings
+    {
+        f32 pixelsPerUnit{0.0f};
+        f32 viewportHeight{0.0f};
+        f32 lodErrorPixels{1.0f};
+        f32 minPixels{0.0f}; // primitives smaller than this on screen are culled
+    };
+
+    // counted by cull.comp.glsl, the words at the start of the frame's count buffer
+    struct Stats
+    {
+        n32 primitivesVisible{0};
+        n32 primitivesCulled{0};
+        n32 triangles{0};
+        n32 reducedLods{0};
+        n32 objectsVisible{0}; // objects with at least one primitive drawn
+    };
+
+    GpuCuller(LogicalDevice& logicalDevice, VkDescriptorSetLayout cameraLayout, const std::string& shaderPath);
+    ~GpuCuller();
+
+    // a slot in the object buffer, it keeps its matrix until it is written again
+    n32  AddObject();
+    void WriteObject(n32 object, const glm::mat4& matrix);
+
+    // the frame's fence has been waited on, so its buffers are free again. returns where the instanceCount object indices of the frame go
+    n32* BeginFrame(n32 frameIndex, n32 instanceCount);
+
+    // has to be recorded outside of rendering, batch i is drawn with GetDraw(i) afterwards
+    void Cull(VkCommandBuffer commandBuffer, VkDescriptorSet cameraSet, const std::vector<Batch>& batches, const Settings& settings);
+
+    const Model::IndirectCountDraw& GetDraw(n32 batch) const { return m_frames[m_frameIndex].draws[batch]; }
+    VkDeviceAddress                 GetRecordAddress() { return m_frames[m_frameIndex].records->GetDeviceAddress(); }
+    VkDeviceAddress                 GetObjectAddress() { return m_objects->GetDeviceAddress(); }
+
+    // what the last frame that has finished on the gpu culled, up to MAX_FRAMES_IN_FLIGHT frames behind
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    // cull.comp.glsl's push constant block
+    struct PushConstants
+    {
+        VkDeviceAddress primitives;
+        VkDeviceAddress lods;
+        VkDeviceAddress meshes;
+        VkDeviceAddress objects;
+        VkDeviceAddress instances;
+        VkDeviceAddress commands;
+        VkDeviceAddress records;
+        VkDeviceAddress counts;
+        n32             firstInstance;
+        n32             instanceCount;
+        n32             drawCount;
+        n32             firstCommand;
+        n32             maxDraws;
+        n32             firstCount;
+        n32             firstFlag;
+        f32             pixelsPerUnit;
+        f32             viewportHeight;
+        f32             lodErrorPixels;
+        f32             minPixels;
+    };
+    static_assert(sizeof(PushConstants) == 112, "cull.comp.glsl's push constant layout");
+
+    static constexpr n32 WORKGROUP_SIZE = 64;
+    static constexpr n32 STAT_COUNTS = sizeof(Stats) / sizeof(n32);
+    // every model gets a draw count per list, see Model::GpuPrimitive::list
+    static constexpr n32 LIST_COUNT = 3;
+
+    struct Frame
+    {
+        std::unique_ptr<Buffer> instances; // host visible, the object indices of the batches
+        std::unique_ptr<Buffer> uploads;   // host visible, the matrices written since the last pass
+        std::unique_ptr<Buffer> commands;
+        std::unique_ptr<Buffer> records;
+        std::unique_ptr<Buffer> counts;   // the stats, three draw counts per batch and a visibility flag per instance
+        std::unique_ptr<Buffer> readback; // the stats words, copied out of counts at the end of the pass
+        n32                     instanceCapacity{0};
+        n32                     uploadCapacity{0};
+        n32                     commandCapacity{0};
+        n32                     countCapacity{0};
+        bool                    statsPending{false};
+
+        // object buffers that were replaced while this frame was recorded, the frames before it may still read them
+        std::vector<std::unique_ptr<Buffer>> retired;
+
+        std::vector<Model::IndirectCountDraw> draws;
+    };
+
+    LogicalDevice&   m_logicalDevice;
+    VkPipelineLayout m_pipelineLayout{VK_NULL_HANDLE};
+    VkPipeline       m_pipeline{VK_NULL_HANDLE};
+
+    std::array<Frame, SwapChain::MAX_FRAMES_IN_FLIGHT> m_frames;
+    n32                                                m_frameIndex{0};
+    Stats                                              m_stats{};
+
+    // device local, the cpu keeps its own copy so a bigger buffer can be filled again
+    std::unique_ptr<Buffer> m_objects;
+    n32                     m_objectCapacity{0};
+    std::vector<glm::mat4>  m_matrices;
+    std::vector<n32>        m_dirtyObjects;
+    std::vector<b8>         m_dirty;
+
+    void CreatePipelineLayout(VkDescriptorSetLayout cameraLayout);
+    void CreatePipeline(const std::string& shaderPath);
+    void Reserve(Frame& frame, n32 commandCount, n32 countCount);
+    void UploadObjects(VkCommandBuffer commandBuffer, Frame& frame);
+};
+} // namespace Humongous
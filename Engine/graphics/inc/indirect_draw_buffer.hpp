@@ -0,0 +1,54 @@
+#pragma once
+
+#include "abstractions/buffer.hpp"
+#include "non_copyable.hpp"
+#include "swapchain.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace Humongous
+{
+/***
+ * host visible memory the cpu writes indexed indirect draw commands into while recording a frame.
+ * every frame in flight has its own chunks, so commands of a frame the gpu is still working on are never overwritten.
+ * chunks are kept around and reused, a frame only allocates when it draws more than any frame before it
+ * */
+class IndirectDrawBuffer : NonCopyable
+{
+public:
+    // where count commands can be written, they're read from buffer at offset
+    struct Allocation
+    {
+        VkBuffer                      buffer{VK_NULL_HANDLE};
+        VkDeviceSize                  offset{0};
+        VkDrawIndexedIndirectCommand* commands{nullptr};
+    };
+
+    explicit IndirectDrawBuffer(LogicalDevice& logicalDevice) : m_logicalDevice{logicalDevice} {}
+
+    // the frame's fence has been waited on, so its previous commands are done being read
+    void BeginFrame(n32 frameIndex);
+
+    // the commands are contiguous, so a single vkCmdDrawIndexedIndirect can draw any prefix of them
+    Allocation Allocate(n32 count);
+
+private:
+    static constexpr n32 CHUNK_COMMANDS = 16384;
+
+    struct Chunk
+    {
+        std::unique_ptr<Buffer> buffer;
+        n32                     capacity{0};
+    };
+
+    LogicalDevice& m_logicalDevice;
+
+    std::array<std::vector<Chunk>, SwapChain::MAX_FRAMES_IN_FLIGHT> m_frames;
+
+    n32 m_frameIndex{0};
+    n32 m_chunk{0};
+    n32 m_used{0}; // commands written into the current chunk
+};
+} // namespace Humongous
@@ -8,11 +8,21 @@
 
 #include <vk_mem_alloc.h>
 
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
 namespace Humongous
 {
 class LogicalDevice : NonCopyable
 {
 public:
+    enum class QueueType : n8
+    {
+        GRAPHICS,
+        TRANSFER // the dedicated transfer queue when the device has one, the graphics queue otherwise
+    };
+
     LogicalDevice(Instance& instance, PhysicalDevice& physicalDevice);
     ~LogicalDevice();
 
@@ -22,33 +32,85 @@ public:
     vk::Queue GetGraphicsQueue() const { return m_graphicsQueue; }
     vk::Queue GetPresentQueue() const { return m_presentQueue; }
 
+    vk::Queue GetTransferQueue() const { return m_transferQueue; }
+
     n32 GetGraphicsQueueIndex() const { return m_graphicsQueueIndex; }
     n32 GetPresentQueueIndex() const { return m_presentQueueIndex; }
+    n32 GetTransferQueueIndex() const { return m_transferQueueIndex; }
+
+    // resources written on a dedicated transfer queue have to be handed over to the graphics family before they're used
+    bool HasDedicatedTransferQueue() const { return m_transferQueueIndex != m_graphicsQueueIndex; }
 
     VmaAllocator GetVmaAllocator() const { return m_allocator; }
 
-    vk::CommandBuffer BeginSingleTimeCommands();
+    bool SupportsBCTextures() const { return m_textureCompressionBC; }
+    bool SupportsDrawIndirectCount() const { return m_drawIndirectCount; }
+    // without it every indirect draw call can only read a single command
+    bool SupportsMultiDrawIndirect() const { return m_multiDrawIndirect; }
+
+    // the graphics and present queue may be the same VkQueue, anything submitting to or presenting on them has to hold this
+    std::mutex& GetQueueMutex() { return m_queueMutex; }
+
+    // waiting for the device idle touches every queue, so uploads from other threads are held off until it returns
+    void WaitIdle();
+
+    // safe to call from any thread, every thread records into its own command pool and only waits for its own submission
+    vk::CommandBuffer BeginSingleTimeCommands(QueueType queue = QueueType::GRAPHICS);
     void              EndSingleTimeCommands(vk::CommandBuffer cmd);
 
+    // EndSingleTimeCommands in two halves, so the caller can do other work while the gpu runs the commands.
+    // the retire has to happen on the thread that began the commands
+    vk::Fence SubmitSingleTimeCommands(vk::CommandBuffer cmd);
+    void      RetireSingleTimeCommands(vk::CommandBuffer cmd, vk::Fence fence, QueueType queue = QueueType::GRAPHICS);
+
+    // runs transferCmd on the transfer queue and graphicsCmd on the graphics queue once the transfer has finished,
+    // the fence signals when both are done. graphicsCmd is where the transferred resources get acquired
+    vk::Fence SubmitUploadCommands(vk::CommandBuffer transferCmd, vk::CommandBuffer graphicsCmd);
+    // gives a command buffer back to its pool without waiting on anything
+    void FreeSingleTimeCommands(vk::CommandBuffer cmd, QueueType queue);
+
 private:
     Instance& m_instance;
 
     vk::Device      m_logicalDevice = VK_NULL_HANDLE;
     PhysicalDevice* m_physicalDevice;
 
+    struct ThreadCommandPools
+    {
+        vk::CommandPool graphics{VK_NULL_HANDLE};
+        vk::CommandPool transfer{VK_NULL_HANDLE};
+    };
+
     vk::Queue m_graphicsQueue;
     vk::Queue m_presentQueue;
+    vk::Queue m_transferQueue;
     n32       m_graphicsQueueIndex;
     n32       m_presentQueueIndex;
+    n32       m_transferQueueIndex;
 
     VmaAllocator m_allocator;
 
-    vk::CommandPool m_commandPool;
+    bool m_textureCompressionBC{false};
+    bool m_drawIndirectCount{false};
+    bool m_multiDrawIndirect{false};
+
+    std::mutex m_queueMutex;
+    std::mutex m_transferQueueMutex;
+
+    // the transfer queue signals it, the graphics queue waits on it. values are handed out under m_transferQueueMutex
+    // so they're signalled in increasing order
+    vk::Semaphore m_uploadTimeline{VK_NULL_HANDLE};
+    n64           m_uploadTimelineValue{0};
+
+    std::unordered_map<std::thread::id, ThreadCommandPools> m_commandPools;
+    std::mutex                                              m_commandPoolMutex;
 
     void CreateLogicalDevice(Instance& instance, PhysicalDevice& physicalDevice);
     void CreateVmaAllocator(Instance& instance, PhysicalDevice& physicalDevice);
-    void CreateCommandPool(PhysicalDevice& physicalDevice);
+    void CreateUploadTimeline();
+
+    vk::CommandPool GetThreadCommandPool(QueueType queue);
 
-    std::vector<vk::DeviceQueueInfo2> CreateQueues(PhysicalDevice& physicalDevice);
+    std::vector<vk::DeviceQueueCreateInfo> CreateQueues(const float* priority);
 };
 } // namespace Humongous
@@ -64,7 +64,6 @@ struct Material
         bool metallicRoughness = true;
         bool specularGlossiness = false;
     } pbrWorkflows;
-    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
     int             index = 0;
     std::string     name = "";
     bool            unlit = false;
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "defines.hpp"
+#include "mapped_file.hpp"
+#include <array>
+#include <string>
+#include <vector>
+
+namespace Humongous
+{
+/***
+ * Baked form of an imported model (.hgmesh), written the first time a model is imported and memory mapped on later loads.
+ * The file is a header followed by a flat list of sections, every section is an array of the POD records below
+ * and starts on a 16 byte boundary. Bump VERSION whenever the layout of anything in here changes.
+ * */
+class MeshCache
+{
+public:
+    static constexpr n32 MAGIC = 0x48534D48; // "HMSH"
+    static constexpr n32 VERSION = 6;
+
+    enum Section : n32
+    {
+        SECTION_VERTICES,
+        SECTION_INDICES,
+        SECTION_SHORT_INDICES,
+        SECTION_NODES,
+        SECTION_PRIMITIVES,
+        SECTION_MESHLETS,
+        SECTION_LODS,
+        SECTION_MATERIALS,
+        SECTION_TEXTURES,
+        SECTION_SAMPLERS,
+        SECTION_IMAGES,
+        SECTION_STRINGS,
+        SECTION_COUNT
+    };
+
+    struct SourceInfo
+    {
+        n64 size = 0;
+        s64 modifiedTime = 0;
+        n64 contentHash = 0;
+    };
+
+    struct SectionRange
+    {
+        n64 offset = 0;
+        n64 size = 0;
+    };
+
+    struct Header
+    {
+        n32          magic = MAGIC;
+        n32          version = VERSION;
+        n32          vertexStride = 0;
+        n32          vertexFormat = 0; // VertexFormat the vertex section was encoded with
+        n32          optimized = 0;    // ModelImportSettings::optimizeMeshes
+        n32          generatedLods = 0; // ModelImportSettings::generateLods
+        SourceInfo   source{};
+        f32          dimensionsMin[3]{};
+        f32          dimensionsMax[3]{};
+        SectionRange sections[SECTION_COUNT]{};
+    };
+
+    struct BoundsRecord
+    {
+        f32 min[3];
+        f32 max[3];
+        n32 valid;
+    };
+
+    // nodes are stored in the model's linear node order, children always come before their parent
+    struct NodeRecord
+    {
+        s32          parent;         // index into the node records, -1 for root nodes
+        n32          index;          // glTF node index
+        s32          firstPrimitive; // -1 if the node has no mesh
+        n32          primitiveCount;
+        n32          nameOffset;
+        n32          nameLength;
+        f32          translation[3];
+        f32          scale[3];
+        f32          rotation[4]; // x, y, z, w
+        f32          matrix[16];
+        BoundsRecord meshBounds;
+        BoundsRecord bvh;
+        BoundsRecord aabb;
+    };
+
+    struct PrimitiveRecord
+    {
+        n32          firstIndex; // into the index section matching indexType
+        n32          indexCount;
+        n32          firstVertex;
+        n32          vertexCount;
+        n32          indexType; // VkIndexType
+        s32          material; // -1 uses the model's default material
+        BoundsRecord bounds;
+        n32          firstMeshlet; // into the meshlet section, stored as Utils::Meshlet
+        n32          meshletCount;
+        n32          firstLod; // into the lod section, stored as PrimitiveLod
+        n32          lodCount;
+    };
+
+    // texture references are indices into the texture records, -1 if unused
+    struct MaterialRecord
+    {
+        s32 alphaMode;
+        f32 alphaCutoff;
+        f32 metallicFactor;
+        f32 roughnessFactor;
+        f32 baseColorFactor[4];
+        f32 emissiveFactor[4];
+        s32 baseColorTexture;
+        s32 metallicRoughnessTexture;
+        s32 normalTexture;
+        s32 occlusionTexture;
+        s32 emissiveTexture;
+        s32 specularGlossinessTexture;
+        s32 diffuseTexture;
+        f32 diffuseFactor[4];
+        f32 specularFactor[3];
+        n8  texCoordSets[6];
+        n8  doubleSided;
+        n8  metallicRoughness;
+        n8  specularGlossiness;
+        n8  unlit;
+        s32 index;
+        f32 emissiveStrength;
+        n32 nameOffset;
+        n32 nameLength;
+    };
+
+    struct TextureRecord
+    {
+        s32 image;
+        s32 sampler; // -1 uses the default sampler
+    };
+
+    struct SamplerRecord
+    {
+        s32 magFilter;
+        s32 minFilter;
+        s32 addressModeU;
+        s32 addressModeV;
+        s32 addressModeW;
+    };
+
+    // images are not duplicated into the cache, this is the byte range of the encoded image inside the source file
+    struct ImageRecord
+    {
+        n64 offset;
+        n64 size;
+    };
+
+    class Writer
+    {
+    public:
+        void SetSection(Section section, const void* data, n64 size) { m_sections[section] = {data, size}; }
+
+        template <typename T> void SetSection(Section section, const std::vector<T>& records)
+        {
+            SetSection(section, records.data(), records.size() * sizeof(T));
+        }
+
+        // writes the cache next to the other baked assets, the source info in the header is filled in here
+        bool Save(const std::string& sourcePath, Header header);
+
+    private:
+        struct Blob
+        {
+            const void* data = nullptr;
+            n64         size = 0;
+        };
+
+        std::array<Blob, SECTION_COUNT> m_sections{};
+    };
+
+    static std::string GetCachePath(const std::string& sourcePath);
+    static bool        QuerySource(const std::string& sourcePath, SourceInfo& info, bool hashContents);
+
+    // finds the file offset of the binary chunk of a .glb, buffer 0 of the glTF lives there
+    static bool FindGLBBinaryChunk(const std::string& sourcePath, n64& offset);
+
+    // maps the cache belonging to sourcePath, fails if there is none or if it is stale, corrupt or from another version
+    bool Open(const std::string& sourcePath);
+    void Close() { m_file.Close(); }
+
+    const Header& GetHeader() const { return m_header; }
+
+    const n8* GetSectionData(Section section) const { return m_file.GetData() + m_header.sections[section].offset; }
+    n64       GetSectionSize(Section section) const { return m_header.sections[section].size; }
+
+    template <typename T> const T* GetRecords(Section section, n32& count) const
+    {
+        count = static_cast<n32>(GetSectionSize(section) / sizeof(T));
+        return reinterpret_cast<const T*>(GetSectionData(section));
+    }
+
+private:
+    Utils::MappedFile m_file;
+    Header            m_header{};
+};
+} // namespace Humongous
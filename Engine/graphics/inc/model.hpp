@@ -8,8 +8,13 @@
 
 #include "abstractions/buffer.hpp"
 #include "abstractions/descriptor_pool_growable.hpp"
+#include "command_recorder.hpp"
+#include "indirect_draw_buffer.hpp"
 #include "logical_device.hpp"
 #include "material.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "upload_batch.hpp"
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
@@ -18,12 +23,16 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
 
+#include <atomic>
+#include <memory>
+
 // ERROR is already defined in wingdi.h and collides with a define in the Draco headers
 #if defined(_WIN32) && defined(ERROR) && defined(TINYGLTF_ENABLE_DRACO)
 #undef ERROR
 #pragma message("ERROR constant already defined, undefining")
 #endif
 
+#include <camera.hpp>
 #include <scene.hpp>
 
 #define TINYGLTF_NO_STB_IMAGE_WRITE
@@ -31,10 +40,111 @@
 
 namespace Humongous
 {
+/***
+ * layout of the vertex stream a model gets uploaded with, picked at import time.
+ * FULL is the std140 Model::Vertex, COMPACT packs normals, uvs and color into 28 bytes
+ * and QUANTIZED additionally stores positions as unorm16 relative to the mesh bounds (24 bytes).
+ * */
+enum class VertexFormat : n32
+{
+    FULL,
+    COMPACT,
+    QUANTIZED,
+    COUNT
+};
+
+struct ModelImportSettings
+{
+    VertexFormat vertexFormat = VertexFormat::FULL;
+    // welds duplicate vertices and reorders triangles and vertices for the post transform cache, overdraw and vertex fetch
+    bool optimizeMeshes = false;
+    // simplifies every primitive into a chain of lower detail index ranges, primitives with MSFT_lod levels keep those instead
+    bool generateLods = true;
+    // block compresses sampled images at import (BC1/BC3 color, BC5 normals, BC4 occlusion) and keeps them in the texture cache.
+    // ignored on devices without BC support
+    bool compressTextures = true;
+    // how the cpu built mip chains of glTF images are filtered, color is always filtered in linear space
+    Utils::MipFilter mipFilter = Utils::MipFilter::KAISER;
+};
+
+// per frame culling counters, filled by SimpleRenderSystem and Model::Draw
+struct RenderStats
+{
+    n32 clustersTested = 0;
+    n32 clustersDrawn = 0;
+    n32 drawCalls = 0;
+    n32 indirectCalls = 0; // vkCmdDrawIndexedIndirect calls the indexed draws were submitted with
+    n32 triangles = 0;
+    n32 reducedLods = 0;    // primitives drawn below full detail
+    n32 objectsTooSmall = 0; // objects skipped for covering too few pixels
+    n32 objectsLoading = 0;  // objects whose model is still streaming in
+    n32 bindsIssued = 0;     // pipelines, descriptor sets, index buffers and push constants recorded
+    n32 bindsSkipped = 0;    // binds dropped because they matched what was already bound, see CommandRecorder
+    f32 recordMs = 0.0f;     // cpu time SimpleRenderSystem spent recording the frame
+    f32 cullMs = 0.0f;       // part of it spent finding the objects inside the frustum
+    // draws, triangles and reduced levels of detail were counted by the culling compute shader, a few frames ago
+    bool gpuCulled = false;
+    n32  primitivesCulled = 0; // outside the frustum, on their own or with their node
+};
+
+class Model;
+
+// world space bounds of a model's nodes and primitives as one object places them.
+// the object keeps them between frames, Model::Draw only rebuilds them once its matrix, its model or one of the model's nodes changed
+struct WorldBounds
+{
+    struct MeshBounds
+    {
+        glm::mat4   transform{1.f}; // object matrix times the node's
+        glm::mat4   inverse{1.f};   // meshlet cones are tested in mesh space
+        BoundingBox box;            // invalid for meshes without bounds, those are never culled
+        f32         scale = 1.0f;   // largest axis of transform
+    };
+
+    const Model*            model = nullptr;
+    glm::mat4               modelMatrix{0.f};
+    n32                     transformGeneration = 0; // the model's, see Model::m_transformGeneration
+    std::vector<MeshBounds> meshes;      // by Mesh::m_meshIndex
+    std::vector<glm::vec4>  primitives;  // by Primitive::m_drawIndex, center and radius, the radius is negative without bounds
+    std::vector<n8>         meshVisible; // refreshed by every Draw
+};
+
+// what Model::Draw needs to cull meshlets and pick levels of detail, in world space
+struct DrawCullInfo
+{
+    glm::mat4            modelMatrix{1.f};
+    std::array<Plane, 6> frustumPlanes;
+    glm::vec3            cameraPosition{0.f};
+    f32                  viewportHeight = 0.0f;
+    f32                  pixelsPerUnit = 0.0f; // projected size in pixels of one unit at a distance of one unit
+    f32                  lodErrorPixels = 1.0f;
+    RenderStats*         stats = nullptr;
+    WorldBounds*         bounds = nullptr; // the drawn object's, built from scratch every Draw without them
+};
+
+// a reduced level of detail of a primitive, the primitive's own range is LOD 0
+struct PrimitiveLod
+{
+    n32         firstIndex; // into the index buffer matching indexType
+    n32         indexCount; // 0 for non indexed MSFT_lod levels
+    n32         firstVertex;
+    n32         vertexCount;
+    VkIndexType indexType;
+    f32         error;    // simplification error in mesh units, used while coverage is 0
+    f32         coverage; // MSFT_lod levels are used once the primitive covers less than this fraction of the screen height
+};
+
 struct Primitive
 {
     Node*       m_owner;
-    n32         m_firstIndex;
+    n32         m_firstIndex; // into the index buffer matching m_indexType
+    n32         m_firstVertex{0};
+    VkIndexType m_indexType{VK_INDEX_TYPE_UINT32};
+    n32         m_firstMeshlet{0}; // into Model::m_meshlets, primitives without meshlets are drawn whole
+    n32         m_meshletCount{0};
+    n32         m_firstLod{0}; // into Model::m_lods, from fine to coarse
+    n32         m_lodCount{0};
+    n32         m_drawIndex{0}; // into the model's draw data, draws pass it in as firstInstance
     n32         m_indexCount;
     n32         m_vertexCount;
     Material&   m_material;
@@ -52,19 +162,25 @@ struct Mesh
     std::vector<Primitive*> m_primitives;
     BoundingBox             m_bb;
     BoundingBox             m_aabb;
-    struct UniformBuffer
-    {
-        Buffer                 uniformBuffer;
-        VkDescriptorBufferInfo descriptorInfo;
-        VkDescriptorSet        descriptorSet = VK_NULL_HANDLE;
-    } m_uniformBuffer;
+
+    // one block per mesh in the model's mesh buffer, which only exists once the model has been initialized
+    Buffer* m_meshBuffer = nullptr;
+    n32     m_meshIndex = 0;
+    n32*    m_transformGeneration = nullptr; // the model's, set together with m_meshBuffer
 
     struct UniformBlock
     {
         glm::mat4 matrix{1.f};
+        // quantized positions are dequantized with offset + scale * position
+        glm::vec4 dequantOffset{0.f};
+        glm::vec4 dequantScale{1.f};
     } m_uniformBlock;
 
     void SetBoundingBox(glm::vec3 min, glm::vec3 max);
+    // quantizes positions against the mesh bounds, needs to happen before the node matrix gets written
+    void SetDequantization(glm::vec3 offset, glm::vec3 scale);
+    // copies m_uniformBlock into the mesh buffer, if there is one yet, and bumps the model's transform generation
+    void WriteUniformBlock();
 };
 
 class Model
@@ -74,8 +190,49 @@ public:
     {
         glm::mat4       model{1.f};    // 16 bytes (4x4 matrix)
         VkDeviceAddress vertexAddress; // 8 bytes (assuming 64-bit)
+        // gpu culled draws look up their object and draw index through firstInstance instead, see GpuCuller
+        VkDeviceAddress drawRecordAddress{0};
+        VkDeviceAddress objectAddress{0};
+    };
+
+    // what cull.comp.glsl knows about a primitive, one per draw index
+    struct GpuPrimitive
+    {
+        glm::vec4 sphere; // mesh space bounds, a negative radius is never culled
+        n32       meshIndex;
+        n32       list;  // 0 for 16 bit indices, 1 for 32 bit and 2 for non indexed draws
+        n32       count; // indices, or vertices for non indexed draws
+        n32       first; // first index, or first vertex for non indexed draws
+        s32       vertexOffset;
+        n32       firstLod; // into the model's GpuLods
+        n32       lodCount;
+        n32       padding;
+    };
+
+    struct GpuLod
+    {
+        n32 list;
+        n32 count;
+        n32 first;
+        s32 vertexOffset;
+        f32 error;
+        f32 coverage;
+        n32 padding[2];
+    };
+
+    // the commands GpuCuller wrote for one model, per list the commands start at commandOffsets and their count is at countOffsets
+    struct IndirectCountDraw
+    {
+        VkBuffer     commands;
+        VkDeviceSize commandOffsets[3];
+        VkBuffer     counts;
+        VkDeviceSize countOffsets[3];
+        n32          maxDraws; // per list
     };
 
+    // commands GpuCuller writes are this large, non indexed ones leave the last word unused
+    static constexpr n32 INDIRECT_COMMAND_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+
     struct alignas(16) Vertex
     {
         alignas(16) glm::vec3 position; // 12 bytes (aligned to 16 bytes)
@@ -90,15 +247,72 @@ public:
         }
     };
 
-    Model(LogicalDevice* device, const std::string& modelPath, float scale);
+    // VertexFormat::COMPACT, read as scalars by simple_compact.vert
+    struct CompactVertex
+    {
+        glm::vec3 position;
+        n32       normal; // octahedral, snorm16x2
+        n32       uv0;    // half2
+        n32       uv1;    // half2
+        n32       color;  // rgba8 unorm
+    };
+
+    // VertexFormat::QUANTIZED, read as scalars by simple_quantized.vert
+    struct QuantizedVertex
+    {
+        n32 positionXY; // unorm16x2 within the mesh bounds
+        n32 positionZ;  // unorm16, upper half unused
+        n32 normal;
+        n32 uv0;
+        n32 uv1;
+        n32 color;
+    };
+
+    enum class LoadState : n8
+    {
+        LOADING,
+        READY,
+        FAILED
+    };
+
+    // loads synchronously on the calling thread
+    Model(LogicalDevice* device, const std::string& modelPath, float scale, const ModelImportSettings& settings = {});
     ~Model();
 
-    Buffer& GetVertexBuffer() { return m_vertices; }
+    /***
+     * returns right away and loads the model on the job system, file io, decoding and the gpu uploads all happen on a worker.
+     * the model may only be initialized and drawn once IsReady() returns true, everything it owns is resident by then
+     * */
+    static std::shared_ptr<Model> LoadAsync(LogicalDevice* device, const std::string& modelPath, float scale,
+                                            const ModelImportSettings& settings = {});
+
+    LoadState GetLoadState() const { return m_loadState.load(std::memory_order_acquire); }
+    bool      IsReady() const { return GetLoadState() == LoadState::READY; }
+
+    // geometry and texture memory on the device, only meaningful once the model is ready
+    VkDeviceSize GetResidentBytes() const { return m_residentBytes; }
+
+    Buffer&      GetVertexBuffer() { return m_vertices; }
+    VertexFormat GetVertexFormat() const { return m_importSettings.vertexFormat; }
+
+    static n32 GetVertexStride(VertexFormat format);
 
-    void Init(DescriptorSetLayout* materialLayout, DescriptorSetLayout* nodeLayout, DescriptorSetLayout* materialBufferLayout,
-              DescriptorPoolGrowable* imagePool, DescriptorPoolGrowable* uniformPool, DescriptorPoolGrowable* storagePool);
+    void Init(DescriptorSetLayout* drawDataLayout, DescriptorSetLayout* materialBufferLayout, DescriptorPoolGrowable* storagePool);
 
-    void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout& pipelineLayout);
+    // without cull info every primitive is drawn whole at full detail. with it nodes and primitives outside the frustum are skipped,
+    // the rest get their level of detail from the projected error and full detail meshlets outside the frustum or facing away are skipped.
+    // indexed draws are written into indirectBuffer and go out with one vkCmdDrawIndexedIndirect per index type
+    void Draw(CommandRecorder& recorder, IndirectDrawBuffer& indirectBuffer, VkPipelineLayout& pipelineLayout,
+              const DrawCullInfo* cullInfo = nullptr);
+    // draws the commands GpuCuller compacted, the gpu decides how many there are
+    void DrawIndirectCount(CommandRecorder& recorder, VkPipelineLayout& pipelineLayout, const IndirectCountDraw& draw,
+                           RenderStats* stats = nullptr);
+
+    // what the culling compute shader reads, only valid once the model has been initialized
+    n32             GetDrawCount() const { return m_drawCount; }
+    VkDeviceAddress GetGpuPrimitiveAddress() { return m_gpuPrimitiveBuffer.GetDeviceAddress(); }
+    VkDeviceAddress GetGpuLodAddress() { return m_gpuLodBuffer.GetDeviceAddress(); }
+    VkDeviceAddress GetMeshAddress() { return m_meshBuffer.GetDeviceAddress(); }
 
     glm::mat4 GetAABB() const { return m_aabb; }
 
@@ -112,22 +326,61 @@ public:
 
 private:
     Buffer m_vertices;
-    Buffer m_indices;
+    Buffer m_indices;      // 32 bit indices
+    Buffer m_shortIndices; // 16 bit indices of primitives with less than 65536 vertices
 
     LogicalDevice* m_device;
 
+    ModelImportSettings m_importSettings{};
+
+    // written by the loading thread once it is done, the release store publishes everything the load wrote
+    std::atomic<LoadState> m_loadState{LoadState::LOADING};
+
+    VkDeviceSize m_residentBytes{0};
+
     glm::mat4 m_aabb;
 
     std::vector<Node*> m_nodes;
     std::vector<Node*> m_linearNodes;
 
-    Texture                                          m_emptyTexture;
     std::vector<Texture>                             m_textures;
+    std::vector<n64>                                 m_textureKeys; // one per texture, see TextureRegistry
     std::vector<Texture::TexSamplerInfo>             m_textureSamplers;
     std::vector<Material>                            m_materials;
     std::unordered_map<n32, std::vector<Primitive*>> m_materialBatches;
+    std::vector<Utils::Meshlet>                      m_meshlets;
+    std::vector<PrimitiveLod>                        m_lods;
 
     VkDescriptorSet m_descriptorSetMaterials{VK_NULL_HANDLE};
+
+    // what the vertex shader looks up through firstInstance, one per primitive
+    struct DrawData
+    {
+        n32 meshIndex;
+        n32 materialIndex;
+    };
+    Buffer          m_meshBuffer;     // Mesh::UniformBlock of every mesh, host visible so node updates write straight into it
+    Buffer          m_drawDataBuffer; // DrawData in draw index order
+    VkDescriptorSet m_descriptorSetDraws{VK_NULL_HANDLE};
+    Buffer          m_gpuPrimitiveBuffer; // GpuPrimitive in draw index order
+    Buffer          m_gpuLodBuffer;
+    n32             m_drawCount{0};
+    n32             m_meshCount{0};
+    // bumped whenever a node matrix is written into the mesh buffer, WorldBounds built before that are stale
+    n32             m_transformGeneration{0};
+    // most draws a single Draw can write, 16 bit indices, then 32 bit indices, then non indexed
+    n32 m_maxIndirectDraws[3]{};
+
+    // the draws of one Draw call, one list per index type and one for non indexed draws
+    struct DrawList
+    {
+        IndirectDrawBuffer::Allocation allocations[3];
+        n32                            counts[3]{};
+        n32                            capacities[3]{};
+
+        void Add(VkIndexType indexType, n32 indexCount, n32 firstIndex, n32 vertexOffset, n32 drawIndex);
+        void AddNonIndexed(n32 vertexCount, n32 firstVertex, n32 drawIndex);
+    };
     enum PBRWorkflows
     {
         PBR_WORKFLOW_METALLIC_ROUGHNESS = 0,
@@ -151,42 +404,118 @@ private:
         float     alphaMask;
         float     alphaMaskCutoff;
         float     emissiveStrength;
+        // image and sampler slot of every texture in the BindlessTextures arrays, unused textures point at a default one
+        n32 colorTexture;
+        n32 colorSampler;
+        n32 physicalDescriptorTexture;
+        n32 physicalDescriptorSampler;
+        n32 normalTexture;
+        n32 normalSampler;
+        n32 occlusionTexture;
+        n32 occlusionSampler;
+        n32 emissiveTexture;
+        n32 emissiveSampler;
     };
     Buffer m_shaderMaterialBuffer;
 
     Dimensions m_dimensions;
 
+    // where a single glTF primitive ends up in the shared vertex/index arrays
+    struct PrimitiveLoadJob
+    {
+        const tinygltf::Primitive* primitive;
+        Primitive*                 target;
+        n32                        vertexStart;
+        n32                        indexStart;
+        VkIndexType                indexType;
+        bool                       hasIndices;
+        Primitive*                 lodOf = nullptr; // MSFT_lod level of another primitive, target is dropped once it has been folded in
+        f32                        lodCoverage = 0.0f;
+    };
+
+    // indices are local to their primitive, draws add the primitive's first vertex through vertexOffset
     struct LoaderInfo
     {
-        n32*    indexBuffer;
-        Vertex* vertexBuffer;
-        size_t  indexPos = 0;
-        size_t  vertexPos = 0;
+        n32*                          indexBuffer = nullptr;
+        n16*                          shortIndexBuffer = nullptr;
+        Vertex*                       vertexBuffer = nullptr;
+        size_t                        indexPos = 0;
+        size_t                        shortIndexPos = 0;
+        size_t                        vertexPos = 0;
+        std::vector<PrimitiveLoadJob> primitiveJobs;
+        // optimized primitives get their final index type once their vertex count is known
+        bool                          deferIndexType = false;
+        // vertex cache before optimizing, it is compared against the final order once meshlets are built
+        Utils::VertexCacheStats cacheBefore{};
+
+        // the arrays above are decoded straight into mapped staging memory and uploaded from there.
+        // vertices only are for VertexFormat::FULL, packed formats decode into vertexScratch and encode into staging later
+        std::unique_ptr<Buffer>   vertexStaging;
+        std::unique_ptr<Buffer>   indexStaging;
+        std::unique_ptr<Buffer>   shortIndexStaging;
+        std::unique_ptr<Vertex[]> vertexScratch;
+    };
+
+    struct GeometryData
+    {
+        const void* vertices = nullptr;
+        size_t      vertexSize = 0;
+        const void* indices = nullptr;
+        size_t      indexSize = 0;
+        const void* shortIndices = nullptr;
+        size_t      shortIndexSize = 0;
+        // set when the data already sits in staging memory, the upload then skips the copy into a temporary staging buffer
+        Buffer* vertexStaging = nullptr;
+        Buffer* indexStaging = nullptr;
+        Buffer* shortIndexStaging = nullptr;
     };
 
     bool m_initialized{false};
     // TODO: maybe move the shader material buffer and this out?
     // maybe only write at draw time?
-    void CreateMaterialBuffer();
+    void CreateMaterialBuffer(UploadBatch& upload);
+    void CreateDrawBuffers(UploadBatch& upload);
     void UpdateShaderMaterialBuffer(Node* node);
     void UpdateUBO(Node* node, glm::mat4 matrix);
     void UpdateMaterialBatches(Node* node);
 
     void Destroy(VkDevice m_device);
     void LoadNode(Node* parent, const tinygltf::Node& node, n32 nodeIndex, const tinygltf::Model& model, LoaderInfo& loaderInfo, float globalscale);
-    void GetNodeProps(const tinygltf::Node& node, const tinygltf::Model& model, size_t& vertexCount, size_t& indexCount);
-    void LoadTextures(tinygltf::Model& gltfModel, LogicalDevice* m_device, VkQueue transferQueue);
+    Primitive* LoadPrimitive(const tinygltf::Primitive& primitive, Node* owner, const tinygltf::Model& model, LoaderInfo& loaderInfo);
+    void       LoadAuthoredLods(const tinygltf::Node& node, Mesh* mesh, const tinygltf::Model& model, LoaderInfo& loaderInfo);
+    void DecodePrimitive(const PrimitiveLoadJob& job, const tinygltf::Model& model, LoaderInfo& loaderInfo);
+    void OptimizeGeometry(LoaderInfo& loaderInfo);
+    void BuildMeshlets(LoaderInfo& loaderInfo);
+    void GenerateLods(LoaderInfo& loaderInfo);
+    void LoadTextures(tinygltf::Model& gltfModel, UploadBatch& upload, const std::vector<Utils::CompressedImage>& compressedImages,
+                      const std::vector<n64>& imageKeys);
+    void AcquireTexture(size_t index, n64 imageKey, const Texture::TexSamplerInfo& textureSampler, tinygltf::Image& image,
+                        const Utils::CompressedImage& compressed, UploadBatch& upload);
     VkSamplerAddressMode GetVkWrapMode(s32 wrapMode);
     VkFilter             GetVkFilterMode(s32 filterMode);
     void                 LoadTextureSamplers(tinygltf::Model& gltfModel);
     void                 LoadMaterials(tinygltf::Model& gltfModel);
-    void                 LoadFromFile(std::string filename, LogicalDevice* device, VkQueue transferQueue, float scale = 1.0f);
-    void                 DrawNode(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout& pipelineLayout);
+    Model(LogicalDevice* device, const ModelImportSettings& settings);
+
+    void                 Load(const std::string& modelPath, float scale);
+    bool                 LoadFromFile(std::string filename, LogicalDevice* device, float scale = 1.0f);
+    void                 BindIndexBuffer(CommandRecorder& recorder, VkIndexType indexType);
+    void                 DrawPrimitive(CommandRecorder& recorder, DrawList& drawList, const Primitive* primitive);
+    void                 DrawPrimitiveCulled(CommandRecorder& recorder, DrawList& drawList, const Primitive* primitive,
+                                             const DrawCullInfo& cullInfo, const WorldBounds& bounds);
+    void                 UpdateWorldBounds(WorldBounds& bounds, const glm::mat4& modelMatrix) const;
+    void                 SubmitDrawList(CommandRecorder& recorder, const DrawList& drawList, RenderStats* stats);
+    const PrimitiveLod*  SelectLod(const Primitive* primitive, glm::vec3 center, f32 radius, f32 scale, const DrawCullInfo& cullInfo) const;
+    void                 EncodeVertices(const Vertex* vertices, size_t vertexCount, n8* encoded);
+    void                 SetupDequantization();
+    void                 CreateGeometryBuffers(const GeometryData& geometry, UploadBatch& upload);
+    bool                 LoadFromCache(const MeshCache& cache, const std::string& filename);
+    void                 SaveToCache(const std::string& filename, const tinygltf::Model& gltfModel, const GeometryData& geometry);
     void                 CalculateBoundingBox(Node* node, Node* parent);
     void                 GetSceneDimensions();
+    void                 CalculateSceneAABB();
     Node*                FindNode(Node* parent, n32 index);
     Node*                NodeFromIndex(n32 index);
     void                 SetupDescriptorSet(Node* node);
-    void                 SetupNodeDescriptorSet(Node* node, DescriptorPoolGrowable* descriptorPool, DescriptorSetLayout* layout);
 };
 } // namespace Humongous
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "model.hpp"
+#include "non_copyable.hpp"
+#include "singleton.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Humongous
+{
+/***
+ * hands out shared models keyed by their resolved path and import settings. asking for an asset that is still alive
+ * returns the same model instead of parsing and uploading it again.
+ * the cache only keeps weak references, a model is freed as soon as its last user lets go of it
+ * */
+class ModelCache : public Singleton<ModelCache>, NonCopyable
+{
+public:
+    struct Residency
+    {
+        std::string  path;
+        n32          users; // handles held outside the cache
+        VkDeviceSize bytes; // zero while the model is still loading
+    };
+
+    // on a miss the model is loaded with Model::LoadAsync
+    static std::shared_ptr<Model> Acquire(LogicalDevice* device, const std::string& modelPath, float scale = 1.0f,
+                                          const ModelImportSettings& settings = {})
+    {
+        return Get().Internal_Acquire(device, modelPath, scale, settings);
+    }
+
+    static std::vector<Residency> GetResidency() { return Get().Internal_GetResidency(); }
+    static VkDeviceSize           GetResidentBytes() { return Get().Internal_GetResidentBytes(); }
+
+private:
+    struct Entry
+    {
+        std::string          path;
+        std::weak_ptr<Model> model;
+    };
+
+    std::unordered_map<std::string, Entry> m_entries;
+    std::mutex                             m_mutex;
+
+    std::shared_ptr<Model> Internal_Acquire(LogicalDevice* device, const std::string& modelPath, float scale, const ModelImportSettings& settings);
+    std::vector<Residency> Internal_GetResidency();
+    VkDeviceSize           Internal_GetResidentBytes();
+
+    // expects m_mutex to be held
+    void EvictExpired();
+};
+} // namespace Humongous
@@ -19,6 +19,8 @@ public:
     {
         std::optional<n32> graphicsFamily;
         std::optional<n32> presentFamily;
+        // a family that can copy but not draw, only set when the device has one
+        std::optional<n32> transferFamily;
 
         bool IsComplete() { return graphicsFamily.has_value() && presentFamily.has_value(); }
     };
@@ -68,6 +70,7 @@ private:
 
     bool IsDeviceSuitable(vk::PhysicalDevice physicalDevice);
     bool CheckDeviceExtensionSupport(vk::PhysicalDevice physicalDevice);
+    bool CheckDeviceFeatureSupport(vk::PhysicalDevice physicalDevice);
 
     const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 };
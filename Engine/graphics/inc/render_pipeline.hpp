@@ -16,6 +16,8 @@ public:
         std::string vertShaderPath;
         std::string fragShaderPath;
         bool        bindless;
+        // specialization constants of the vertex shader, optional
+        const VkSpecializationInfo* vertSpecializationInfo = nullptr;
 
         std::vector<VkVertexInputBindingDescription>   inputBindings;
         std::vector<VkVertexInputAttributeDescription> attribBindings;
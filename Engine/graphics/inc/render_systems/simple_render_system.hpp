@@ -3,9 +3,15 @@
 #include "abstractions/descriptor_layout.hpp"
 #include "abstractions/descriptor_pool_growable.hpp"
 #include "camera.hpp"
+#include "command_recorder.hpp"
+#include "frustum_culler.hpp"
+#include "gpu_culler.hpp"
+#include "indirect_draw_buffer.hpp"
 #include <gameobject.hpp>
+#include <array>
 #include <memory>
 #include <render_pipeline.hpp>
+#include <unordered_map>
 
 namespace Humongous
 {
@@ -18,12 +24,22 @@ struct RenderData
     n32                          frameIndex;
     Camera&                      cam;
     const glm::vec3              camPos;
+    f32                          viewportHeight;
+    // culls through the tree when set, every object is tested otherwise
+    AABBTree*                    objectTree = nullptr;
+    // counted while updating the objects, the tree only holds the loaded ones
+    n32                          objectsLoading = 0;
 };
 
 struct ShaderSet
 {
     std::string vertShaderPath;
     std::string fragShaderPath;
+    // vertex shaders for the packed vertex formats, models using a format without a shader are skipped
+    std::string compactVertShaderPath;
+    std::string quantizedVertShaderPath;
+    // culls on the gpu when set and the device supports drawIndirectCount, see GpuCuller
+    std::string cullShaderPath;
 };
 
 class SimpleRenderSystem
@@ -32,31 +48,67 @@ public:
     SimpleRenderSystem(LogicalDevice& logicalDevice, const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, const ShaderSet& shaderSet);
     ~SimpleRenderSystem();
 
+    // runs the broad phase and records the gpu culling pass for what survived it, has to happen before rendering begins.
+    // does nothing while culling on the cpu
+    void CullObjects(RenderData& renderData);
     void RenderObjects(RenderData& renderData);
-    s16  GetObjectsDrawn() { return m_objectsDrawn; }
+    n32  GetObjectsDrawn() { return m_objectsDrawn; }
+    const RenderStats& GetRenderStats() const { return m_renderStats; }
 
 private:
+    // levels of detail may be off by this many pixels on screen
+    static constexpr f32 LOD_ERROR_PIXELS = 1.0f;
+    // objects smaller than this on screen are skipped
+    static constexpr f32 MIN_OBJECT_PIXELS = 2.0f;
+    // how often the tree's culling is timed against testing every object, in frames. only with HG_CULL_BENCHMARK
+    static constexpr n32 CULL_BENCHMARK_INTERVAL = 600;
+
     LogicalDevice&                  m_logicalDevice;
-    std::unique_ptr<RenderPipeline> m_renderPipeline;
+    // one pipeline per VertexFormat, they only differ in the vertex shader
+    std::array<std::unique_ptr<RenderPipeline>, static_cast<size_t>(VertexFormat::COUNT)> m_renderPipelines;
     VkPipelineLayout                m_pipelineLayout{};
-    s16                             m_objectsDrawn{0};
+    n32                             m_objectsDrawn{0};
+    RenderStats                     m_renderStats{};
+    IndirectDrawBuffer              m_indirectDraws;
+    FrustumCuller                   m_frustumCuller;
+    std::vector<GameObject*>        m_cullCandidates;    // what the object tree's frustum query returned, or every loaded object
+    std::vector<n32>                m_visibleCandidates; // indices into m_cullCandidates
+    n32                             m_framesRendered{0};
+
+    // only created when culling on the gpu, the pipelines read their model matrix and draw index through the culling pass' records
+    std::unique_ptr<GpuCuller>                                                            m_gpuCuller;
+    std::array<std::unique_ptr<RenderPipeline>, static_cast<size_t>(VertexFormat::COUNT)> m_culledPipelines;
+    std::vector<GpuCuller::Batch>                                                         m_cullBatches;
+    std::unordered_map<Model*, n32>                                                       m_batchLookup;
+    std::vector<std::pair<n32, n32>>                                                      m_culledObjects; // object slot and batch
+    f32                                                                                   m_cullMs{0.0f};
+
+    // where an object's matrix lives in the culler's object buffer. objects stay in a scene for as long as it runs, so slots aren't reused
+    struct ObjectSlot
+    {
+        n32 object{0};
+        n32 transformVersion{0};
+    };
+    std::unordered_map<GameObject::id_t, ObjectSlot> m_objectSlots;
 
     struct DescriptorLayouts
     {
-        std::unique_ptr<DescriptorSetLayout> node;
-        std::unique_ptr<DescriptorSetLayout> material;
+        std::unique_ptr<DescriptorSetLayout> drawData;
         std::unique_ptr<DescriptorSetLayout> materialBuffers;
 
     } m_descriptorSetLayouts;
 
-    std::unique_ptr<DescriptorPoolGrowable> m_imageSamplerPool;
-    std::unique_ptr<DescriptorPoolGrowable> m_uniformPool;
     std::unique_ptr<DescriptorPoolGrowable> m_storagePool;
 
     void CreateModelDescriptorSetPool();
     void CreateModelDescriptorSetLayout();
     void AllocateDescriptorSet(n32 identifier, n32 index);
     void CreatePipelineLayout(const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts);
-    void CreatePipeline(const ShaderSet& shaderSet);
+    void CreatePipelines(const ShaderSet& shaderSet);
+    // the tree's frustum query followed by the exact box test, fills m_cullCandidates and m_visibleCandidates
+    void FindVisibleObjects(RenderData& renderData, const std::array<Plane, 6>& planes);
+    void DrawCulledBatches(CommandRecorder& recorder);
+    void DrawObject(GameObject& obj, const RenderData& renderData, CommandRecorder& recorder, DrawCullInfo& cullInfo);
+    void BenchmarkCulling(const RenderData& renderData, const std::array<Plane, 6>& planes, f32 treeMs);
 };
 } // namespace Humongous
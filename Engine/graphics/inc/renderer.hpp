@@ -42,6 +42,9 @@ public:
     // End a frame and submit command buffers
     void EndFrame();
 
+    // Get the swapchain's extent
+    vk::Extent2D GetExtent() const { return m_swapChain->GetExtent(); }
+
     // Get the swapchain's aspect ratio
     f32 GetAspectRatio() const { return static_cast<float>(m_swapChain->GetExtent().width) / static_cast<float>(m_swapChain->GetExtent().height); }
 
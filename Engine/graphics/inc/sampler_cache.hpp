@@ -0,0 +1,62 @@
+#pragma once
+
+#include "logical_device.hpp"
+#include "non_copyable.hpp"
+#include "singleton.hpp"
+#include <mutex>
+#include <unordered_map>
+
+namespace Humongous
+{
+/***
+ * device wide cache of samplers keyed by their full create info. scenes only use a handful of distinct sampler states, sharing them
+ * keeps large scenes well under maxSamplerAllocationCount.
+ * samplers handed out stay alive until Shutdown, users never destroy them
+ * */
+class SamplerCache : public Singleton<SamplerCache>, NonCopyable
+{
+public:
+    static void Init(LogicalDevice* device) { Get().Internal_Init(device); }
+    static void Shutdown() { Get().Internal_Shutdown(); }
+
+    // pNext chains aren't part of the key, samplers that need one have to be created by hand
+    static VkSampler GetSampler(const VkSamplerCreateInfo& createInfo) { return Get().Internal_GetSampler(createInfo); }
+
+private:
+    // every field of VkSamplerCreateInfo besides sType and pNext, all four bytes wide so there's no padding to hash
+    struct Key
+    {
+        VkSamplerCreateFlags flags;
+        VkFilter             magFilter;
+        VkFilter             minFilter;
+        VkSamplerMipmapMode  mipmapMode;
+        VkSamplerAddressMode addressModeU;
+        VkSamplerAddressMode addressModeV;
+        VkSamplerAddressMode addressModeW;
+        f32                  mipLodBias;
+        VkBool32             anisotropyEnable;
+        f32                  maxAnisotropy;
+        VkBool32             compareEnable;
+        VkCompareOp          compareOp;
+        f32                  minLod;
+        f32                  maxLod;
+        VkBorderColor        borderColor;
+        VkBool32             unnormalizedCoordinates;
+
+        bool operator==(const Key& other) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    LogicalDevice*                              m_device{nullptr};
+    std::unordered_map<Key, VkSampler, KeyHash> m_samplers;
+    std::mutex                                  m_mutex;
+
+    void      Internal_Init(LogicalDevice* device);
+    void      Internal_Shutdown();
+    VkSampler Internal_GetSampler(const VkSamplerCreateInfo& createInfo);
+};
+} // namespace Humongous
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "bindless_textures.hpp"
 #include "logical_device.hpp"
 #include <abstractions/buffer.hpp>
 #include <gli/gli.hpp>
 #include <renderer.hpp>
 #include <string>
+#include <texture_compressor.hpp>
 
 namespace tinygltf
 {
@@ -13,6 +15,8 @@ class Image;
 
 namespace Humongous
 {
+class UploadBatch;
+
 class Texture
 {
 public:
@@ -41,10 +45,24 @@ public:
     VkImageLayout GetRawImageLayout() const { return m_textureImage.imageLayout; }
     VkSampler     GetRawSamplerHandle() const { return m_textureSampler; }
 
+    // slots in the BindlessTextures arrays, only 2D textures created from image data are registered there
+    n32 GetBindlessImageIndex() const { return m_bindlessImage; }
+    n32 GetBindlessSamplerIndex() const { return m_bindlessSampler; }
+
+    // device memory backing the image, zero if it was never created
+    VkDeviceSize GetMemorySize() const;
+
     void Destroy();
 
-    void CreateFromGLTFImage(tinygltf::Image& gltfimage, TexSamplerInfo textureSampler, LogicalDevice* device, VkQueue copyQueue);
+    // records the upload into the batch, without one the texture is uploaded right away. the texture can't be sampled before the
+    // batch has retired. gltfimage holds the whole RGBA8 mip chain, see Utils::BuildMipChain
+    void CreateFromGLTFImage(tinygltf::Image& gltfimage, TexSamplerInfo textureSampler, LogicalDevice* device, UploadBatch* batch = nullptr);
+    // copies the blocks of every level in as they are, no mips are generated on the gpu
+    void CreateFromCompressedImage(const Utils::CompressedImage& image, TexSamplerInfo textureSampler, LogicalDevice* device,
+                                   UploadBatch* batch = nullptr);
     void CreateFromFile(const std::string& path, LogicalDevice* device, const ImageType& imageType = ImageType::TEX2D);
+    // a single RGBA8 texel with a linear, repeating sampler, uploaded right away
+    void CreateFromColor(const n8 rgba[4], LogicalDevice* device);
 
 private:
     struct SamplerCreateInfo
@@ -58,11 +76,16 @@ private:
 
     LogicalDevice* m_logicalDevice;
     AllocatedImage m_textureImage;
-    VkSampler      m_textureSampler;
+    VkSampler      m_textureSampler; // owned by the SamplerCache
+    n32            m_bindlessImage{BindlessTextures::INVALID_INDEX};
+    n32            m_bindlessSampler{BindlessTextures::INVALID_INDEX};
 
     n32 m_width, m_height, m_miplevels, m_layerCount;
 
     void CreateTextureImage(const std::string& imagePath, const ImageType& imageType = ImageType::TEX2D);
+    // levels are tightly packed in data, level 0 first
+    void CreateFromLevels(VkFormat format, n32 width, n32 height, const n8* data, VkDeviceSize size, const std::vector<VkDeviceSize>& levelOffsets,
+                          TexSamplerInfo textureSampler, UploadBatch* batch);
     void CreateTextureImageSampler(const SamplerCreateInfo& samplerInfo, const ImageType& imageType = ImageType::TEX2D);
 };
 }; // namespace Humongous
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "defines.hpp"
+#include "texture_compressor.hpp"
+#include <string>
+
+namespace Humongous
+{
+/***
+ * Block compressed images baked at import (.ktx2), keyed by a hash of the encoded source image, what the image is sampled as and the
+ * filter its mips were built with.
+ * The files are plain KTX2 with a single 2D image, a full mip chain and no supercompression, anything else reads as a miss.
+ * Images are looked up by content, so the same image embedded in several models is only ever compressed once.
+ * */
+class TextureCache
+{
+public:
+    static constexpr n8 IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A}; // "«KTX 20»\r\n\x1A\n"
+
+    struct Header
+    {
+        n8  identifier[12];
+        n32 vkFormat;
+        n32 typeSize;
+        n32 pixelWidth;
+        n32 pixelHeight;
+        n32 pixelDepth;
+        n32 layerCount;
+        n32 faceCount;
+        n32 levelCount;
+        n32 supercompressionScheme;
+        n32 dfdByteOffset;
+        n32 dfdByteLength;
+        n32 kvdByteOffset;
+        n32 kvdByteLength;
+        n64 sgdByteOffset;
+        n64 sgdByteLength;
+    };
+
+    // one per level, level 0 first. the level data itself is stored smallest level first
+    struct LevelIndex
+    {
+        n64 byteOffset;
+        n64 byteLength;
+        n64 uncompressedByteLength;
+    };
+
+    static std::string GetCachePath(n64 sourceHash, Utils::TextureRole role, Utils::MipFilter mipFilter);
+
+    static bool Load(n64 sourceHash, Utils::TextureRole role, Utils::MipFilter mipFilter, Utils::CompressedImage& image);
+    static bool Save(n64 sourceHash, Utils::TextureRole role, Utils::MipFilter mipFilter, const Utils::CompressedImage& image);
+};
+} // namespace Humongous
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "logical_device.hpp"
+#include "non_copyable.hpp"
+#include "singleton.hpp"
+#include "texture.hpp"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Humongous
+{
+/***
+ * textures shared by every model. entries are keyed by a hash of the source image together with everything that decides what ends
+ * up on the gpu (sampler state, block compression, mip filter), so an image used by several models is only uploaded once.
+ * entries are reference counted and destroyed once the last model lets go of them.
+ * also owns the default textures materials fall back to, they're created once when the registry is initialized
+ * */
+class TextureRegistry : public Singleton<TextureRegistry>, NonCopyable
+{
+public:
+    enum class DefaultTexture : n8
+    {
+        WHITE,
+        BLACK,
+        FLAT_NORMAL,
+        COUNT
+    };
+
+    static void Init(LogicalDevice* device) { Get().Internal_Init(device); }
+    static void Shutdown() { Get().Internal_Shutdown(); }
+
+    // on a miss create fills in the texture, recording its upload into a batch owner submits. every Acquire needs a Release
+    static Texture Acquire(n64 key, const void* owner, const std::function<void(Texture&)>& create)
+    {
+        return Get().Internal_Acquire(key, owner, create);
+    }
+    static void Release(n64 key) { Get().Internal_Release(key); }
+
+    // the uploads of everything owner created have completed
+    static void MarkReady(const void* owner) { Get().Internal_MarkReady(owner); }
+    // textures another loader created may still be uploading, call MarkReady for your own first. loaders start through
+    // JobSystem::ExecuteLongRunning, so one never runs inside another that still has textures to mark ready
+    static void WaitUntilReady(const std::vector<n64>& keys) { Get().Internal_WaitUntilReady(keys); }
+
+    static const Texture& GetDefault(DefaultTexture texture) { return Get().m_defaults[static_cast<n32>(texture)]; }
+
+    // video memory the shared textures would take again if every user had its own copy
+    static VkDeviceSize GetDeduplicatedBytes() { return Get().Internal_GetDeduplicatedBytes(); }
+
+private:
+    struct Entry
+    {
+        Texture      texture;
+        n32          references{0};
+        VkDeviceSize bytes{0};
+        const void*  owner{nullptr};
+        bool         created{false}; // the texture exists and its upload has been recorded
+        bool         ready{false};   // the upload has completed
+    };
+
+    std::unordered_map<n64, Entry> m_entries;
+    std::mutex                     m_mutex;
+    std::condition_variable        m_readyCondition; // signalled when an entry gets created or ready
+    VkDeviceSize                   m_deduplicatedBytes{0};
+
+    Texture m_defaults[static_cast<n32>(DefaultTexture::COUNT)];
+
+    void         Internal_Init(LogicalDevice* device);
+    void         Internal_Shutdown();
+    Texture      Internal_Acquire(n64 key, const void* owner, const std::function<void(Texture&)>& create);
+    void         Internal_Release(n64 key);
+    void         Internal_MarkReady(const void* owner);
+    void         Internal_WaitUntilReady(const std::vector<n64>& keys);
+    VkDeviceSize Internal_GetDeduplicatedBytes();
+};
+} // namespace Humongous
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "abstractions/buffer.hpp"
+#include "logical_device.hpp"
+#include "non_copyable.hpp"
+#include <memory>
+#include <vector>
+
+namespace Humongous
+{
+/***
+ * records any number of buffer and image uploads into one command buffer and submits them together,
+ * instead of a full queue round trip per copy. staging memory comes from chunks owned by the batch and is recycled once the batch retires.
+ * a batch is used by one thread at a time and has to be retired on the thread that recorded it
+ *
+ * when the device has a dedicated transfer queue the copies are recorded for it, and everything they write is released to the graphics
+ * family. the graphics side (acquires and layout transitions) is recorded separately and runs once the transfer has finished
+ * */
+class UploadBatch : NonCopyable
+{
+public:
+    struct StagingAllocation
+    {
+        VkBuffer     buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        void*        data = nullptr;
+    };
+
+    explicit UploadBatch(LogicalDevice* device);
+    ~UploadBatch(); // waits for anything still recorded or in flight
+
+    // mapped staging memory that stays valid until the batch retires
+    StagingAllocation AllocateStaging(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+    void CopyBuffer(VkBuffer src, VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size);
+    // stages the data and copies it to the start of dst
+    void UploadToBuffer(const void* data, VkDeviceSize size, VkBuffer dst);
+    // copies into a freshly created image. every level and layer ends up in TRANSFER_DST_OPTIMAL, owned by the graphics family
+    void UploadImage(VkBuffer src, VkImage image, const std::vector<VkBufferImageCopy>& regions, n32 mipLevels, n32 layerCount = 1);
+
+    // recorded on the graphics side, after the uploads
+    void TransitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, n32 baseMipLevel = 0, n32 levelCount = 1,
+                               n32 baseArrayLayer = 0, n32 layerCount = 1);
+
+    // keeps a buffer the recorded commands read from alive until the batch retires
+    void Retain(std::unique_ptr<Buffer> buffer);
+
+    // for graphics side commands the batch has no helper for
+    VkCommandBuffer GetCommandBuffer();
+
+    bool IsEmpty() const { return m_graphicsCommandBuffer == VK_NULL_HANDLE && m_transferCommandBuffer == VK_NULL_HANDLE; }
+
+    // submits everything recorded so far, the returned fence signals once the gpu is done with it
+    VkFence Submit();
+    // doesn't block, retires the batch if the gpu has finished it
+    bool IsComplete();
+    // submits if needed and blocks until the batch has retired, it can be recorded into again afterwards
+    void Wait();
+
+private:
+    static constexpr VkDeviceSize STAGING_CHUNK_SIZE = 16 * 1024 * 1024;
+    static constexpr size_t       MAX_RECYCLED_CHUNKS = 4;
+
+    struct StagingChunk
+    {
+        std::unique_ptr<Buffer> buffer;
+        VkDeviceSize            used = 0;
+    };
+
+    LogicalDevice*                       m_device;
+    VkCommandBuffer                      m_graphicsCommandBuffer{VK_NULL_HANDLE};
+    VkCommandBuffer                      m_transferCommandBuffer{VK_NULL_HANDLE}; // only used with a dedicated transfer queue
+    VkFence                              m_fence{VK_NULL_HANDLE};
+    std::vector<StagingChunk>            m_chunks;
+    std::vector<std::unique_ptr<Buffer>> m_retained;
+    std::vector<VkBuffer>                m_writtenBuffers; // handed to the graphics family on submit
+
+    VkCommandBuffer GetTransferCommandBuffer();
+    void            ReleaseWrittenBuffers();
+    void            Retire();
+};
+} // namespace Humongous
@@ -47,6 +47,8 @@ private:
     std::unique_ptr<SkyboxRenderSystem> m_skyboxRenderSystem;
     std::unique_ptr<Camera>             m_cam;
 
+    // declared first, the objects' proxies leave it when they're destroyed
+    AABBTree        m_objectTree;
     GameObject::Map m_gameObjects;
 
     void Init(int argc, char* argv[]);
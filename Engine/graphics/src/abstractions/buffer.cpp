@@ -8,6 +8,7 @@
  */
 
 #include <abstractions/buffer.hpp>
+#include <logger.hpp>
 
 // std
 #include <cassert>
@@ -71,6 +72,35 @@ void Buffer::Init(LogicalDevice* device, VkDeviceSize instanceSize, n32 instance
     UpdateAddress(m_usageFlags);
 }
 
+void Buffer::InitStaging(LogicalDevice* device, VkDeviceSize size)
+{
+    m_logicalDevice = device;
+    m_instanceSize = size;
+    m_instanceCount = 1;
+    m_usageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    m_alignmentSize = size;
+    m_bufferSize = size;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = m_usageFlags;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // write combined memory is fine for streaming writes but very slow to read, the loader reads its data back while processing it
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    allocCreateInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    allocCreateInfo.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    if(vmaCreateBuffer(device->GetVmaAllocator(), &bufferInfo, &allocCreateInfo, &m_buffer, &m_allocation, &m_allocationInfo) != VK_SUCCESS)
+    {
+        HGFATAL("Failed to create a %llu byte staging buffer", static_cast<unsigned long long>(size));
+    }
+    vmaGetAllocationMemoryProperties(device->GetVmaAllocator(), m_allocation, &m_memoryPropertyFlags);
+}
+
 Buffer::~Buffer()
 {
     if(m_allocationInfo.pMappedData) { UnMap(); }
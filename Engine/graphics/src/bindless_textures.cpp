@@ -0,0 +1,163 @@
+#include "bindless_textures.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+
+namespace Humongous
+{
+void BindlessTextures::Internal_Init(LogicalDevice* device)
+{
+    m_device = device;
+
+    VkPhysicalDeviceVulkan12Properties vulkan12Properties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+    VkPhysicalDeviceProperties2        properties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &vulkan12Properties};
+    vkGetPhysicalDeviceProperties2(device->GetPhysicalDevice().GetVkPhysicalDevice(), &properties);
+
+    m_imageCapacity = std::min({MAX_IMAGES, vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    m_samplerCapacity = std::min({MAX_SAMPLERS, vulkan12Properties.maxDescriptorSetUpdateAfterBindSamplers,
+                                  vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+    const VkDescriptorSetLayoutBinding bindings[] = {
+        {IMAGE_BINDING, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, m_imageCapacity, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr},
+        {SAMPLER_BINDING, VK_DESCRIPTOR_TYPE_SAMPLER, m_samplerCapacity, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}};
+
+    // slots nobody registered are never sampled, slots that aren't used by a pending frame can be written any time
+    const VkDescriptorBindingFlags bindingFlag = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                                 VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    const VkDescriptorBindingFlags bindingFlags[] = {bindingFlag, bindingFlag};
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = 2;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    if(vkCreateDescriptorSetLayout(device->GetVkDevice(), &layoutInfo, nullptr, &m_layout) != VK_SUCCESS)
+    {
+        HGFATAL("Failed to create the bindless texture descriptor set layout");
+    }
+
+    const VkDescriptorPoolSize poolSizes[] = {{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, m_imageCapacity}, {VK_DESCRIPTOR_TYPE_SAMPLER, m_samplerCapacity}};
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+
+    if(vkCreateDescriptorPool(device->GetVkDevice(), &poolInfo, nullptr, &m_pool) != VK_SUCCESS)
+    {
+        HGFATAL("Failed to create the bindless texture descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = m_pool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &m_layout;
+
+    if(vkAllocateDescriptorSets(device->GetVkDevice(), &allocateInfo, &m_descriptorSet) != VK_SUCCESS)
+    {
+        HGFATAL("Failed to allocate the bindless texture descriptor set");
+    }
+
+    HGINFO("Created bindless texture set with room for %u images and %u samplers", m_imageCapacity, m_samplerCapacity);
+}
+
+void BindlessTextures::Internal_Shutdown()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // the set goes with its pool
+    vkDestroyDescriptorPool(m_device->GetVkDevice(), m_pool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device->GetVkDevice(), m_layout, nullptr);
+    m_pool = VK_NULL_HANDLE;
+    m_layout = VK_NULL_HANDLE;
+    m_descriptorSet = VK_NULL_HANDLE;
+
+    m_imageCount = 0;
+    m_freeImages.clear();
+    m_samplers.clear();
+}
+
+n32 BindlessTextures::Internal_RegisterImage(VkImageView imageView, VkImageLayout imageLayout)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    n32 index = INVALID_INDEX;
+    if(!m_freeImages.empty())
+    {
+        index = m_freeImages.back();
+        m_freeImages.pop_back();
+    }
+    else if(m_imageCount < m_imageCapacity) { index = m_imageCount++; }
+    else
+    {
+        HGERROR("Out of bindless image slots, all %u are in use", m_imageCapacity);
+        return INVALID_INDEX;
+    }
+
+    VkDescriptorImageInfo imageInfo{VK_NULL_HANDLE, imageView, imageLayout};
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_descriptorSet;
+    write.dstBinding = IMAGE_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(m_device->GetVkDevice(), 1, &write, 0, nullptr);
+
+    return index;
+}
+
+void BindlessTextures::Internal_ReleaseImage(n32 index)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // textures destroyed after shutdown have nothing to give back
+    if(m_descriptorSet == VK_NULL_HANDLE || index == INVALID_INDEX) { return; }
+    m_freeImages.push_back(index);
+}
+
+n32 BindlessTextures::Internal_GetSamplerIndex(VkSampler sampler)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_samplers.find(sampler);
+    if(it != m_samplers.end()) { return it->second; }
+
+    if(m_samplers.size() >= m_samplerCapacity)
+    {
+        HGERROR("Out of bindless sampler slots, all %u are in use", m_samplerCapacity);
+        return 0;
+    }
+
+    const n32 index = static_cast<n32>(m_samplers.size());
+
+    VkDescriptorImageInfo imageInfo{sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED};
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_descriptorSet;
+    write.dstBinding = SAMPLER_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(m_device->GetVkDevice(), 1, &write, 0, nullptr);
+
+    m_samplers.emplace(sampler, index);
+    return index;
+}
+
+} // namespace Humongous
@@ -0,0 +1,95 @@
+#include "command_recorder.hpp"
+#include "asserts.hpp"
+
+#include <cstring>
+
+namespace Humongous
+{
+void CommandRecorder::BindPipeline(VkPipeline pipeline)
+{
+    if(pipeline == m_pipeline)
+    {
+        m_stats.bindsSkipped++;
+        return;
+    }
+
+    vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    m_pipeline = pipeline;
+    m_stats.bindsIssued++;
+}
+
+void CommandRecorder::BindDescriptorSets(VkPipelineLayout layout, n32 firstSet, n32 setCount, const VkDescriptorSet* descriptorSets)
+{
+    HGASSERT(firstSet + setCount <= MAX_DESCRIPTOR_SETS && "CommandRecorder only tracks MAX_DESCRIPTOR_SETS sets");
+    SetLayout(layout);
+
+    // only the changed span gets rebound, sets around it stay as they are
+    n32 first = 0;
+    n32 last = setCount;
+    while(first < last && m_descriptorSets[firstSet + first] == descriptorSets[first]) { first++; }
+    while(last > first && m_descriptorSets[firstSet + last - 1] == descriptorSets[last - 1]) { last--; }
+
+    m_stats.bindsSkipped += setCount - (last - first);
+    if(first == last) { return; }
+
+    vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, firstSet + first, last - first, descriptorSets + first, 0,
+                            nullptr);
+    std::memcpy(&m_descriptorSets[firstSet + first], descriptorSets + first, (last - first) * sizeof(VkDescriptorSet));
+    m_stats.bindsIssued += last - first;
+}
+
+void CommandRecorder::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+    if(buffer == m_indexBuffer && offset == m_indexOffset && indexType == m_indexType)
+    {
+        m_stats.bindsSkipped++;
+        return;
+    }
+
+    vkCmdBindIndexBuffer(m_commandBuffer, buffer, offset, indexType);
+    m_indexBuffer = buffer;
+    m_indexOffset = offset;
+    m_indexType = indexType;
+    m_stats.bindsIssued++;
+}
+
+void CommandRecorder::PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, n32 offset, n32 size, const void* data)
+{
+    HGASSERT(offset % 4 == 0 && size % 4 == 0 && offset + size <= MAX_PUSH_CONSTANT_BYTES && "Push constant range out of bounds");
+    SetLayout(layout);
+
+    bool known = std::memcmp(&m_pushConstants[offset], data, size) == 0;
+    for(n32 word = offset / 4; known && word < (offset + size) / 4; word++) { known = m_pushConstantStages[word] == stages; }
+    if(known)
+    {
+        m_stats.bindsSkipped++;
+        return;
+    }
+
+    vkCmdPushConstants(m_commandBuffer, layout, stages, offset, size, data);
+    std::memcpy(&m_pushConstants[offset], data, size);
+    for(n32 word = offset / 4; word < (offset + size) / 4; word++) { m_pushConstantStages[word] = stages; }
+    m_stats.bindsIssued++;
+}
+
+void CommandRecorder::Invalidate()
+{
+    m_pipeline = VK_NULL_HANDLE;
+    m_layout = VK_NULL_HANDLE;
+    m_descriptorSets.fill(VK_NULL_HANDLE);
+    m_indexBuffer = VK_NULL_HANDLE;
+    m_indexType = VK_INDEX_TYPE_MAX_ENUM;
+    m_pushConstantStages.fill(0);
+}
+
+void CommandRecorder::SetLayout(VkPipelineLayout layout)
+{
+    if(layout == m_layout) { return; }
+
+    // conservative, vulkan would keep the sets of a compatible prefix bound
+    m_layout = layout;
+    m_descriptorSets.fill(VK_NULL_HANDLE);
+    m_pushConstantStages.fill(0);
+}
+
+} // namespace Humongous
@@ -0,0 +1,329 @@
+#include "gpu_culler.hpp"
+#include "asserts.hpp"
+#include "extra.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Humongous
+{
+static_assert(sizeof(Model::GpuPrimitive) == 48, "cull.comp.glsl's GpuPrimitive layout");
+static_assert(sizeof(Model::GpuLod) == 32, "cull.comp.glsl's GpuLod layout");
+
+static constexpr n32 MIN_OBJECTS = 64;
+
+GpuCuller::GpuCuller(LogicalDevice& logicalDevice, VkDescriptorSetLayout cameraLayout, const std::string& shaderPath)
+    : m_logicalDevice{logicalDevice}
+{
+    HGINFO("Creating gpu culler...");
+    CreatePipelineLayout(cameraLayout);
+    CreatePipeline(shaderPath);
+
+    for(Frame& frame: m_frames)
+    {
+        frame.readback = std::make_unique<Buffer>(&m_logicalDevice, sizeof(Stats), 1, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                  VMA_MEMORY_USAGE_GPU_TO_CPU);
+        frame.readback->Map();
+    }
+    HGINFO("Created gpu culler");
+}
+
+GpuCuller::~GpuCuller()
+{
+    vkDestroyPipeline(m_logicalDevice.GetVkDevice(), m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_logicalDevice.GetVkDevice(), m_pipelineLayout, nullptr);
+}
+
+void GpuCuller::CreatePipelineLayout(VkDescriptorSetLayout cameraLayout)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    // the frustum planes and camera position come from the camera's ubo, everything else is reached through buffer addresses
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cameraLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if(vkCreatePipelineLayout(m_logicalDevice.GetVkDevice(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
+    {
+        HGERROR("Failed to create culling pipeline layout");
+    }
+}
+
+void GpuCuller::CreatePipeline(const std::string& shaderPath)
+{
+    const std::vector<char> code = Utils::ReadFile(shaderPath);
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = reinterpret_cast<const n32*>(code.data());
+
+    VkShaderModule shaderModule;
+    if(vkCreateShaderModule(m_logicalDevice.GetVkDevice(), &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+    {
+        HGERROR("Failed to create culling shader module!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    if(vkCreateComputePipelines(m_logicalDevice.GetVkDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS)
+    {
+        HGERROR("Failed to create culling pipeline");
+    }
+
+    vkDestroyShaderModule(m_logicalDevice.GetVkDevice(), shaderModule, nullptr);
+}
+
+void GpuCuller::Reserve(Frame& frame, n32 commandCount, n32 countCount)
+{
+    // buffers only grow, the frame's previous pass has finished so the old ones can go right away
+    commandCount = std::max<n32>(commandCount, 1);
+    if(commandCount > frame.commandCapacity)
+    {
+        frame.commandCapacity = std::max(commandCount, frame.commandCapacity * 2);
+        frame.commands = std::make_unique<Buffer>(
+            &m_logicalDevice, Model::INDIRECT_COMMAND_STRIDE, frame.commandCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+        frame.records = std::make_unique<Buffer>(&m_logicalDevice, sizeof(glm::uvec2), frame.commandCapacity,
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    }
+
+    if(countCount > frame.countCapacity)
+    {
+        frame.countCapacity = std::max(countCount, frame.countCapacity * 2);
+        frame.counts = std::make_unique<Buffer>(&m_logicalDevice, sizeof(n32), frame.countCapacity,
+                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                    VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    }
+}
+
+n32 GpuCuller::AddObject()
+{
+    m_matrices.emplace_back(1.0f);
+    m_dirty.push_back(false);
+    return static_cast<n32>(m_matrices.size() - 1);
+}
+
+void GpuCuller::WriteObject(n32 object, const glm::mat4& matrix)
+{
+    HGASSERT(object < m_matrices.size() && "Object out of range");
+    m_matrices[object] = matrix;
+    if(!m_dirty[object])
+    {
+        m_dirty[object] = true;
+        m_dirtyObjects.push_back(object);
+    }
+}
+
+n32* GpuCuller::BeginFrame(n32 frameIndex, n32 instanceCount)
+{
+    HGASSERT(frameIndex < SwapChain::MAX_FRAMES_IN_FLIGHT && "Frame index out of range");
+    m_frameIndex = frameIndex;
+    Frame& frame = m_frames[frameIndex];
+    frame.retired.clear();
+
+    if(frame.statsPending)
+    {
+        std::memcpy(&m_stats, frame.readback->GetMappedMemory(), sizeof(Stats));
+        frame.statsPending = false;
+    }
+
+    if(instanceCount > frame.instanceCapacity || !frame.instances)
+    {
+        frame.instanceCapacity = std::max({instanceCount, frame.instanceCapacity * 2, MIN_OBJECTS});
+        frame.instances = std::make_unique<Buffer>(&m_logicalDevice, sizeof(n32), frame.instanceCapacity,
+                                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                   VMA_MEMORY_USAGE_CPU_TO_GPU);
+        frame.instances->Map();
+    }
+
+    return static_cast<n32*>(frame.instances->GetMappedMemory());
+}
+
+void GpuCuller::UploadObjects(VkCommandBuffer commandBuffer, Frame& frame)
+{
+    const n32 objectCount = static_cast<n32>(m_matrices.size());
+    if(objectCount > m_objectCapacity || !m_objects)
+    {
+        // the frames still in flight read the old buffer, it goes once this frame has finished
+        if(m_objects) { frame.retired.push_back(std::move(m_objects)); }
+
+        m_objectCapacity = std::max({objectCount, m_objectCapacity * 2, MIN_OBJECTS});
+        m_objects = std::make_unique<Buffer>(
+            &m_logicalDevice, sizeof(glm::mat4), m_objectCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+        // nothing of the old buffer carries over
+        m_dirtyObjects.clear();
+        for(n32 object = 0; object < objectCount; object++)
+        {
+            m_dirty[object] = true;
+            m_dirtyObjects.push_back(object);
+        }
+    }
+
+    const n32 uploadCount = static_cast<n32>(m_dirtyObjects.size());
+    if(uploadCount == 0) { return; }
+
+    if(uploadCount > frame.uploadCapacity)
+    {
+        frame.uploadCapacity = std::max({uploadCount, frame.uploadCapacity * 2, MIN_OBJECTS});
+        frame.uploads = std::make_unique<Buffer>(&m_logicalDevice, sizeof(glm::mat4), frame.uploadCapacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                 VMA_MEMORY_USAGE_CPU_TO_GPU);
+        frame.uploads->Map();
+    }
+
+    glm::mat4*                uploads = static_cast<glm::mat4*>(frame.uploads->GetMappedMemory());
+    std::vector<VkBufferCopy> copies(uploadCount);
+    for(n32 i = 0; i < uploadCount; i++)
+    {
+        const n32 object = m_dirtyObjects[i];
+        uploads[i] = m_matrices[object];
+        copies[i] = {i * sizeof(glm::mat4), object * sizeof(glm::mat4), sizeof(glm::mat4)};
+        m_dirty[object] = false;
+    }
+    m_dirtyObjects.clear();
+
+    // the earlier frames' passes and draws may still read the matrices that are replaced here
+    VkMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_NONE;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+    VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+
+    vkCmdCopyBuffer(commandBuffer, frame.uploads->GetBuffer(), m_objects->GetBuffer(), uploadCount, copies.data());
+
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+}
+
+void GpuCuller::Cull(VkCommandBuffer commandBuffer, VkDescriptorSet cameraSet, const std::vector<Batch>& batches, const Settings& settings)
+{
+    Frame& frame = m_frames[m_frameIndex];
+
+    UploadObjects(commandBuffer, frame);
+
+    // a primitive writes at most one command, but a level of detail can move it into any of the lists
+    n32 commandCount = 0;
+    n32 instanceCount = 0;
+    for(const Batch& batch: batches)
+    {
+        commandCount += LIST_COUNT * batch.instanceCount * batch.model->GetDrawCount();
+        instanceCount += batch.instanceCount;
+    }
+    const n32 firstFlag = STAT_COUNTS + LIST_COUNT * static_cast<n32>(batches.size());
+    Reserve(frame, commandCount, firstFlag + instanceCount);
+
+    vkCmdFillBuffer(commandBuffer, frame.counts->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+    VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &cameraSet, 0, nullptr);
+
+    PushConstants constants{};
+    constants.objects = m_objects->GetDeviceAddress();
+    constants.instances = frame.instances->GetDeviceAddress();
+    constants.commands = frame.commands->GetDeviceAddress();
+    constants.records = frame.records->GetDeviceAddress();
+    constants.counts = frame.counts->GetDeviceAddress();
+    constants.pixelsPerUnit = settings.pixelsPerUnit;
+    constants.viewportHeight = settings.viewportHeight;
+    constants.lodErrorPixels = settings.lodErrorPixels;
+    constants.minPixels = settings.minPixels;
+    constants.firstFlag = firstFlag;
+
+    frame.draws.clear();
+    n32 firstCommand = 0;
+    for(n32 b = 0; b < batches.size(); b++)
+    {
+        const Batch& batch = batches[b];
+        const n32    maxDraws = batch.instanceCount * batch.model->GetDrawCount();
+        const n32    firstCount = STAT_COUNTS + b * LIST_COUNT;
+
+        Model::IndirectCountDraw draw{};
+        draw.commands = frame.commands->GetBuffer();
+        draw.counts = frame.counts->GetBuffer();
+        draw.maxDraws = maxDraws;
+        for(n32 list = 0; list < LIST_COUNT; list++)
+        {
+            draw.commandOffsets[list] = static_cast<VkDeviceSize>(firstCommand + list * maxDraws) * Model::INDIRECT_COMMAND_STRIDE;
+            draw.countOffsets[list] = static_cast<VkDeviceSize>(firstCount + list) * sizeof(n32);
+        }
+        frame.draws.push_back(draw);
+
+        if(maxDraws == 0) { continue; }
+
+        constants.primitives = batch.model->GetGpuPrimitiveAddress();
+        constants.lods = batch.model->GetGpuLodAddress();
+        constants.meshes = batch.model->GetMeshAddress();
+        constants.firstInstance = batch.firstInstance;
+        constants.instanceCount = batch.instanceCount;
+        constants.drawCount = batch.model->GetDrawCount();
+        constants.firstCommand = firstCommand;
+        constants.maxDraws = maxDraws;
+        constants.firstCount = firstCount;
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &constants);
+
+        vkCmdDispatch(commandBuffer, (maxDraws + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        firstCommand += LIST_COUNT * maxDraws;
+    }
+
+    // commands and counts are read by the indirect draws, records by the vertex shaders and the stats by the copy below
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+
+    VkBufferCopy copy{0, 0, sizeof(Stats)};
+    vkCmdCopyBuffer(commandBuffer, frame.counts->GetBuffer(), frame.readback->GetBuffer(), 1, &copy);
+
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+
+    frame.statsPending = true;
+}
+
+} // namespace Humongous
@@ -0,0 +1,52 @@
+#include "indirect_draw_buffer.hpp"
+#include "asserts.hpp"
+
+#include <algorithm>
+
+namespace Humongous
+{
+void IndirectDrawBuffer::BeginFrame(n32 frameIndex)
+{
+    HGASSERT(frameIndex < SwapChain::MAX_FRAMES_IN_FLIGHT && "Frame index out of range");
+    m_frameIndex = frameIndex;
+    m_chunk = 0;
+    m_used = 0;
+}
+
+IndirectDrawBuffer::Allocation IndirectDrawBuffer::Allocate(n32 count)
+{
+    if(count == 0) { return {}; }
+
+    std::vector<Chunk>& chunks = m_frames[m_frameIndex];
+
+    // a request never straddles two chunks, whatever is left of the current one stays unused this frame
+    while(m_chunk < chunks.size() && m_used + count > chunks[m_chunk].capacity)
+    {
+        m_chunk++;
+        m_used = 0;
+    }
+
+    if(m_chunk == chunks.size())
+    {
+        Chunk chunk{};
+        chunk.capacity = std::max(count, CHUNK_COMMANDS);
+        chunk.buffer = std::make_unique<Buffer>(&m_logicalDevice, sizeof(VkDrawIndexedIndirectCommand), chunk.capacity,
+                                                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                VMA_MEMORY_USAGE_CPU_TO_GPU);
+        chunk.buffer->Map();
+        chunks.push_back(std::move(chunk));
+    }
+
+    Chunk& chunk = chunks[m_chunk];
+
+    Allocation allocation{};
+    allocation.buffer = chunk.buffer->GetBuffer();
+    allocation.offset = static_cast<VkDeviceSize>(m_used) * sizeof(VkDrawIndexedIndirectCommand);
+    allocation.commands = static_cast<VkDrawIndexedIndirectCommand*>(chunk.buffer->GetMappedMemory()) + m_used;
+
+    m_used += count;
+    return allocation;
+}
+
+} // namespace Humongous
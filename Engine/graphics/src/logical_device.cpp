@@ -13,14 +13,19 @@ LogicalDevice::LogicalDevice(Instance& instance, PhysicalDevice& physicalDevice)
     HGINFO("Creating logical device...");
     CreateLogicalDevice(instance, physicalDevice);
     CreateVmaAllocator(instance, physicalDevice);
-    CreateCommandPool(physicalDevice);
+    CreateUploadTimeline();
     HGINFO("Created logical device");
 }
 
 LogicalDevice::~LogicalDevice()
 {
     HGINFO("Destroying logical device...");
-    vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
+    for(auto& [thread, pools]: m_commandPools)
+    {
+        m_logicalDevice.destroyCommandPool(pools.graphics);
+        if(pools.transfer) { m_logicalDevice.destroyCommandPool(pools.transfer); }
+    }
+    if(m_uploadTimeline) { m_logicalDevice.destroySemaphore(m_uploadTimeline); }
     vmaDestroyAllocator(m_allocator);
     vkDestroyDevice(m_logicalDevice, nullptr);
     HGINFO("Destroyed logical device");
@@ -36,11 +41,29 @@ void LogicalDevice::CreateLogicalDevice(Instance& instance, PhysicalDevice& phys
     HGASSERT(indices.IsComplete() && "Incomplete queue family indices!");
     m_graphicsQueueIndex = indices.graphicsFamily.value();
     m_presentQueueIndex = indices.presentFamily.value();
+    // without a dedicated family, uploads simply go through the graphics queue
+    m_transferQueueIndex = indices.transferFamily.value_or(m_graphicsQueueIndex);
 
     // vulkan 1.2 features
     vk::PhysicalDeviceVulkan12Features vulkan12Features{};
     vulkan12Features.descriptorIndexing = VK_TRUE;
     vulkan12Features.bufferDeviceAddress = VK_TRUE;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    // the bindless material texture arrays, see BindlessTextures. PhysicalDevice only picks devices that have them
+    vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+    vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    // draws of different materials can share a wave once they go out through one indirect call. required, see PhysicalDevice
+    vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    // the draw count of gpu culled draws is only known on the gpu, without it culling stays on the cpu.
+    // a gpu culled model goes out in one call per list, so it also needs multi draw indirect
+    VkPhysicalDeviceVulkan12Features supported12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2        supported{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &supported12};
+    vkGetPhysicalDeviceFeatures2(physicalDevice.GetVkPhysicalDevice(), &supported);
+    m_multiDrawIndirect = supported.features.multiDrawIndirect == VK_TRUE;
+    m_drawIndirectCount = supported12.drawIndirectCount == VK_TRUE && m_multiDrawIndirect;
+    vulkan12Features.drawIndirectCount = m_drawIndirectCount;
 
     // vulkan 1.3 features
     vk::PhysicalDeviceVulkan13Features vulkan13Features{};
@@ -53,25 +76,16 @@ void LogicalDevice::CreateLogicalDevice(Instance& instance, PhysicalDevice& phys
 
     vk::PhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // models draw through vkCmdDrawIndexedIndirect, passing each primitive's draw index in as firstInstance.
+    // devices without multi draw indirect get one call per command instead, see Model::SubmitDrawList
+    deviceFeatures.multiDrawIndirect = m_multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    // block compressed model textures need it, they stay uncompressed on devices without it
+    m_textureCompressionBC = physicalDevice.GetFeatures().features.textureCompressionBC == VK_TRUE;
+    deviceFeatures.textureCompressionBC = m_textureCompressionBC;
 
-    auto queueCreateInfos = CreateQueues(physicalDevice);
-
-    // TODO: make queue creation(specifically the acquisition of information required for queue creation and acquisition) not atrocious
-    // this also includes the CreateQueues() func, because what it does doesn't match its name
-    // ps. also look at the calls to vkGetDeviceQueue2, maybe it can be made better
-    //
-    // cant be bothered to fix this right now
-
-    std::vector<vk::DeviceQueueCreateInfo> queueInfos(2);
-    float                                  p = 1.0f;
-
-    queueInfos[0].queueFamilyIndex = indices.graphicsFamily.value();
-    queueInfos[0].queueCount = 1;
-    queueInfos[0].pQueuePriorities = &p;
-
-    queueInfos[1].queueFamilyIndex = indices.presentFamily.value();
-    queueInfos[1].queueCount = 1;
-    queueInfos[1].pQueuePriorities = &p;
+    float p = 1.0f;
+    auto  queueInfos = CreateQueues(&p);
 
     auto extensions = physicalDevice.GetDeviceExtensions();
 
@@ -93,10 +107,15 @@ void LogicalDevice::CreateLogicalDevice(Instance& instance, PhysicalDevice& phys
 
     HGINFO("logical device created");
 
-    m_logicalDevice.getQueue2(&queueCreateInfos[0], &m_graphicsQueue);
-    m_logicalDevice.getQueue2(&queueCreateInfos[1], &m_presentQueue);
+    vk::DeviceQueueInfo2 queueInfo{};
+    queueInfo.queueFamilyIndex = m_graphicsQueueIndex;
+    m_logicalDevice.getQueue2(&queueInfo, &m_graphicsQueue);
+    queueInfo.queueFamilyIndex = m_presentQueueIndex;
+    m_logicalDevice.getQueue2(&queueInfo, &m_presentQueue);
+    queueInfo.queueFamilyIndex = m_transferQueueIndex;
+    m_logicalDevice.getQueue2(&queueInfo, &m_transferQueue);
 
-    HGINFO("logical device queues acquired");
+    HGINFO("logical device queues acquired, uploads run on the %s queue", HasDedicatedTransferQueue() ? "transfer" : "graphics");
 }
 
 void LogicalDevice::CreateVmaAllocator(Instance& instance, PhysicalDevice& physicalDevice)
@@ -110,41 +129,71 @@ void LogicalDevice::CreateVmaAllocator(Instance& instance, PhysicalDevice& physi
     vmaCreateAllocator(&allocatorInfo, &m_allocator);
 }
 
-std::vector<vk::DeviceQueueInfo2> LogicalDevice::CreateQueues(PhysicalDevice& physicalDevice)
+std::vector<vk::DeviceQueueCreateInfo> LogicalDevice::CreateQueues(const float* priority)
 {
-    HGINFO("acquiring queue handles...");
+    // a family can only be listed once, even when it serves more than one role
+    std::set<n32> uniqueQueueFamilies = {m_graphicsQueueIndex, m_presentQueueIndex, m_transferQueueIndex};
 
-    PhysicalDevice::QueueFamilyData indices = physicalDevice.FindQueueFamilies(physicalDevice.GetVkPhysicalDevice());
-
-    std::vector<vk::DeviceQueueInfo2> queueCreateInfos;
-    std::set<n32>                     uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
-
-    float queuePriority = 1.0f;
+    std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
     for(n32 queueFamily: uniqueQueueFamilies)
     {
-        vk::DeviceQueueInfo2 queueCreateInfo{};
+        vk::DeviceQueueCreateInfo queueCreateInfo{};
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueIndex = 0;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = priority;
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
     return queueCreateInfos;
 }
 
-void LogicalDevice::CreateCommandPool(PhysicalDevice& physicalDevice)
+void LogicalDevice::CreateUploadTimeline()
+{
+    if(!HasDedicatedTransferQueue()) { return; }
+
+    vk::SemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+    timelineInfo.initialValue = 0;
+
+    vk::SemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.pNext = &timelineInfo;
+
+    if(m_logicalDevice.createSemaphore(&semaphoreInfo, nullptr, &m_uploadTimeline) != vk::Result::eSuccess)
+    {
+        HGFATAL("Failed to create upload timeline semaphore!");
+    }
+}
+
+void LogicalDevice::WaitIdle()
+{
+    std::scoped_lock lock(m_queueMutex, m_transferQueueMutex);
+    m_logicalDevice.waitIdle();
+}
+
+vk::CommandPool LogicalDevice::GetThreadCommandPool(QueueType queue)
 {
+    // command pools are externally synchronized, so each thread that uploads something gets its own
+    std::lock_guard<std::mutex> lock(m_commandPoolMutex);
+
+    // without a dedicated transfer family both queue types share the graphics pool
+    bool             transfer = queue == QueueType::TRANSFER && HasDedicatedTransferQueue();
+    ThreadCommandPools& pools = m_commandPools[std::this_thread::get_id()];
+    vk::CommandPool&    pool = transfer ? pools.transfer : pools.graphics;
+    if(pool) { return pool; }
+
     vk::CommandPoolCreateInfo poolInfo{};
-    poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-    poolInfo.queueFamilyIndex = physicalDevice.FindQueueFamilies(physicalDevice.GetVkPhysicalDevice()).graphicsFamily.value();
+    poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient;
+    poolInfo.queueFamilyIndex = transfer ? m_transferQueueIndex : m_graphicsQueueIndex;
 
-    if(m_logicalDevice.createCommandPool(&poolInfo, nullptr, &m_commandPool) != vk::Result::eSuccess) { HGFATAL("Failed to create command pool!"); }
+    if(m_logicalDevice.createCommandPool(&poolInfo, nullptr, &pool) != vk::Result::eSuccess) { HGFATAL("Failed to create command pool!"); }
+    return pool;
 }
 
-vk::CommandBuffer LogicalDevice::BeginSingleTimeCommands()
+vk::CommandBuffer LogicalDevice::BeginSingleTimeCommands(QueueType queue)
 {
     vk::CommandBufferAllocateInfo allocInfo{};
     allocInfo.level = vk::CommandBufferLevel::ePrimary;
-    allocInfo.commandPool = m_commandPool;
+    allocInfo.commandPool = GetThreadCommandPool(queue);
     allocInfo.commandBufferCount = 1;
 
     vk::CommandBuffer commandBuffer{};
@@ -158,6 +207,11 @@ vk::CommandBuffer LogicalDevice::BeginSingleTimeCommands()
 }
 
 void LogicalDevice::EndSingleTimeCommands(vk::CommandBuffer commandBuffer)
+{
+    RetireSingleTimeCommands(commandBuffer, SubmitSingleTimeCommands(commandBuffer));
+}
+
+vk::Fence LogicalDevice::SubmitSingleTimeCommands(vk::CommandBuffer commandBuffer)
 {
     vkEndCommandBuffer(commandBuffer);
 
@@ -172,10 +226,78 @@ void LogicalDevice::EndSingleTimeCommands(vk::CommandBuffer commandBuffer)
     submitInfo.pSignalSemaphoreInfos = nullptr;
     submitInfo.waitSemaphoreInfoCount = 0;
     submitInfo.pWaitSemaphoreInfos = nullptr;
-    m_graphicsQueue.submit2(1, &submitInfo, VK_NULL_HANDLE);
 
-    m_graphicsQueue.waitIdle();
-    m_logicalDevice.freeCommandBuffers(m_commandPool, 1, &commandBuffer);
+    // waiting on a fence instead of the whole queue, so uploads from loader threads don't stall on each other or on frames in flight
+    vk::FenceCreateInfo fenceInfo{};
+    vk::Fence           fence{};
+    if(m_logicalDevice.createFence(&fenceInfo, nullptr, &fence) != vk::Result::eSuccess) { HGFATAL("Failed to create upload fence!"); }
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if(m_graphicsQueue.submit2(1, &submitInfo, fence) != vk::Result::eSuccess) { HGERROR("Failed to submit single time commands"); }
+    }
+
+    return fence;
+}
+
+vk::Fence LogicalDevice::SubmitUploadCommands(vk::CommandBuffer transferCmd, vk::CommandBuffer graphicsCmd)
+{
+    HGASSERT(HasDedicatedTransferQueue() && "Upload commands need a dedicated transfer queue, submit them as single time commands instead");
+
+    vkEndCommandBuffer(transferCmd);
+    vkEndCommandBuffer(graphicsCmd);
+
+    vk::CommandBufferSubmitInfo transferCmdInfo{};
+    transferCmdInfo.setCommandBuffer(transferCmd);
+
+    vk::SemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.semaphore = m_uploadTimeline;
+    timelineInfo.stageMask = vk::PipelineStageFlagBits2::eAllCommands;
+
+    vk::SubmitInfo2 transferSubmit{};
+    transferSubmit.commandBufferInfoCount = 1;
+    transferSubmit.pCommandBufferInfos = &transferCmdInfo;
+    transferSubmit.signalSemaphoreInfoCount = 1;
+    transferSubmit.pSignalSemaphoreInfos = &timelineInfo;
+
+    {
+        std::lock_guard<std::mutex> lock(m_transferQueueMutex);
+        timelineInfo.value = ++m_uploadTimelineValue;
+        if(m_transferQueue.submit2(1, &transferSubmit, VK_NULL_HANDLE) != vk::Result::eSuccess) { HGERROR("Failed to submit upload commands"); }
+    }
+
+    vk::CommandBufferSubmitInfo graphicsCmdInfo{};
+    graphicsCmdInfo.setCommandBuffer(graphicsCmd);
+
+    vk::SubmitInfo2 graphicsSubmit{};
+    graphicsSubmit.commandBufferInfoCount = 1;
+    graphicsSubmit.pCommandBufferInfos = &graphicsCmdInfo;
+    graphicsSubmit.waitSemaphoreInfoCount = 1;
+    graphicsSubmit.pWaitSemaphoreInfos = &timelineInfo;
+
+    vk::FenceCreateInfo fenceInfo{};
+    vk::Fence           fence{};
+    if(m_logicalDevice.createFence(&fenceInfo, nullptr, &fence) != vk::Result::eSuccess) { HGFATAL("Failed to create upload fence!"); }
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if(m_graphicsQueue.submit2(1, &graphicsSubmit, fence) != vk::Result::eSuccess) { HGERROR("Failed to submit upload acquire commands"); }
+    }
+
+    return fence;
+}
+
+void LogicalDevice::RetireSingleTimeCommands(vk::CommandBuffer commandBuffer, vk::Fence fence, QueueType queue)
+{
+    if(m_logicalDevice.waitForFences(1, &fence, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+    {
+        HGERROR("Failed to wait for single time commands");
+    }
+    m_logicalDevice.destroyFence(fence);
+    FreeSingleTimeCommands(commandBuffer, queue);
+}
+
+void LogicalDevice::FreeSingleTimeCommands(vk::CommandBuffer commandBuffer, QueueType queue)
+{
+    m_logicalDevice.freeCommandBuffers(GetThreadCommandPool(queue), 1, &commandBuffer);
 }
 
 } // namespace Humongous
@@ -0,0 +1,206 @@
+#include "mesh_cache.hpp"
+#include "hash.hpp"
+#include "logger.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace Humongous
+{
+static constexpr n64 SECTION_ALIGNMENT = 16;
+
+static n64 AlignSectionOffset(n64 offset) { return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1); }
+
+std::string MeshCache::GetCachePath(const std::string& sourcePath)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    std::string     absolutePath = fs::absolute(sourcePath, ec).string();
+    if(ec) { absolutePath = sourcePath; }
+
+    // the stem keeps the cache folder readable, the path hash keeps models with the same name apart
+    char pathHash[17];
+    std::snprintf(pathHash, sizeof(pathHash), "%016llx", Utils::HashBytes(absolutePath.data(), absolutePath.size()));
+
+    return (fs::path(HGASSETDIRPATH) / "cache" / (fs::path(sourcePath).stem().string() + "_" + pathHash + ".hgmesh")).string();
+}
+
+bool MeshCache::QuerySource(const std::string& sourcePath, SourceInfo& info, bool hashContents)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    info.size = fs::file_size(sourcePath, ec);
+    if(ec) { return false; }
+
+    info.modifiedTime = static_cast<s64>(fs::last_write_time(sourcePath, ec).time_since_epoch().count());
+    if(ec) { return false; }
+
+    info.contentHash = 0;
+    if(!hashContents) { return true; }
+
+    Utils::MappedFile source;
+    if(!source.Open(sourcePath)) { return false; }
+
+    info.contentHash = Utils::HashBytes(source.GetData(), source.GetSize());
+    return true;
+}
+
+bool MeshCache::FindGLBBinaryChunk(const std::string& sourcePath, n64& offset)
+{
+    // 12 byte file header followed by the JSON chunk header, the binary chunk comes straight after the JSON data
+    n32 header[5];
+
+    std::ifstream file(sourcePath, std::ios::binary);
+    if(!file.read(reinterpret_cast<char*>(header), sizeof(header))) { return false; }
+
+    constexpr n32 glbMagic = 0x46546C67;      // "glTF"
+    constexpr n32 jsonChunkType = 0x4E4F534A; // "JSON"
+    if(header[0] != glbMagic || header[4] != jsonChunkType) { return false; }
+
+    offset = sizeof(header) + static_cast<n64>(header[3]) + 2 * sizeof(n32);
+    return true;
+}
+
+bool MeshCache::Open(const std::string& sourcePath)
+{
+    const std::string cachePath = GetCachePath(sourcePath);
+    if(!std::filesystem::exists(cachePath)) { return false; }
+
+    if(!m_file.Open(cachePath))
+    {
+        HGWARN("Failed to map mesh cache %s", cachePath.c_str());
+        return false;
+    }
+
+    if(m_file.GetSize() < sizeof(Header))
+    {
+        HGWARN("Mesh cache %s is truncated", cachePath.c_str());
+        Close();
+        return false;
+    }
+
+    std::memcpy(&m_header, m_file.GetData(), sizeof(Header));
+
+    if(m_header.magic != MAGIC || m_header.version != VERSION)
+    {
+        HGINFO("Mesh cache %s was written by another version, rebuilding it", cachePath.c_str());
+        Close();
+        return false;
+    }
+
+    for(const SectionRange& section: m_header.sections)
+    {
+        if(section.offset % SECTION_ALIGNMENT != 0 || section.offset > m_file.GetSize() || section.size > m_file.GetSize() - section.offset)
+        {
+            HGWARN("Mesh cache %s is corrupt", cachePath.c_str());
+            Close();
+            return false;
+        }
+    }
+
+    SourceInfo current{};
+    if(!QuerySource(sourcePath, current, false))
+    {
+        Close();
+        return false;
+    }
+
+    if(current.size != m_header.source.size)
+    {
+        HGINFO("%s changed since it was cached, rebuilding its mesh cache", sourcePath.c_str());
+        Close();
+        return false;
+    }
+
+    // a touched file with the same contents is still fine, only hash when the timestamp doesn't match
+    if(current.modifiedTime != m_header.source.modifiedTime)
+    {
+        if(!QuerySource(sourcePath, current, true) || current.contentHash != m_header.source.contentHash)
+        {
+            HGINFO("%s changed since it was cached, rebuilding its mesh cache", sourcePath.c_str());
+            Close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MeshCache::Writer::Save(const std::string& sourcePath, Header header)
+{
+    namespace fs = std::filesystem;
+
+    if(!QuerySource(sourcePath, header.source, true))
+    {
+        HGWARN("Unable to read %s, not writing a mesh cache for it", sourcePath.c_str());
+        return false;
+    }
+
+    header.magic = MAGIC;
+    header.version = VERSION;
+
+    n64 offset = AlignSectionOffset(sizeof(Header));
+    for(n32 i = 0; i < SECTION_COUNT; i++)
+    {
+        header.sections[i].offset = offset;
+        header.sections[i].size = m_sections[i].size;
+        offset = AlignSectionOffset(offset + m_sections[i].size);
+    }
+
+    const fs::path cachePath = GetCachePath(sourcePath);
+    // models load concurrently, two loads of the same source must not write into the same temporary file
+    const n64      threadHash = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    const fs::path tempPath = fs::path(cachePath).concat(".tmp" + std::to_string(threadHash));
+
+    std::error_code ec;
+    fs::create_directories(cachePath.parent_path(), ec);
+
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if(!file)
+        {
+            HGWARN("Unable to create mesh cache %s", tempPath.string().c_str());
+            return false;
+        }
+
+        const char padding[SECTION_ALIGNMENT]{};
+        n64        written = sizeof(Header);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+        for(n32 i = 0; i < SECTION_COUNT; i++)
+        {
+            file.write(padding, static_cast<std::streamsize>(header.sections[i].offset - written));
+            if(m_sections[i].size > 0) { file.write(static_cast<const char*>(m_sections[i].data), static_cast<std::streamsize>(m_sections[i].size)); }
+            written = header.sections[i].offset + m_sections[i].size;
+        }
+        // pad the tail as well so empty trailing sections still point inside the file
+        file.write(padding, static_cast<std::streamsize>(offset - written));
+
+        if(!file)
+        {
+            HGWARN("Failed to write mesh cache %s", tempPath.string().c_str());
+            file.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    // write to a temporary file first so a crash never leaves a half written cache behind
+    fs::rename(tempPath, cachePath, ec);
+    if(ec)
+    {
+        HGWARN("Failed to move mesh cache into place: %s", ec.message().c_str());
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    HGINFO("Wrote mesh cache %s (%.2f MB)", cachePath.string().c_str(), static_cast<f64>(offset) / (1024.0 * 1024.0));
+    return true;
+}
+
+} // namespace Humongous
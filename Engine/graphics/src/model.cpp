@@ -1,7 +1,12 @@
 #include "abstractions/descriptor_writer.hpp"
 #include "asserts.hpp"
-#include "asset_manager.hpp"
 #include "defines.hpp"
+#include "job_system.hpp"
+#include "mapped_file.hpp"
+#include "mesh_optimizer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <logger.hpp>
 
@@ -9,6 +14,15 @@
 #define STBI_MSC_SECURE_CRT
 
 #include <model.hpp>
+#include <stb_image.h>
+
+#include "extra.hpp"
+#include "hash.hpp"
+#include "images.hpp"
+#include "texture_cache.hpp"
+#include "texture_registry.hpp"
+
+#include <glm/gtc/packing.hpp>
 
 namespace Humongous
 {
@@ -30,12 +44,6 @@ Mesh::Mesh(LogicalDevice* device, glm::mat4 matrix)
 {
     this->m_device = device;
     this->m_uniformBlock.matrix = matrix;
-
-    m_uniformBuffer.uniformBuffer.Init(device, sizeof(UniformBlock), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-    m_uniformBuffer.uniformBuffer.Map();
-
-    m_uniformBuffer.descriptorInfo = m_uniformBuffer.uniformBuffer.DescriptorInfo();
 };
 
 Mesh::~Mesh()
@@ -50,19 +58,98 @@ void Mesh::SetBoundingBox(glm::vec3 min, glm::vec3 max)
     m_bb.valid = true;
 }
 
-Model::Model(LogicalDevice* device, const std::string& modelPath, float scale)
+void Mesh::SetDequantization(glm::vec3 offset, glm::vec3 scale)
+{
+    m_uniformBlock.dequantOffset = glm::vec4(offset, 0.0f);
+    m_uniformBlock.dequantScale = glm::vec4(scale, 0.0f);
+    WriteUniformBlock();
+}
+
+void Mesh::WriteUniformBlock()
+{
+    if(!m_meshBuffer) { return; }
+    m_meshBuffer->WriteToBuffer((void*)&m_uniformBlock, sizeof(UniformBlock), m_meshIndex * sizeof(UniformBlock));
+    if(m_transformGeneration) { (*m_transformGeneration)++; }
+}
+
+Model::Model(LogicalDevice* device, const std::string& modelPath, float scale, const ModelImportSettings& settings)
+    : m_device{device}, m_importSettings{settings}
+{
+    Load(modelPath, scale);
+}
+
+Model::Model(LogicalDevice* device, const ModelImportSettings& settings) : m_device{device}, m_importSettings{settings} {}
+
+std::shared_ptr<Model> Model::LoadAsync(LogicalDevice* device, const std::string& modelPath, float scale, const ModelImportSettings& settings)
+{
+    // make_shared can't reach the private constructor
+    std::shared_ptr<Model> model(new Model(device, settings));
+
+    // the job keeps its own reference, so a model that nothing uses anymore still finishes loading before it gets destroyed
+    auto job = [model, modelPath, scale]() { model->Load(modelPath, scale); };
+
+    if(Systems::JobSystem::GetWorkerCount() == 0) { job(); }
+    else { Systems::JobSystem::ExecuteLongRunning(std::move(job)); }
+
+    return model;
+}
+
+void Model::Load(const std::string& modelPath, float scale)
 {
     HGINFO("Creating model...");
-    LoadFromFile(modelPath, device, device->GetGraphicsQueue(), scale);
-    HGINFO("Created model");
+    auto loadStart = std::chrono::high_resolution_clock::now();
+
+    // single time commands wait on their own fence, so every upload has completed once this returns
+    const bool loaded = LoadFromFile(modelPath, m_device, scale);
+    // other loads may be waiting on the textures this one created, whether it worked or not. successful loads have marked them already
+    TextureRegistry::MarkReady(this);
+    if(!loaded)
+    {
+        HGERROR("Failed to load model %s", modelPath.c_str());
+        m_loadState.store(LoadState::FAILED, std::memory_order_release);
+        return;
+    }
+    // textures shared with a model that is still loading can't be sampled before its upload is through
+    TextureRegistry::WaitUntilReady(m_textureKeys);
+
+    // the buffers the draws read are made here as well, so a ready model is fully resident and Init only writes descriptor sets
+    for(auto& node: m_nodes) { UpdateMaterialBatches(node); }
+    UploadBatch upload{m_device};
+    CreateMaterialBuffer(upload);
+    CreateDrawBuffers(upload);
+    upload.Wait();
+
+    // shared textures count towards every model using them
+    for(const auto& texture: m_textures) { m_residentBytes += texture.GetMemorySize(); }
+
+    auto loadTime = std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - loadStart);
+    HGINFO("Created model %s in %.2f ms, %.2f MB resident, %.2f MB saved by sharing textures across models", modelPath.c_str(), loadTime.count(),
+           static_cast<f64>(m_residentBytes) / (1024.0 * 1024.0), static_cast<f64>(TextureRegistry::GetDeduplicatedBytes()) / (1024.0 * 1024.0));
+
+    m_loadState.store(LoadState::READY, std::memory_order_release);
 }
 
 Model::~Model() { Destroy(m_device->GetVkDevice()); }
 
+n32 Model::GetVertexStride(VertexFormat format)
+{
+    switch(format)
+    {
+        case VertexFormat::COMPACT:
+            return sizeof(CompactVertex);
+        case VertexFormat::QUANTIZED:
+            return sizeof(QuantizedVertex);
+        default:
+            return sizeof(Vertex);
+    }
+}
+
 void Model::Destroy(VkDevice device)
 {
-    for(auto& t: m_textures) { t.Destroy(); }
-    m_emptyTexture.Destroy();
+    // the textures belong to the registry, other models may still be using them
+    for(n64 key: m_textureKeys) { TextureRegistry::Release(key); }
+    m_textureKeys.clear();
+    m_textures.clear();
 
     for(auto node: m_nodes) { delete node; }
     m_nodes.resize(0);
@@ -74,12 +161,28 @@ void Model::UpdateUBO(Node* node, glm::mat4 matrix)
     if(node->m_mesh)
     {
         node->m_mesh->m_uniformBlock.matrix = matrix;
-        node->m_mesh->m_uniformBuffer.uniformBuffer.WriteToBuffer((void*)&node->m_mesh->m_uniformBlock, sizeof(node->m_mesh->m_uniformBlock));
+        node->m_mesh->WriteUniformBlock();
     }
 }
 
 void Model::UpdateShaderMaterialBuffer(Node* node) {}
 
+// Mesh BB from BBs of primitives
+static void CalculateMeshBounds(Mesh* mesh)
+{
+    mesh->m_bb.valid = false;
+    for(auto p: mesh->m_primitives)
+    {
+        if(p->m_bb.valid && !mesh->m_bb.valid)
+        {
+            mesh->m_bb = p->m_bb;
+            mesh->m_bb.valid = true;
+        }
+        mesh->m_bb.min = glm::min(mesh->m_bb.min, p->m_bb.min);
+        mesh->m_bb.max = glm::max(mesh->m_bb.max, p->m_bb.max);
+    }
+}
+
 void Model::LoadNode(Node* parent, const tinygltf::Node& node, n32 nodeIndex, const tinygltf::Model& model, LoaderInfo& loaderInfo,
                      float globalscale)
 {
@@ -121,247 +224,330 @@ void Model::LoadNode(Node* parent, const tinygltf::Node& node, n32 nodeIndex, co
     }
 
     // Node contains mesh data
+    // only the layout gets decided here, the actual vertex/index data is decoded in parallel by DecodePrimitive once all offsets are known
     if(node.mesh > -1)
     {
-        const tinygltf::Mesh mesh = model.meshes[node.mesh];
-        Mesh*                newMesh = new Mesh(m_device, newNode->m_matrix);
-        for(size_t j = 0; j < mesh.primitives.size(); j++)
-        {
-            const tinygltf::Primitive& primitive = mesh.primitives[j];
-            n32                        vertexStart = static_cast<n32>(loaderInfo.vertexPos);
-            n32                        indexStart = static_cast<n32>(loaderInfo.indexPos);
-            n32                        indexCount = 0;
-            n32                        vertexCount = 0;
-            glm::vec3                  posMin{};
-            glm::vec3                  posMax{};
-            bool                       hasSkin = false;
-            bool                       hasIndices = primitive.indices > -1;
-            // Vertices
-            {
-                const float* bufferPos = nullptr;
-                const float* bufferNormals = nullptr;
-                const float* bufferTexCoordSet0 = nullptr;
-                const float* bufferTexCoordSet1 = nullptr;
-                const float* bufferColorSet0 = nullptr;
-                const void*  bufferJoints = nullptr;
-                const float* bufferWeights = nullptr;
-
-                int posByteStride;
-                int normByteStride;
-                int uv0ByteStride;
-                int uv1ByteStride;
-                int color0ByteStride;
-                int jointByteStride;
-                int weightByteStride;
-
-                int jointComponentType;
-
-                // Position attribute is required
-                HGASSERT(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-                const tinygltf::Accessor&   posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-                const tinygltf::BufferView& posView = model.bufferViews[posAccessor.bufferView];
-                bufferPos = reinterpret_cast<const float*>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-                posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-                posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-                vertexCount = static_cast<n32>(posAccessor.count);
-                posByteStride = posAccessor.ByteStride(posView) ? (posAccessor.ByteStride(posView) / sizeof(float))
-                                                                : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
-
-                if(primitive.attributes.find("NORMAL") != primitive.attributes.end())
-                {
-                    const tinygltf::Accessor&   normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-                    const tinygltf::BufferView& normView = model.bufferViews[normAccessor.bufferView];
-                    bufferNormals =
-                        reinterpret_cast<const float*>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-                    normByteStride = normAccessor.ByteStride(normView) ? (normAccessor.ByteStride(normView) / sizeof(float))
-                                                                       : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
-                }
+        const tinygltf::Mesh& mesh = model.meshes[node.mesh];
+        Mesh*                 newMesh = new Mesh(m_device, newNode->m_matrix);
+        for(const tinygltf::Primitive& primitive: mesh.primitives)
+        {
+            newMesh->m_primitives.push_back(LoadPrimitive(primitive, newNode, model, loaderInfo));
+        }
+        LoadAuthoredLods(node, newMesh, model, loaderInfo);
+        CalculateMeshBounds(newMesh);
+        newNode->m_mesh = newMesh;
+    }
+    if(parent) { parent->m_children.push_back(newNode); }
+    else { m_nodes.push_back(newNode); }
+    m_linearNodes.push_back(newNode);
+}
 
-                // UVs
-                if(primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end())
-                {
-                    const tinygltf::Accessor&   uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-                    const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
-                    bufferTexCoordSet0 =
-                        reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-                    uv0ByteStride = uvAccessor.ByteStride(uvView) ? (uvAccessor.ByteStride(uvView) / sizeof(float))
-                                                                  : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC2);
-                }
-                if(primitive.attributes.find("TEXCOORD_1") != primitive.attributes.end())
-                {
-                    const tinygltf::Accessor&   uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_1")->second];
-                    const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
-                    bufferTexCoordSet1 =
-                        reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-                    uv1ByteStride = uvAccessor.ByteStride(uvView) ? (uvAccessor.ByteStride(uvView) / sizeof(float))
-                                                                  : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC2);
-                }
+Primitive* Model::LoadPrimitive(const tinygltf::Primitive& primitive, Node* owner, const tinygltf::Model& model, LoaderInfo& loaderInfo)
+{
+    n32  vertexStart = static_cast<n32>(loaderInfo.vertexPos);
+    n32  indexCount = 0;
+    n32  vertexCount = 0;
+    bool hasIndices = primitive.indices > -1;
+
+    // Position attribute is required
+    HGASSERT(primitive.attributes.find("POSITION") != primitive.attributes.end());
+
+    const tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+    glm::vec3                 posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
+    glm::vec3                 posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
+    vertexCount = static_cast<n32>(posAccessor.count);
+
+    if(hasIndices)
+    {
+        const tinygltf::Accessor& accessor = model.accessors[primitive.indices];
+        switch(accessor.componentType)
+        {
+            case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+            case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+            case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+                indexCount = static_cast<n32>(accessor.count);
+                break;
+            default:
+                HGERROR("Index component type %d not supported!", accessor.componentType);
+                hasIndices = false;
+                break;
+        }
+    }
 
-                // Vertex colors
-                if(primitive.attributes.find("COLOR_0") != primitive.attributes.end())
+    // local indices of small primitives fit in 16 bits
+    VkIndexType indexType = vertexCount <= 0xFFFF && !loaderInfo.deferIndexType ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    size_t&     indexPos = indexType == VK_INDEX_TYPE_UINT16 ? loaderInfo.shortIndexPos : loaderInfo.indexPos;
+    n32         indexStart = static_cast<n32>(indexPos);
+
+    Primitive* newPrimitive =
+        new Primitive(indexStart, indexCount, vertexCount, primitive.material > -1 ? m_materials[primitive.material] : m_materials.back());
+    newPrimitive->SetBoundingBox(posMin, posMax);
+    newPrimitive->m_firstVertex = vertexStart;
+    newPrimitive->m_indexType = indexType;
+    newPrimitive->m_owner = owner;
+
+    loaderInfo.primitiveJobs.push_back({&primitive, newPrimitive, vertexStart, indexStart, indexType, hasIndices});
+    loaderInfo.vertexPos += vertexCount;
+    indexPos += indexCount;
+
+    return newPrimitive;
+}
+
+void Model::LoadAuthoredLods(const tinygltf::Node& node, Mesh* mesh, const tinygltf::Model& model, LoaderInfo& loaderInfo)
+{
+    auto extension = node.extensions.find("MSFT_lod");
+    if(extension == node.extensions.end() || !extension->second.Has("ids")) { return; }
+
+    const tinygltf::Value& ids = extension->second.Get("ids");
+    const tinygltf::Value* coverages = node.extras.Has("MSFT_screencoverage") ? &node.extras.Get("MSFT_screencoverage") : nullptr;
+
+    // the lod nodes aren't part of the scene, only their meshes are used. primitives are matched up by their position in the mesh
+    f32 coverage = 1.0f;
+    for(size_t i = 0; i < ids.ArrayLen(); i++)
+    {
+        s32 id = ids.Get(static_cast<int>(i)).GetNumberAsInt();
+        if(id < 0 || id >= static_cast<s32>(model.nodes.size()) || model.nodes[id].mesh < 0) { continue; }
+
+        // level i + 1 takes over below the coverage of level i, without coverages every level halves it
+        coverage *= 0.5f;
+        if(coverages && i < coverages->ArrayLen()) { coverage = static_cast<f32>(coverages->Get(static_cast<int>(i)).GetNumberAsDouble()); }
+
+        const tinygltf::Mesh& lodMesh = model.meshes[model.nodes[id].mesh];
+        for(size_t p = 0; p < lodMesh.primitives.size() && p < mesh->m_primitives.size(); p++)
+        {
+            LoadPrimitive(lodMesh.primitives[p], mesh->m_primitives[p]->m_owner, model, loaderInfo);
+            loaderInfo.primitiveJobs.back().lodOf = mesh->m_primitives[p];
+            loaderInfo.primitiveJobs.back().lodCoverage = coverage;
+        }
+    }
+}
+
+// a vertex attribute as it sits in the glTF buffers, KHR_mesh_quantization allows (normalized) integer types besides floats
+struct AttributeView
+{
+    const n8* data = nullptr;
+    size_t    stride = 0;
+    s32       componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    s32       componentCount = 0;
+    bool      normalized = false;
+};
+
+static bool FindAttribute(const tinygltf::Model& model, const tinygltf::Primitive& primitive, const char* name, AttributeView& view)
+{
+    auto attribute = primitive.attributes.find(name);
+    if(attribute == primitive.attributes.end()) { return false; }
+
+    const tinygltf::Accessor& accessor = model.accessors[attribute->second];
+    if(accessor.bufferView < 0) { return false; }
+
+    const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+    view.data = &model.buffers[bufferView.buffer].data[accessor.byteOffset + bufferView.byteOffset];
+    view.componentType = accessor.componentType;
+    view.componentCount = tinygltf::GetNumComponentsInType(accessor.type);
+    view.normalized = accessor.normalized;
+
+    s32 stride = accessor.ByteStride(bufferView);
+    view.stride = stride > 0 ? static_cast<size_t>(stride) : view.componentCount * tinygltf::GetComponentSizeInBytes(accessor.componentType);
+    return view.componentCount > 0;
+}
+
+// missing components are taken from fallback, so a vec3 color still gets its alpha
+static glm::vec4 ReadAttribute(const AttributeView& view, size_t index, glm::vec4 fallback)
+{
+    const n8* element = view.data + index * view.stride;
+    glm::vec4 result = fallback;
+
+    for(s32 c = 0; c < view.componentCount && c < 4; c++)
+    {
+        f32 value;
+        switch(view.componentType)
+        {
+            case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                std::memcpy(&value, element + c * sizeof(f32), sizeof(f32));
+                break;
+            case TINYGLTF_COMPONENT_TYPE_BYTE:
+                value = static_cast<f32>(reinterpret_cast<const s8*>(element)[c]);
+                if(view.normalized) { value = std::max(value / 127.0f, -1.0f); }
+                break;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                value = static_cast<f32>(element[c]);
+                if(view.normalized) { value /= 255.0f; }
+                break;
+            case TINYGLTF_COMPONENT_TYPE_SHORT:
                 {
-                    const tinygltf::Accessor&   accessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-                    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
-                    bufferColorSet0 = reinterpret_cast<const float*>(&(model.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                    color0ByteStride = accessor.ByteStride(view) ? (accessor.ByteStride(view) / sizeof(float))
-                                                                 : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
+                    s16 raw;
+                    std::memcpy(&raw, element + c * sizeof(s16), sizeof(s16));
+                    value = static_cast<f32>(raw);
+                    if(view.normalized) { value = std::max(value / 32767.0f, -1.0f); }
+                    break;
                 }
-
-                // Skinning
-                // Joints
-                if(primitive.attributes.find("JOINTS_0") != primitive.attributes.end())
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
                 {
-                    const tinygltf::Accessor&   jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-                    const tinygltf::BufferView& jointView = model.bufferViews[jointAccessor.bufferView];
-                    bufferJoints = &(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]);
-                    jointComponentType = jointAccessor.componentType;
-                    jointByteStride = jointAccessor.ByteStride(jointView)
-                                          ? (jointAccessor.ByteStride(jointView) / tinygltf::GetComponentSizeInBytes(jointComponentType))
-                                          : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4);
+                    n16 raw;
+                    std::memcpy(&raw, element + c * sizeof(n16), sizeof(n16));
+                    value = static_cast<f32>(raw);
+                    if(view.normalized) { value /= 65535.0f; }
+                    break;
                 }
-
-                if(primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end())
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
                 {
-                    const tinygltf::Accessor&   weightAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-                    const tinygltf::BufferView& weightView = model.bufferViews[weightAccessor.bufferView];
-                    bufferWeights =
-                        reinterpret_cast<const float*>(&(model.buffers[weightView.buffer].data[weightAccessor.byteOffset + weightView.byteOffset]));
-                    weightByteStride = weightAccessor.ByteStride(weightView) ? (weightAccessor.ByteStride(weightView) / sizeof(float))
-                                                                             : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4);
+                    n32 raw;
+                    std::memcpy(&raw, element + c * sizeof(n32), sizeof(n32));
+                    value = static_cast<f32>(raw);
+                    break;
                 }
+            default:
+                return fallback;
+        }
+        result[c] = value;
+    }
 
-                hasSkin = (bufferJoints && bufferWeights);
+    return result;
+}
 
-                for(size_t v = 0; v < posAccessor.count; v++)
-                {
-                    Vertex& vert = loaderInfo.vertexBuffer[loaderInfo.vertexPos];
-                    vert.position = glm::vec4(glm::make_vec3(&bufferPos[v * posByteStride]), 1.0f);
-                    vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * normByteStride]) : glm::vec3(0.0f)));
-                    vert.uv0 = bufferTexCoordSet0 ? glm::make_vec2(&bufferTexCoordSet0[v * uv0ByteStride]) : glm::vec3(0.0f);
-                    vert.uv1 = bufferTexCoordSet1 ? glm::make_vec2(&bufferTexCoordSet1[v * uv1ByteStride]) : glm::vec3(0.0f);
-                    vert.color = bufferColorSet0 ? glm::make_vec4(&bufferColorSet0[v * color0ByteStride]) : glm::vec4(1.0f);
-
-                    if(hasSkin)
-                    {
-                        switch(jointComponentType)
-                        {
-                            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                                {
-                                    const uint16_t* buf = static_cast<const uint16_t*>(bufferJoints);
-                                    // vert.joint0 = glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
-                                    break;
-                                }
-                            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                                {
-                                    const uint8_t* buf = static_cast<const uint8_t*>(bufferJoints);
-                                    // vert.joint0 = glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
-                                    break;
-                                }
-                            default:
-                                // Not supported by spec
-                                std::cerr << "Joint component type " << jointComponentType << " not supported!" << std::endl;
-                                break;
-                        }
-                    }
-                    else
-                    {
-                        // vert.joint0 = glm::vec4(0.0f);
-                    }
-                    // vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * weightByteStride]) : glm::vec4(0.0f);
-                    // Fix for all zero weights
-                    // if (glm::length(vert.weight0) == 0.0f) {
-                    // 	vert.weight0 = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
-                    // }
-                    loaderInfo.vertexPos++;
-                }
+template <typename T> static void CopyIndices(const void* src, s32 componentType, size_t count, T* dst)
+{
+    switch(componentType)
+    {
+        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+            {
+                const n32* buf = static_cast<const n32*>(src);
+                for(size_t index = 0; index < count; index++) { dst[index] = static_cast<T>(buf[index]); }
+                break;
+            }
+        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+            {
+                const uint16_t* buf = static_cast<const uint16_t*>(src);
+                for(size_t index = 0; index < count; index++) { dst[index] = static_cast<T>(buf[index]); }
+                break;
             }
-            // Indices
-            if(hasIndices)
+        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
             {
-                const tinygltf::Accessor&   accessor = model.accessors[primitive.indices > -1 ? primitive.indices : 0];
-                const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-                const tinygltf::Buffer&     buffer = model.buffers[bufferView.buffer];
+                const uint8_t* buf = static_cast<const uint8_t*>(src);
+                for(size_t index = 0; index < count; index++) { dst[index] = static_cast<T>(buf[index]); }
+                break;
+            }
+    }
+}
 
-                indexCount = static_cast<n32>(accessor.count);
-                const void* dataPtr = &(buffer.data[accessor.byteOffset + bufferView.byteOffset]);
+void Model::DecodePrimitive(const PrimitiveLoadJob& job, const tinygltf::Model& model, LoaderInfo& loaderInfo)
+{
+    const tinygltf::Primitive& primitive = *job.primitive;
+    const n32                  vertexStart = job.vertexStart;
+    bool                       hasSkin = false;
+
+    // Vertices
+    {
+        AttributeView position, normal, uv0, uv1, color0;
+        const void*   bufferJoints = nullptr;
+        const float*  bufferWeights = nullptr;
+
+        int jointByteStride;
+        int weightByteStride;
+
+        int jointComponentType;
+
+        const tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+        FindAttribute(model, primitive, "POSITION", position);
+        bool hasNormals = FindAttribute(model, primitive, "NORMAL", normal);
+        bool hasUV0 = FindAttribute(model, primitive, "TEXCOORD_0", uv0);
+        bool hasUV1 = FindAttribute(model, primitive, "TEXCOORD_1", uv1);
+        bool hasColor = FindAttribute(model, primitive, "COLOR_0", color0);
+
+        // Skinning
+        // Joints
+        if(primitive.attributes.find("JOINTS_0") != primitive.attributes.end())
+        {
+            const tinygltf::Accessor&   jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
+            const tinygltf::BufferView& jointView = model.bufferViews[jointAccessor.bufferView];
+            bufferJoints = &(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]);
+            jointComponentType = jointAccessor.componentType;
+            jointByteStride = jointAccessor.ByteStride(jointView)
+                                  ? (jointAccessor.ByteStride(jointView) / tinygltf::GetComponentSizeInBytes(jointComponentType))
+                                  : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4);
+        }
+
+        if(primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end())
+        {
+            const tinygltf::Accessor&   weightAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
+            const tinygltf::BufferView& weightView = model.bufferViews[weightAccessor.bufferView];
+            bufferWeights =
+                reinterpret_cast<const float*>(&(model.buffers[weightView.buffer].data[weightAccessor.byteOffset + weightView.byteOffset]));
+            weightByteStride = weightAccessor.ByteStride(weightView) ? (weightAccessor.ByteStride(weightView) / sizeof(float))
+                                                                     : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4);
+        }
+
+        hasSkin = (bufferJoints && bufferWeights);
+
+        // the accessor bounds of quantized positions aren't in model units, take them from the decoded positions instead
+        bool boundsFromVertices = position.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT;
+        glm::vec3 posMin = glm::vec3(FLT_MAX);
+        glm::vec3 posMax = glm::vec3(-FLT_MAX);
+
+        for(size_t v = 0; v < posAccessor.count; v++)
+        {
+            Vertex& vert = loaderInfo.vertexBuffer[vertexStart + v];
+            vert.position = glm::vec3(ReadAttribute(position, v, glm::vec4(0.0f)));
+            vert.normal = glm::normalize(hasNormals ? glm::vec3(ReadAttribute(normal, v, glm::vec4(0.0f))) : glm::vec3(0.0f));
+            vert.uv0 = hasUV0 ? glm::vec2(ReadAttribute(uv0, v, glm::vec4(0.0f))) : glm::vec2(0.0f);
+            vert.uv1 = hasUV1 ? glm::vec2(ReadAttribute(uv1, v, glm::vec4(0.0f))) : glm::vec2(0.0f);
+            vert.color = hasColor ? ReadAttribute(color0, v, glm::vec4(1.0f)) : glm::vec4(1.0f);
+
+            if(boundsFromVertices)
+            {
+                posMin = glm::min(posMin, vert.position);
+                posMax = glm::max(posMax, vert.position);
+            }
 
-                switch(accessor.componentType)
+            if(hasSkin)
+            {
+                switch(jointComponentType)
                 {
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
-                        {
-                            const n32* buf = static_cast<const n32*>(dataPtr);
-                            for(size_t index = 0; index < accessor.count; index++)
-                            {
-                                loaderInfo.indexBuffer[loaderInfo.indexPos] = buf[index] + vertexStart;
-                                loaderInfo.indexPos++;
-                            }
-                            break;
-                        }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
                         {
-                            const uint16_t* buf = static_cast<const uint16_t*>(dataPtr);
-                            for(size_t index = 0; index < accessor.count; index++)
-                            {
-                                loaderInfo.indexBuffer[loaderInfo.indexPos] = buf[index] + vertexStart;
-                                loaderInfo.indexPos++;
-                            }
+                            const uint16_t* buf = static_cast<const uint16_t*>(bufferJoints);
+                            // vert.joint0 = glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
                             break;
                         }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
                         {
-                            const uint8_t* buf = static_cast<const uint8_t*>(dataPtr);
-                            for(size_t index = 0; index < accessor.count; index++)
-                            {
-                                loaderInfo.indexBuffer[loaderInfo.indexPos] = buf[index] + vertexStart;
-                                loaderInfo.indexPos++;
-                            }
+                            const uint8_t* buf = static_cast<const uint8_t*>(bufferJoints);
+                            // vert.joint0 = glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
                             break;
                         }
                     default:
-                        std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-                        return;
+                        // Not supported by spec
+                        std::cerr << "Joint component type " << jointComponentType << " not supported!" << std::endl;
+                        break;
                 }
             }
-            Primitive* newPrimitive =
-                new Primitive(indexStart, indexCount, vertexCount, primitive.material > -1 ? m_materials[primitive.material] : m_materials.back());
-            newPrimitive->SetBoundingBox(posMin, posMax);
-            newPrimitive->m_owner = newNode;
-            newMesh->m_primitives.push_back(newPrimitive);
-        }
-        // Mesh BB from BBs of primitives
-        for(auto p: newMesh->m_primitives)
-        {
-            if(p->m_bb.valid && !newMesh->m_bb.valid)
+            else
             {
-                newMesh->m_bb = p->m_bb;
-                newMesh->m_bb.valid = true;
+                // vert.joint0 = glm::vec4(0.0f);
             }
-            newMesh->m_bb.min = glm::min(newMesh->m_bb.min, p->m_bb.min);
-            newMesh->m_bb.max = glm::max(newMesh->m_bb.max, p->m_bb.max);
+            // vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * weightByteStride]) : glm::vec4(0.0f);
+            // Fix for all zero weights
+            // if (glm::length(vert.weight0) == 0.0f) {
+            // 	vert.weight0 = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+            // }
         }
-        newNode->m_mesh = newMesh;
-    }
-    if(parent) { parent->m_children.push_back(newNode); }
-    else { m_nodes.push_back(newNode); }
-    m_linearNodes.push_back(newNode);
-}
 
-void Model::GetNodeProps(const tinygltf::Node& node, const tinygltf::Model& model, size_t& vertexCount, size_t& indexCount)
-{
-    if(node.children.size() > 0)
-    {
-        for(size_t i = 0; i < node.children.size(); i++) { GetNodeProps(model.nodes[node.children[i]], model, vertexCount, indexCount); }
+        if(boundsFromVertices && posAccessor.count > 0) { job.target->SetBoundingBox(posMin, posMax); }
     }
-    if(node.mesh > -1)
+    // Indices
+    if(job.hasIndices)
     {
-        const tinygltf::Mesh mesh = model.meshes[node.mesh];
-        for(size_t i = 0; i < mesh.primitives.size(); i++)
+        const tinygltf::Accessor&   accessor = model.accessors[primitive.indices];
+        const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+        const tinygltf::Buffer&     buffer = model.buffers[bufferView.buffer];
+
+        const void* dataPtr = &(buffer.data[accessor.byteOffset + bufferView.byteOffset]);
+
+        if(job.indexType == VK_INDEX_TYPE_UINT16)
         {
-            auto primitive = mesh.primitives[i];
-            vertexCount += model.accessors[primitive.attributes.find("POSITION")->second].count;
-            if(primitive.indices > -1) { indexCount += model.accessors[primitive.indices].count; }
+            CopyIndices(dataPtr, accessor.componentType, accessor.count, &loaderInfo.shortIndexBuffer[job.indexStart]);
         }
+        else { CopyIndices(dataPtr, accessor.componentType, accessor.count, &loaderInfo.indexBuffer[job.indexStart]); }
     }
 }
 
@@ -405,11 +591,43 @@ VkFilter Model::GetVkFilterMode(s32 filterMode)
     return VK_FILTER_NEAREST;
 }
 
-void Model::LoadTextures(tinygltf::Model& gltfModel, LogicalDevice* device, VkQueue transferQueue)
+// compressed images are compared against the RGBA8 image with a full mip chain they replace
+static void LogTextureMemory(const std::vector<Texture>& textures, const std::vector<Utils::CompressedImage>& compressedImages)
+{
+    VkDeviceSize textureMemory = 0, compressedSize = 0, uncompressedSize = 0;
+    for(const Texture& texture: textures) { textureMemory += texture.GetMemorySize(); }
+    for(const Utils::CompressedImage& image: compressedImages)
+    {
+        if(!image.IsValid()) { continue; }
+        compressedSize += image.data.size();
+        uncompressedSize += static_cast<VkDeviceSize>(image.width) * image.height * 4 * 4 / 3;
+    }
+
+    HGINFO("Textures take %.2f MB of video memory, block compressed images %.2f MB instead of %.2f MB", textureMemory / (1024.0 * 1024.0),
+           compressedSize / (1024.0 * 1024.0), uncompressedSize / (1024.0 * 1024.0));
+}
+
+// textures made from the same image with the same sampler are uploaded once, whoever acquires one first records its upload
+void Model::AcquireTexture(size_t index, n64 imageKey, const Texture::TexSamplerInfo& textureSampler, tinygltf::Image& image,
+                           const Utils::CompressedImage& compressed, UploadBatch& upload)
+{
+    const n64 key = Utils::HashBytes(&textureSampler, sizeof(textureSampler), imageKey);
+    m_textures[index] = TextureRegistry::Acquire(key, this, [&](Texture& texture) {
+        if(compressed.IsValid()) { texture.CreateFromCompressedImage(compressed, textureSampler, m_device, &upload); }
+        else { texture.CreateFromGLTFImage(image, textureSampler, m_device, &upload); }
+    });
+    m_textureKeys[index] = key;
+}
+
+void Model::LoadTextures(tinygltf::Model& gltfModel, UploadBatch& upload, const std::vector<Utils::CompressedImage>& compressedImages,
+                         const std::vector<n64>& imageKeys)
 {
-    for(tinygltf::Texture& tex: gltfModel.textures)
+    m_textureKeys.resize(gltfModel.textures.size());
+
+    for(size_t i = 0; i < gltfModel.textures.size(); i++)
     {
-        tinygltf::Image         image = gltfModel.images[tex.source];
+        tinygltf::Texture&      tex = gltfModel.textures[i];
+        tinygltf::Image&        image = gltfModel.images[tex.source];
         Texture::TexSamplerInfo textureSampler;
         if(tex.sampler == -1)
         {
@@ -421,13 +639,10 @@ void Model::LoadTextures(tinygltf::Model& gltfModel, LogicalDevice* device, VkQu
             textureSampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         }
         else { textureSampler = m_textureSamplers[tex.sampler]; }
-        Texture texture;
-        texture.CreateFromGLTFImage(image, textureSampler, device, transferQueue);
-        m_textures.push_back(texture);
-    }
 
-    m_emptyTexture.CreateFromFile(Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::TEXTURE, "empty"), device,
-                                  Texture::ImageType::TEX2D);
+        AcquireTexture(i, imageKeys[tex.source], textureSampler, image, compressedImages[tex.source], upload);
+    }
+    LogTextureMemory(m_textures, compressedImages);
 }
 
 void Model::LoadTextureSamplers(tinygltf::Model& gltfModel)
@@ -576,16 +791,228 @@ void Model::LoadMaterials(tinygltf::Model& gltfModel)
     m_materialBatches.emplace(m_materialBatches.size(), empt);
 }
 
-void Model::LoadFromFile(std::string filename, LogicalDevice* device, VkQueue transferQueue, float scale)
+// the loader decodes into staging memory and keeps reading it while it optimizes, so it has to be host cached and mapped for good
+static std::unique_ptr<Buffer> CreateStagingBuffer(LogicalDevice* device, size_t size)
+{
+    if(size == 0) { return nullptr; }
+
+    auto staging = std::make_unique<Buffer>();
+    staging->InitStaging(device, size);
+    return staging;
+}
+
+template <typename T> static T* GetStagingData(const std::unique_ptr<Buffer>& staging)
+{
+    return staging ? static_cast<T*>(staging->GetMappedMemory()) : nullptr;
+}
+
+// tinygltf hands every image to this while it parses. only the encoded bytes are kept, the decode runs on the job system afterwards
+static bool DeferImageDecode(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int reqWidth, int reqHeight,
+                             const unsigned char* bytes, int size, void* userData)
+{
+    s32 width, height, channels;
+    if(!stbi_info_from_memory(bytes, size, &width, &height, &channels))
+    {
+        if(error) { *error += "Unknown image format for image " + std::to_string(imageIndex) + "\n"; }
+        return false;
+    }
+
+    image->width = width;
+    image->height = height;
+    image->component = 4;
+    image->bits = 8;
+    image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+
+    auto& encodedImages = *static_cast<std::vector<std::vector<n8>>*>(userData);
+    if(encodedImages.size() <= static_cast<size_t>(imageIndex)) { encodedImages.resize(imageIndex + 1); }
+    encodedImages[imageIndex].assign(bytes, bytes + size);
+    return true;
+}
+
+enum ImageUsage : n8
+{
+    IMAGE_USAGE_COLOR = 1 << 0,
+    IMAGE_USAGE_DATA = 1 << 1,
+    IMAGE_USAGE_NORMAL = 1 << 2,
+    IMAGE_USAGE_OCCLUSION = 1 << 3,
+};
+
+// what an image gets compressed as and how its mips are filtered
+struct ImageImport
+{
+    bool               compress = false;
+    Utils::TextureRole role = Utils::TextureRole::COLOR;
+    Utils::MipFilter   mipFilter = Utils::MipFilter::KAISER;
+};
+
+struct ImageImportStats
+{
+    std::atomic<n64> microseconds{0};
+    std::atomic<n64> mipMicroseconds{0};
+    std::atomic<n32> cacheHits{0};
+    std::atomic<n32> compressed{0};
+};
+
+// an image only gets a BC format made for one kind of data when every material samples it as that kind. occlusion packed into the
+// metallic roughness image is common enough to count as one kind
+static std::vector<ImageImport> GetImageImports(const std::vector<Material>& materials, const Texture* textures,
+                                                const std::vector<s32>& textureImages, size_t imageCount, bool compress,
+                                                Utils::MipFilter mipFilter)
+{
+    std::vector<n8> usage(imageCount, 0);
+    auto            markUsage = [&](const Texture* texture, n8 kind) {
+        if(texture && textureImages[texture - textures] >= 0) { usage[textureImages[texture - textures]] |= kind; }
+    };
+
+    for(const Material& material: materials)
+    {
+        markUsage(material.baseColorTexture, IMAGE_USAGE_COLOR);
+        markUsage(material.metallicRoughnessTexture, IMAGE_USAGE_DATA);
+        markUsage(material.emissiveTexture, IMAGE_USAGE_COLOR);
+        markUsage(material.extension.specularGlossinessTexture, IMAGE_USAGE_COLOR);
+        markUsage(material.extension.diffuseTexture, IMAGE_USAGE_COLOR);
+        markUsage(material.normalTexture, IMAGE_USAGE_NORMAL);
+        markUsage(material.occlusionTexture, IMAGE_USAGE_OCCLUSION);
+    }
+
+    std::vector<ImageImport> imports(imageCount);
+    for(size_t i = 0; i < imageCount; i++)
+    {
+        const n8   mask = usage[i];
+        const bool oneKind = mask == IMAGE_USAGE_COLOR || mask == IMAGE_USAGE_NORMAL || mask == IMAGE_USAGE_OCCLUSION ||
+                             (mask & ~(IMAGE_USAGE_DATA | IMAGE_USAGE_OCCLUSION)) == 0;
+
+        imports[i].compress = compress && mask != 0 && oneKind;
+        imports[i].mipFilter = mipFilter;
+        if(mask == IMAGE_USAGE_NORMAL) { imports[i].role = Utils::TextureRole::NORMAL; }
+        else if(mask == IMAGE_USAGE_OCCLUSION) { imports[i].role = Utils::TextureRole::OCCLUSION; }
+        else if(mask & IMAGE_USAGE_COLOR) { imports[i].role = Utils::TextureRole::COLOR; }
+        else { imports[i].role = Utils::TextureRole::DATA; }
+    }
+
+    return imports;
+}
+
+// decodes an encoded image to 8 bit RGBA and builds its mip chain, image.image ends up holding every level (see Utils::BuildMipChain).
+// images that get block compressed instead come out of the texture cache when they were compressed before, either way they are left
+// without pixels
+// imageKey identifies what the image turns into on the gpu, textures made from it are shared through the TextureRegistry
+static void ImportImage(const n8* bytes, size_t size, const ImageImport& import, tinygltf::Image& image, Utils::CompressedImage& compressed,
+                        n64& imageKey, ImageImportStats& stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    auto recordTime = [&]() {
+        auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+        stats.microseconds.fetch_add(static_cast<n64>(time.count()), std::memory_order_relaxed);
+    };
+
+    const n64 sourceHash = Utils::HashBytes(bytes, size);
+    const n8  settings[3] = {import.compress, static_cast<n8>(import.role), static_cast<n8>(import.mipFilter)};
+    imageKey = Utils::HashBytes(settings, sizeof(settings), sourceHash);
+
+    if(import.compress && TextureCache::Load(sourceHash, import.role, import.mipFilter, compressed))
+    {
+        image.width = static_cast<s32>(compressed.width);
+        image.height = static_cast<s32>(compressed.height);
+        stats.cacheHits.fetch_add(1, std::memory_order_relaxed);
+        recordTime();
+        return;
+    }
+
+    // stb adds the alpha channel one byte at a time, so RGB images are decoded as they are and expanded afterwards
+    s32 width = 0, height = 0, channels = 0;
+    stbi_info_from_memory(bytes, static_cast<s32>(size), &width, &height, &channels);
+    const s32 desiredChannels = channels == 3 ? 3 : 4;
+    stbi_uc*  pixels = stbi_load_from_memory(bytes, static_cast<s32>(size), &width, &height, &channels, desiredChannels);
+    if(!pixels)
+    {
+        HGWARN("Failed to decode image %s: %s", image.uri.c_str(), stbi_failure_reason());
+        // a bad image shows up white instead of failing the load, at whatever size the parser found if it got that far
+        if(image.width <= 0 || image.height <= 0) { image.width = image.height = 1; }
+        image.component = 4;
+        image.bits = 8;
+        image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+        image.image.assign(Utils::GetMipChainSize(image.width, image.height), 0xFF);
+        recordTime();
+        return;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.component = 4;
+    image.bits = 8;
+    image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+
+    // level 0 is decoded straight into the front of the chain
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    image.image.resize(import.compress ? pixelCount * 4 : Utils::GetMipChainSize(width, height));
+    if(desiredChannels == 3) { Utils::ExpandRGBToRGBA(pixels, image.image.data(), pixelCount); }
+    else { std::memcpy(image.image.data(), pixels, pixelCount * 4); }
+    stbi_image_free(pixels);
+
+    auto mipStart = std::chrono::high_resolution_clock::now();
+    if(import.compress)
+    {
+        compressed = Utils::CompressImage(image.image.data(), static_cast<n32>(width), static_cast<n32>(height), import.role, import.mipFilter);
+        TextureCache::Save(sourceHash, import.role, import.mipFilter, compressed);
+        image.image = {};
+        stats.compressed.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        Utils::BuildMipChain(image.image.data(), static_cast<n32>(width), static_cast<n32>(height), Utils::GetMipContent(import.role),
+                             import.mipFilter, image.image.data());
+        auto mipTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - mipStart);
+        stats.mipMicroseconds.fetch_add(static_cast<n64>(mipTime.count()), std::memory_order_relaxed);
+    }
+
+    recordTime();
+}
+
+// one job per image, the encoded bytes are freed as soon as the image is through
+static void ImportImages(tinygltf::Model& gltfModel, std::vector<std::vector<n8>>& encodedImages, const std::vector<ImageImport>& imports,
+                         std::vector<Utils::CompressedImage>& compressedImages, std::vector<n64>& imageKeys, Systems::JobSystem::Counter& counter,
+                         ImageImportStats& stats)
+{
+    for(size_t i = 0; i < encodedImages.size(); i++)
+    {
+        if(encodedImages[i].empty()) { continue; }
+
+        Systems::JobSystem::Execute(
+            [&, i]() {
+                ImportImage(encodedImages[i].data(), encodedImages[i].size(), imports[i], gltfModel.images[i], compressedImages[i], imageKeys[i],
+                            stats);
+                encodedImages[i] = {};
+            },
+            &counter);
+    }
+}
+
+bool Model::LoadFromFile(std::string filename, LogicalDevice* device, float scale)
 {
     tinygltf::Model    gltfModel;
     tinygltf::TinyGLTF gltfContext;
 
+    std::vector<std::vector<n8>> encodedImages;
+    gltfContext.SetImageLoader(DeferImageDecode, &encodedImages);
+
     std::string error;
     std::string warning;
 
     this->m_device = device;
 
+    MeshCache cache;
+    if(cache.Open(filename))
+    {
+        if(LoadFromCache(cache, filename))
+        {
+            HGINFO("Loaded %s from its mesh cache", filename.c_str());
+            return true;
+        }
+        HGWARN("Mesh cache of %s is unusable, importing the source instead", filename.c_str());
+        cache.Close();
+    }
+
     bool   binary = false;
     size_t extpos = filename.rfind('.', filename.length());
     if(extpos != std::string::npos) { binary = (filename.substr(extpos + 1, filename.length() - extpos) == "glb"); }
@@ -596,26 +1023,105 @@ void Model::LoadFromFile(std::string filename, LogicalDevice* device, VkQueue tr
     LoaderInfo loaderInfo{};
     size_t     vertexCount = 0;
     size_t     indexCount = 0;
+    size_t     shortIndexCount = 0;
+
+    loaderInfo.deferIndexType = m_importSettings.optimizeMeshes;
+
+    UploadBatch textureUpload{device};
 
     if(fileLoaded)
     {
         LoadTextureSamplers(gltfModel);
-        LoadTextures(gltfModel, device, transferQueue);
+        // materials only point at the textures, the images behind them get created once they're decoded
+        m_textures.resize(gltfModel.textures.size());
         LoadMaterials(gltfModel);
 
-        const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+        // the materials decide what each image gets compressed as
+        std::vector<s32> textureImages;
+        for(const tinygltf::Texture& texture: gltfModel.textures) { textureImages.push_back(texture.source); }
+        const bool compressTextures = m_importSettings.compressTextures && device->SupportsBCTextures();
+        const std::vector<ImageImport> imageImports =
+            GetImageImports(m_materials, m_textures.data(), textureImages, gltfModel.images.size(), compressTextures, m_importSettings.mipFilter);
+
+        // the images decode on the workers while the geometry gets processed below
+        encodedImages.resize(gltfModel.images.size());
+        std::vector<Utils::CompressedImage> compressedImages(gltfModel.images.size());
+        std::vector<n64>                    imageKeys(gltfModel.images.size());
+        Systems::JobSystem::Counter         imageImportJobs{0};
+        ImageImportStats                    imageStats;
+        ImportImages(gltfModel, encodedImages, imageImports, compressedImages, imageKeys, imageImportJobs, imageStats);
 
-        // Get vertex and index buffer sizes up-front
-        for(size_t i = 0; i < scene.nodes.size(); i++) { GetNodeProps(gltfModel.nodes[scene.nodes[i]], gltfModel, vertexCount, indexCount); }
-        loaderInfo.vertexBuffer = new Vertex[vertexCount];
-        loaderInfo.indexBuffer = new n32[indexCount];
+        const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
 
+        // First pass: build the node hierarchy and hand out each primitive's vertex/index range
         // TODO: scene handling with no default scene
         for(size_t i = 0; i < scene.nodes.size(); i++)
         {
-            const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+            const tinygltf::Node& node = gltfModel.nodes[scene.nodes[i]];
             LoadNode(nullptr, node, scene.nodes[i], gltfModel, loaderInfo, scale);
         }
+
+        vertexCount = loaderInfo.vertexPos;
+        indexCount = loaderInfo.indexPos;
+        shortIndexCount = loaderInfo.shortIndexPos;
+        if(m_importSettings.vertexFormat == VertexFormat::FULL)
+        {
+            loaderInfo.vertexStaging = CreateStagingBuffer(device, vertexCount * sizeof(Vertex));
+            loaderInfo.vertexBuffer = GetStagingData<Vertex>(loaderInfo.vertexStaging);
+        }
+        else
+        {
+            loaderInfo.vertexScratch = std::make_unique<Vertex[]>(vertexCount);
+            loaderInfo.vertexBuffer = loaderInfo.vertexScratch.get();
+        }
+        loaderInfo.indexStaging = CreateStagingBuffer(device, indexCount * sizeof(n32));
+        loaderInfo.indexBuffer = GetStagingData<n32>(loaderInfo.indexStaging);
+        loaderInfo.shortIndexStaging = CreateStagingBuffer(device, shortIndexCount * sizeof(n16));
+        loaderInfo.shortIndexBuffer = GetStagingData<n16>(loaderInfo.shortIndexStaging);
+
+        // Second pass: ranges don't overlap, so every primitive can be decoded on its own
+        auto decodeStart = std::chrono::high_resolution_clock::now();
+
+        Systems::JobSystem::ParallelFor(static_cast<n32>(loaderInfo.primitiveJobs.size()), 1, [&](n32 begin, n32 end) {
+            for(n32 i = begin; i < end; i++) { DecodePrimitive(loaderInfo.primitiveJobs[i], gltfModel, loaderInfo); }
+        });
+
+        if(m_importSettings.optimizeMeshes)
+        {
+            OptimizeGeometry(loaderInfo);
+            vertexCount = loaderInfo.vertexPos;
+            indexCount = loaderInfo.indexPos;
+            shortIndexCount = loaderInfo.shortIndexPos;
+        }
+        BuildMeshlets(loaderInfo);
+        GenerateLods(loaderInfo);
+        indexCount = loaderInfo.indexPos;
+        shortIndexCount = loaderInfo.shortIndexPos;
+
+        // decoding can tighten primitive bounds, see DecodePrimitive
+        for(auto node: m_linearNodes)
+        {
+            if(node->m_mesh) { CalculateMeshBounds(node->m_mesh); }
+        }
+        SetupDequantization();
+
+        auto decodeTime = std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - decodeStart);
+        HGINFO("Decoded %zu primitives (%zu vertices, %zu + %zu 16 bit indices) in %.2f ms on %u worker threads", loaderInfo.primitiveJobs.size(),
+               vertexCount, indexCount, shortIndexCount, decodeTime.count(), Systems::JobSystem::GetWorkerCount());
+
+        auto imageWaitStart = std::chrono::high_resolution_clock::now();
+        Systems::JobSystem::Wait(imageImportJobs);
+        auto imageWaitTime =
+            std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - imageWaitStart);
+        HGINFO("Imported %zu images (%u block compressed, %u from the texture cache) in %.2f ms of job time (%.2f ms building uncompressed "
+               "mips), %.2f ms of it left to wait for after the geometry",
+               gltfModel.images.size(), imageStats.compressed.load(), imageStats.cacheHits.load(),
+               static_cast<f32>(imageStats.microseconds.load()) / 1000.0f, static_cast<f32>(imageStats.mipMicroseconds.load()) / 1000.0f,
+               imageWaitTime.count());
+
+        // the texture uploads and mip generation run on the gpu while the geometry gets encoded and uploaded below
+        LoadTextures(gltfModel, textureUpload, compressedImages, imageKeys);
+        textureUpload.Submit();
         /* if(gltfModel.animations.size() > 0) { loadAnimations(gltfModel); }
         loadSkins(gltfModel); */
 
@@ -630,82 +1136,1224 @@ void Model::LoadFromFile(std::string filename, LogicalDevice* device, VkQueue tr
     else
     {
         HGERROR(error.c_str());
-        return;
+        return false;
     }
 
     // extensions = gltfModel.extensionsUsed;
 
-    size_t vertexBufferSize = vertexCount * sizeof(Vertex);
-    size_t indexBufferSize = indexCount * sizeof(n32);
-
-    HGASSERT(vertexBufferSize > 0);
-
-    Buffer vertexStaging{device,
-                         vertexBufferSize,
-                         1,
-                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                         VMA_MEMORY_USAGE_CPU_TO_GPU};
-    vertexStaging.Map();
-
-    // Create staging buffers
-    // Vertex data
-    vertexStaging.WriteToBuffer((void*)loaderInfo.vertexBuffer);
-    // Index data
-    Buffer indexStaging{};
-    if(indexBufferSize > 0)
+    HGASSERT(vertexCount > 0);
+
+    GeometryData geometry{};
+    geometry.vertices = loaderInfo.vertexBuffer;
+    geometry.vertexSize = vertexCount * sizeof(Vertex);
+    geometry.vertexStaging = loaderInfo.vertexStaging.get();
+    geometry.indices = loaderInfo.indexBuffer;
+    geometry.indexSize = indexCount * sizeof(n32);
+    geometry.indexStaging = loaderInfo.indexStaging.get();
+    geometry.shortIndices = loaderInfo.shortIndexBuffer;
+    geometry.shortIndexSize = shortIndexCount * sizeof(n16);
+    geometry.shortIndexStaging = loaderInfo.shortIndexStaging.get();
+
+    std::unique_ptr<Buffer> encodedStaging;
+    if(m_importSettings.vertexFormat != VertexFormat::FULL)
     {
-        indexStaging.Init(device, indexBufferSize, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-        indexStaging.Map();
-        indexStaging.WriteToBuffer((void*)loaderInfo.indexBuffer);
+        const size_t encodedSize = vertexCount * GetVertexStride(m_importSettings.vertexFormat);
+        encodedStaging = CreateStagingBuffer(device, encodedSize);
+        EncodeVertices(loaderInfo.vertexBuffer, vertexCount, GetStagingData<n8>(encodedStaging));
+        HGINFO("Packed %zu vertices from %.2f MB to %.2f MB", vertexCount, static_cast<f64>(geometry.vertexSize) / (1024.0 * 1024.0),
+               static_cast<f64>(encodedSize) / (1024.0 * 1024.0));
+        geometry.vertices = GetStagingData<n8>(encodedStaging);
+        geometry.vertexSize = encodedSize;
+        geometry.vertexStaging = encodedStaging.get();
+
+        // the unpacked vertices were only needed to encode from
+        loaderInfo.vertexScratch.reset();
+        loaderInfo.vertexBuffer = nullptr;
     }
 
-    // Create device local buffers
-    // Vertex buffer
-    m_vertices.Init(device, vertexBufferSize, 1, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    HGINFO("Index data: %.2f MB (%.2f MB with 32 bit indices only)", static_cast<f64>(geometry.indexSize + geometry.shortIndexSize) / (1024.0 * 1024.0),
+           static_cast<f64>((indexCount + shortIndexCount) * sizeof(n32)) / (1024.0 * 1024.0));
 
-    // Index buffer
-    if(indexBufferSize > 0)
-    {
-        m_indices.Init(device, indexBufferSize, 1, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
-    }
+    // the geometry was decoded into staging memory, so the upload is only the gpu side copies
+    auto         uploadStart = std::chrono::high_resolution_clock::now();
+    const size_t stagedSize = geometry.vertexSize + geometry.indexSize + geometry.shortIndexSize;
 
-    // Copy from staging buffers
-    Buffer::CopyBuffer(*device, indexStaging, m_indices, indexBufferSize);
-    Buffer::CopyBuffer(*device, vertexStaging, m_vertices, vertexBufferSize);
+    UploadBatch geometryUpload{device};
+    CreateGeometryBuffers(geometry, geometryUpload);
+    geometryUpload.Wait();
+    textureUpload.Wait();
+    // loads sharing these textures can go on as soon as their upload is through
+    TextureRegistry::MarkReady(this);
 
-    delete[] loaderInfo.vertexBuffer;
-    delete[] loaderInfo.indexBuffer;
+    auto uploadTime = std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - uploadStart);
+    HGINFO("Uploaded %.2f MB of geometry from staging in %.2f ms", static_cast<f64>(stagedSize) / (1024.0 * 1024.0), uploadTime.count());
 
     GetSceneDimensions();
+
+    SaveToCache(filename, gltfModel, geometry);
+
+    return true;
 }
 
-void Model::DrawNode(Node* node, VkCommandBuffer commandBuffer, VkPipelineLayout& pipelineLayout)
+void Model::OptimizeGeometry(LoaderInfo& loaderInfo)
 {
-    UpdateUBO(node, node->GetMatrix());
-    UpdateShaderMaterialBuffer(node);
+    auto start = std::chrono::high_resolution_clock::now();
 
-    if(node->m_mesh)
-    {
-        for(Primitive* primitive: node->m_mesh->m_primitives)
+    const size_t                         jobCount = loaderInfo.primitiveJobs.size();
+    std::vector<Utils::VertexCacheStats> before(jobCount);
+
+    // every primitive is processed inside its own range, welding only ever shrinks it
+    Systems::JobSystem::ParallelFor(static_cast<n32>(jobCount), 1, [&](n32 begin, n32 end) {
+        for(n32 i = begin; i < end; i++)
         {
-            std::vector<VkDescriptorSet> descriptorSets{primitive->m_material.descriptorSet, m_descriptorSetMaterials};
+            const PrimitiveLoadJob& job = loaderInfo.primitiveJobs[i];
+            Primitive*              primitive = job.target;
+
+            bool triangles = job.primitive->mode == TINYGLTF_MODE_TRIANGLES || job.primitive->mode == -1;
+            if(!job.hasIndices || !triangles || primitive->m_indexCount % 3 != 0) { continue; }
 
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, static_cast<n32>(descriptorSets.size()),
-                                    descriptorSets.data(), 0, nullptr);
-            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(Model::PushConstantData), sizeof(n32),
-                               &primitive->m_material.index);
+            Vertex* vertices = loaderInfo.vertexBuffer + job.vertexStart;
+            n32*    indices = loaderInfo.indexBuffer + job.indexStart;
+            n32     vertexCount = primitive->m_vertexCount;
+            n32     indexCount = primitive->m_indexCount;
 
-            vkCmdDrawIndexed(commandBuffer, primitive->m_indexCount, 1, primitive->m_firstIndex, 0, 0);
+            before[i] = Utils::AnalyzeVertexCache(indices, indexCount, vertexCount);
+
+            vertexCount = Utils::WeldVertices(vertices, vertexCount, indices, indexCount);
+            Utils::OptimizeVertexCache(indices, indexCount, vertexCount);
+            Utils::OptimizeOverdraw(indices, indexCount, glm::value_ptr(vertices[0].position), sizeof(Vertex), vertexCount);
+            vertexCount = Utils::OptimizeVertexFetch(vertices, vertexCount, indices, indexCount);
+            primitive->m_vertexCount = vertexCount;
         }
-    }
-    for(auto& child: node->m_children) { DrawNode(child, commandBuffer, pipelineLayout); }
-}
+    });
 
-void Model::CalculateBoundingBox(Node* node, Node* parent)
+    // close the gaps welding left behind and move small primitives over to 16 bit indices
+    size_t indexPos = 0;
+    size_t shortIndexPos = 0;
+    size_t vertexPos = 0;
+    for(const PrimitiveLoadJob& job: loaderInfo.primitiveJobs)
+    {
+        Primitive* primitive = job.target;
+
+        std::memmove(loaderInfo.vertexBuffer + vertexPos, loaderInfo.vertexBuffer + job.vertexStart, primitive->m_vertexCount * sizeof(Vertex));
+        primitive->m_firstVertex = static_cast<n32>(vertexPos);
+        vertexPos += primitive->m_vertexCount;
+
+        if(primitive->m_vertexCount <= 0xFFFF)
+        {
+            primitive->m_indexType = VK_INDEX_TYPE_UINT16;
+            primitive->m_firstIndex = static_cast<n32>(shortIndexPos);
+            shortIndexPos += primitive->m_indexCount;
+        }
+        else
+        {
+            primitive->m_indexType = VK_INDEX_TYPE_UINT32;
+            primitive->m_firstIndex = static_cast<n32>(indexPos);
+            indexPos += primitive->m_indexCount;
+        }
+    }
+
+    // the repacked indices go straight into new staging memory
+    auto indexStaging = CreateStagingBuffer(m_device, indexPos * sizeof(n32));
+    auto shortIndexStaging = CreateStagingBuffer(m_device, shortIndexPos * sizeof(n16));
+    n32* indices = GetStagingData<n32>(indexStaging);
+    n16* shortIndices = GetStagingData<n16>(shortIndexStaging);
+
+    for(const PrimitiveLoadJob& job: loaderInfo.primitiveJobs)
+    {
+        const Primitive* primitive = job.target;
+        const n32*       source = loaderInfo.indexBuffer + job.indexStart;
+        if(primitive->m_indexType == VK_INDEX_TYPE_UINT16)
+        {
+            for(n32 i = 0; i < primitive->m_indexCount; i++) { shortIndices[primitive->m_firstIndex + i] = static_cast<n16>(source[i]); }
+        }
+        else { std::memcpy(indices + primitive->m_firstIndex, source, primitive->m_indexCount * sizeof(n32)); }
+    }
+
+    loaderInfo.indexStaging = std::move(indexStaging);
+    loaderInfo.shortIndexStaging = std::move(shortIndexStaging);
+    loaderInfo.indexBuffer = indices;
+    loaderInfo.shortIndexBuffer = shortIndices;
+
+    loaderInfo.cacheBefore = {};
+    for(size_t i = 0; i < jobCount; i++) { loaderInfo.cacheBefore += before[i]; }
+
+    auto time = std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start);
+    HGINFO("Optimized meshes in %.2f ms: %zu -> %zu vertices", time.count(), loaderInfo.vertexPos, vertexPos);
+
+    loaderInfo.vertexPos = vertexPos;
+    loaderInfo.indexPos = indexPos;
+    loaderInfo.shortIndexPos = shortIndexPos;
+}
+
+void Model::BuildMeshlets(LoaderInfo& loaderInfo)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const size_t                             jobCount = loaderInfo.primitiveJobs.size();
+    std::vector<std::vector<Utils::Meshlet>> meshlets(jobCount);
+    std::vector<Utils::VertexCacheStats>     after(jobCount);
+    const bool                               optimize = m_importSettings.optimizeMeshes;
+
+    Systems::JobSystem::ParallelFor(static_cast<n32>(jobCount), 1, [&](n32 begin, n32 end) {
+        std::vector<n32> scratch;
+        for(n32 i = begin; i < end; i++)
+        {
+            const PrimitiveLoadJob& job = loaderInfo.primitiveJobs[i];
+            Primitive*              primitive = job.target;
+
+            bool triangles = job.primitive->mode == TINYGLTF_MODE_TRIANGLES || job.primitive->mode == -1;
+            if(!job.hasIndices || !triangles || primitive->m_indexCount % 3 != 0) { continue; }
+
+            Vertex*    vertices = loaderInfo.vertexBuffer + primitive->m_firstVertex;
+            const f32* positions = glm::value_ptr(vertices[0].position);
+
+            // the builder works on 32 bit indices, 16 bit primitives go through a scratch copy
+            n32* indices = loaderInfo.indexBuffer + primitive->m_firstIndex;
+            if(primitive->m_indexType == VK_INDEX_TYPE_UINT16)
+            {
+                const n16* shortIndices = loaderInfo.shortIndexBuffer + primitive->m_firstIndex;
+                scratch.assign(shortIndices, shortIndices + primitive->m_indexCount);
+                indices = scratch.data();
+            }
+
+            if(!job.lodOf)
+            {
+                Utils::BuildMeshlets(indices, primitive->m_indexCount, positions, sizeof(Vertex), primitive->m_vertexCount, meshlets[i]);
+
+                // meshlets are grown by adjacency, which undoes the cache and overdraw order OptimizeGeometry picked. the meshlets follow that
+                // order, so redoing the cache order inside each of them gets it back
+                if(optimize)
+                {
+                    Utils::OptimizeMeshlets(indices, meshlets[i].data(), meshlets[i].size());
+                    Utils::OptimizeVertexFetch(vertices, primitive->m_vertexCount, indices, primitive->m_indexCount);
+                }
+            }
+            if(optimize) { after[i] = Utils::AnalyzeVertexCache(indices, primitive->m_indexCount, primitive->m_vertexCount); }
+
+            if(primitive->m_indexType == VK_INDEX_TYPE_UINT16)
+            {
+                n16* shortIndices = loaderInfo.shortIndexBuffer + primitive->m_firstIndex;
+                for(n32 j = 0; j < primitive->m_indexCount; j++) { shortIndices[j] = static_cast<n16>(scratch[j]); }
+            }
+        }
+    });
+
+    m_meshlets.clear();
+    for(size_t i = 0; i < jobCount; i++)
+    {
+        Primitive* primitive = loaderInfo.primitiveJobs[i].target;
+        primitive->m_firstMeshlet = static_cast<n32>(m_meshlets.size());
+        primitive->m_meshletCount = static_cast<n32>(meshlets[i].size());
+        m_meshlets.insert(m_meshlets.end(), meshlets[i].begin(), meshlets[i].end());
+    }
+
+    auto time = std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start);
+    HGINFO("Built %zu meshlets for %zu primitives in %.2f ms", m_meshlets.size(), jobCount, time.count());
+
+    // measured on the order that actually gets uploaded
+    if(optimize)
+    {
+        Utils::VertexCacheStats totalAfter{};
+        for(const Utils::VertexCacheStats& stats: after) { totalAfter += stats; }
+        HGINFO("Vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", loaderInfo.cacheBefore.GetACMR(), totalAfter.GetACMR(),
+               loaderInfo.cacheBefore.GetATVR(), totalAfter.GetATVR());
+    }
+}
+
+// at most this many levels below the full detail one, each one has about half the triangles of the previous
+static constexpr n32 MAX_GENERATED_LODS = 4;
+// simplification stops once the error reaches this fraction of the primitive's diagonal
+static constexpr f32 LOD_MAX_ERROR = 0.05f;
+// how much a unit change of the normal or uv counts as, also relative to the diagonal
+static constexpr f32 LOD_ATTRIBUTE_WEIGHT = 0.05f;
+
+void Model::GenerateLods(LoaderInfo& loaderInfo)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const size_t jobCount = loaderInfo.primitiveJobs.size();
+
+    struct GeneratedLods
+    {
+        std::vector<n32>          indices; // every level back to back, firstIndex is relative to this
+        std::vector<PrimitiveLod> lods;
+    };
+    std::vector<GeneratedLods> generated(jobCount);
+
+    // MSFT_lod levels replace generated ones
+    std::unordered_map<const Primitive*, std::vector<const PrimitiveLoadJob*>> authored;
+    for(const PrimitiveLoadJob& job: loaderInfo.primitiveJobs)
+    {
+        if(job.lodOf) { authored[job.lodOf].push_back(&job); }
+    }
+
+    if(m_importSettings.generateLods)
+    {
+        Systems::JobSystem::ParallelFor(static_cast<n32>(jobCount), 1, [&](n32 begin, n32 end) {
+            std::vector<n32> current, simplified;
+            for(n32 i = begin; i < end; i++)
+            {
+                const PrimitiveLoadJob& job = loaderInfo.primitiveJobs[i];
+                const Primitive*        primitive = job.target;
+
+                bool triangles = job.primitive->mode == TINYGLTF_MODE_TRIANGLES || job.primitive->mode == -1;
+                if(job.lodOf || authored.count(primitive) || !job.hasIndices || !triangles || primitive->m_indexCount % 3 != 0) { continue; }
+
+                if(primitive->m_indexType == VK_INDEX_TYPE_UINT16)
+                {
+                    const n16* indices = loaderInfo.shortIndexBuffer + primitive->m_firstIndex;
+                    current.assign(indices, indices + primitive->m_indexCount);
+                }
+                else
+                {
+                    const n32* indices = loaderInfo.indexBuffer + primitive->m_firstIndex;
+                    current.assign(indices, indices + primitive->m_indexCount);
+                }
+
+                const f32     diagonal = glm::length(primitive->m_bb.max - primitive->m_bb.min);
+                const Vertex* vertices = loaderInfo.vertexBuffer + primitive->m_firstVertex;
+
+                Utils::SimplifyVertexData vertexData{};
+                vertexData.positions = glm::value_ptr(vertices[0].position);
+                vertexData.normals = glm::value_ptr(vertices[0].normal);
+                vertexData.uvs = glm::value_ptr(vertices[0].uv0);
+                vertexData.stride = sizeof(Vertex);
+                vertexData.vertexCount = primitive->m_vertexCount;
+                vertexData.normalWeight = LOD_ATTRIBUTE_WEIGHT * diagonal;
+                vertexData.uvWeight = LOD_ATTRIBUTE_WEIGHT * diagonal;
+
+                // every level is simplified from the previous one, so their errors add up
+                f32 error = 0.0f;
+                for(n32 level = 0; level < MAX_GENERATED_LODS; level++)
+                {
+                    size_t target = current.size() / 6 * 3;
+                    if(target < 3) { break; }
+
+                    error += Utils::SimplifyMesh(current.data(), current.size(), vertexData, target, LOD_MAX_ERROR * diagonal - error, simplified);
+                    if(simplified.empty() || simplified.size() * 5 > current.size() * 4) { break; } // not worth another draw range
+
+                    Utils::OptimizeVertexCache(simplified.data(), simplified.size(), primitive->m_vertexCount);
+
+                    PrimitiveLod lod{};
+                    lod.firstIndex = static_cast<n32>(generated[i].indices.size());
+                    lod.indexCount = static_cast<n32>(simplified.size());
+                    lod.firstVertex = primitive->m_firstVertex;
+                    lod.vertexCount = primitive->m_vertexCount;
+                    lod.indexType = primitive->m_indexType;
+                    lod.error = error;
+                    generated[i].lods.push_back(lod);
+                    generated[i].indices.insert(generated[i].indices.end(), simplified.begin(), simplified.end());
+
+                    current.swap(simplified);
+                }
+            }
+        });
+    }
+
+    // append the generated levels behind the existing indices of the matching type
+    size_t extraIndices = 0, extraShortIndices = 0;
+    for(size_t i = 0; i < jobCount; i++)
+    {
+        const Primitive* primitive = loaderInfo.primitiveJobs[i].target;
+        (primitive->m_indexType == VK_INDEX_TYPE_UINT16 ? extraShortIndices : extraIndices) += generated[i].indices.size();
+    }
+
+    // only an index type that gained levels needs bigger staging, the other stays where it was decoded
+    if(extraIndices > 0)
+    {
+        auto indexStaging = CreateStagingBuffer(m_device, (loaderInfo.indexPos + extraIndices) * sizeof(n32));
+        n32* indices = GetStagingData<n32>(indexStaging);
+        if(loaderInfo.indexPos > 0) { std::memcpy(indices, loaderInfo.indexBuffer, loaderInfo.indexPos * sizeof(n32)); }
+        loaderInfo.indexStaging = std::move(indexStaging);
+        loaderInfo.indexBuffer = indices;
+    }
+    if(extraShortIndices > 0)
+    {
+        auto shortIndexStaging = CreateStagingBuffer(m_device, (loaderInfo.shortIndexPos + extraShortIndices) * sizeof(n16));
+        n16* shortIndices = GetStagingData<n16>(shortIndexStaging);
+        if(loaderInfo.shortIndexPos > 0) { std::memcpy(shortIndices, loaderInfo.shortIndexBuffer, loaderInfo.shortIndexPos * sizeof(n16)); }
+        loaderInfo.shortIndexStaging = std::move(shortIndexStaging);
+        loaderInfo.shortIndexBuffer = shortIndices;
+    }
+
+    m_lods.clear();
+    size_t authoredCount = 0;
+    for(size_t i = 0; i < jobCount; i++)
+    {
+        const PrimitiveLoadJob& job = loaderInfo.primitiveJobs[i];
+        Primitive*              primitive = job.target;
+        if(job.lodOf) { continue; }
+
+        primitive->m_firstLod = static_cast<n32>(m_lods.size());
+
+        auto levels = authored.find(primitive);
+        if(levels != authored.end())
+        {
+            for(const PrimitiveLoadJob* lodJob: levels->second)
+            {
+                const Primitive* lod = lodJob->target;
+                m_lods.push_back({lod->m_firstIndex, lodJob->hasIndices ? lod->m_indexCount : 0, lod->m_firstVertex, lod->m_vertexCount,
+                                  lod->m_indexType, 0.0f, lodJob->lodCoverage});
+            }
+            authoredCount += levels->second.size();
+        }
+
+        for(PrimitiveLod lod: generated[i].lods)
+        {
+            size_t& indexPos = lod.indexType == VK_INDEX_TYPE_UINT16 ? loaderInfo.shortIndexPos : loaderInfo.indexPos;
+            for(n32 j = 0; j < lod.indexCount; j++)
+            {
+                n32 index = generated[i].indices[lod.firstIndex + j];
+                if(lod.indexType == VK_INDEX_TYPE_UINT16) { loaderInfo.shortIndexBuffer[indexPos + j] = static_cast<n16>(index); }
+                else { loaderInfo.indexBuffer[indexPos + j] = index; }
+            }
+            lod.firstIndex = static_cast<n32>(indexPos);
+            indexPos += lod.indexCount;
+            m_lods.push_back(lod);
+        }
+
+        primitive->m_lodCount = static_cast<n32>(m_lods.size()) - primitive->m_firstLod;
+    }
+
+    // the MSFT_lod primitives only lived to get their ranges decoded
+    for(PrimitiveLoadJob& job: loaderInfo.primitiveJobs)
+    {
+        if(!job.lodOf) { continue; }
+        delete job.target;
+        job.target = nullptr;
+    }
+
+    auto time = std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start);
+    HGINFO("Generated %zu LODs (%zu from MSFT_lod) in %.2f ms, %zu extra indices", m_lods.size(), authoredCount, time.count(),
+           extraIndices + extraShortIndices);
+}
+
+static n32 EncodeOctahedral(glm::vec3 normal)
+{
+    f32 length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if(!(length > 0.0f)) { return glm::packSnorm2x16(glm::vec2(0.0f)); }
+
+    glm::vec2 encoded = glm::vec2(normal.x, normal.y) / length;
+    if(normal.z < 0.0f)
+    {
+        glm::vec2 sign = glm::vec2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+        encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+    }
+    return glm::packSnorm2x16(encoded);
+}
+
+void Model::SetupDequantization()
+{
+    if(m_importSettings.vertexFormat != VertexFormat::QUANTIZED) { return; }
+
+    for(auto node: m_linearNodes)
+    {
+        if(!node->m_mesh) { continue; }
+        Mesh* mesh = node->m_mesh;
+        mesh->SetDequantization(mesh->m_bb.min, mesh->m_bb.max - mesh->m_bb.min);
+    }
+}
+
+void Model::EncodeVertices(const Vertex* vertices, size_t vertexCount, n8* encoded)
+{
+    const n32 stride = GetVertexStride(m_importSettings.vertexFormat);
+
+    struct VertexRange
+    {
+        n32         firstVertex;
+        n32         vertexCount;
+        const Mesh* mesh;
+    };
+
+    // MSFT_lod levels bring their own vertices, they get quantized against the mesh of the primitive they belong to
+    std::vector<VertexRange> ranges;
+    for(auto node: m_linearNodes)
+    {
+        if(!node->m_mesh) { continue; }
+        for(auto primitive: node->m_mesh->m_primitives)
+        {
+            ranges.push_back({primitive->m_firstVertex, primitive->m_vertexCount, node->m_mesh});
+            for(n32 l = primitive->m_firstLod; l < primitive->m_firstLod + primitive->m_lodCount; l++)
+            {
+                if(m_lods[l].firstVertex == primitive->m_firstVertex) { continue; }
+                ranges.push_back({m_lods[l].firstVertex, m_lods[l].vertexCount, node->m_mesh});
+            }
+        }
+    }
+
+    // every range is owned by a single primitive, quantized positions are relative to the bounds of the owning mesh
+    Systems::JobSystem::ParallelFor(static_cast<n32>(ranges.size()), 1, [&](n32 begin, n32 end) {
+        for(n32 i = begin; i < end; i++)
+        {
+            const VertexRange&        range = ranges[i];
+            const Mesh::UniformBlock& block = range.mesh->m_uniformBlock;
+            const glm::vec3 offset = glm::vec3(block.dequantOffset);
+            const glm::vec3 scale = glm::vec3(block.dequantScale);
+            const glm::vec3 inverseScale = glm::vec3(scale.x > 0.0f ? 1.0f / scale.x : 0.0f, scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+                                                     scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+
+            for(n32 v = range.firstVertex; v < range.firstVertex + range.vertexCount; v++)
+            {
+                const Vertex& vertex = vertices[v];
+                n32           normal = EncodeOctahedral(vertex.normal);
+                n32           uv0 = glm::packHalf2x16(vertex.uv0);
+                n32           uv1 = glm::packHalf2x16(vertex.uv1);
+                n32           color = glm::packUnorm4x8(glm::clamp(vertex.color, 0.0f, 1.0f));
+
+                if(m_importSettings.vertexFormat == VertexFormat::COMPACT)
+                {
+                    CompactVertex packed{vertex.position, normal, uv0, uv1, color};
+                    std::memcpy(&encoded[static_cast<size_t>(v) * stride], &packed, sizeof(packed));
+                }
+                else
+                {
+                    glm::vec3       position = glm::clamp((vertex.position - offset) * inverseScale, 0.0f, 1.0f);
+                    QuantizedVertex packed{glm::packUnorm2x16(glm::vec2(position.x, position.y)), glm::packUnorm2x16(glm::vec2(position.z, 0.0f)),
+                                           normal, uv0, uv1, color};
+                    std::memcpy(&encoded[static_cast<size_t>(v) * stride], &packed, sizeof(packed));
+                }
+            }
+        }
+    });
+}
+
+static void CreateDeviceBuffer(LogicalDevice* device, Buffer& buffer, const void* data, Buffer* staged, size_t size, VkBufferUsageFlags usage,
+                               UploadBatch& upload)
+{
+    if(size == 0) { return; }
+
+    buffer.Init(device, size, 1, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    // data that already is in staging memory only needs the gpu side copy
+    if(staged) { upload.CopyBuffer(staged->GetBuffer(), 0, buffer.GetBuffer(), 0, size); }
+    else { upload.UploadToBuffer(data, size, buffer.GetBuffer()); }
+}
+
+void Model::CreateGeometryBuffers(const GeometryData& geometry, UploadBatch& upload)
+{
+    CreateDeviceBuffer(m_device, m_vertices, geometry.vertices, geometry.vertexStaging, geometry.vertexSize,
+                       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, upload);
+    CreateDeviceBuffer(m_device, m_indices, geometry.indices, geometry.indexStaging, geometry.indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, upload);
+    CreateDeviceBuffer(m_device, m_shortIndices, geometry.shortIndices, geometry.shortIndexStaging, geometry.shortIndexSize,
+                       VK_BUFFER_USAGE_INDEX_BUFFER_BIT, upload);
+
+    m_residentBytes += geometry.vertexSize + geometry.indexSize + geometry.shortIndexSize;
+}
+
+static MeshCache::BoundsRecord ToBoundsRecord(const BoundingBox& bb)
+{
+    MeshCache::BoundsRecord record{};
+    std::memcpy(record.min, glm::value_ptr(bb.min), sizeof(record.min));
+    std::memcpy(record.max, glm::value_ptr(bb.max), sizeof(record.max));
+    record.valid = bb.valid;
+    return record;
+}
+
+static BoundingBox FromBoundsRecord(const MeshCache::BoundsRecord& record)
+{
+    BoundingBox bb(glm::make_vec3(record.min), glm::make_vec3(record.max));
+    bb.valid = record.valid != 0;
+    return bb;
+}
+
+void Model::SaveToCache(const std::string& filename, const tinygltf::Model& gltfModel, const GeometryData& geometry)
+{
+    // images are referenced by their location in the source file, so only embedded .glb images can be cached
+    n64 binaryChunkOffset = 0;
+    if(!gltfModel.images.empty() && !MeshCache::FindGLBBinaryChunk(filename, binaryChunkOffset))
+    {
+        HGDEBUG("%s keeps its images outside of a .glb binary chunk, not caching it", filename.c_str());
+        return;
+    }
+
+    std::vector<MeshCache::ImageRecord> images;
+    images.reserve(gltfModel.images.size());
+    for(const tinygltf::Image& image: gltfModel.images)
+    {
+        if(image.bufferView < 0 || gltfModel.bufferViews[image.bufferView].buffer != 0 || !gltfModel.buffers[0].uri.empty())
+        {
+            HGDEBUG("%s references external images, not caching it", filename.c_str());
+            return;
+        }
+
+        const tinygltf::BufferView& view = gltfModel.bufferViews[image.bufferView];
+        images.push_back({binaryChunkOffset + view.byteOffset, view.byteLength});
+    }
+
+    std::string strings;
+    auto        addString = [&strings](const std::string& str, n32& offset, n32& length) {
+        offset = static_cast<n32>(strings.size());
+        length = static_cast<n32>(str.size());
+        strings += str;
+    };
+
+    std::vector<MeshCache::SamplerRecord> samplers;
+    samplers.reserve(m_textureSamplers.size());
+    for(const Texture::TexSamplerInfo& sampler: m_textureSamplers)
+    {
+        samplers.push_back({sampler.magFilter, sampler.minFilter, sampler.addressModeU, sampler.addressModeV, sampler.addressModeW});
+    }
+
+    std::vector<MeshCache::TextureRecord> textures;
+    textures.reserve(gltfModel.textures.size());
+    for(const tinygltf::Texture& texture: gltfModel.textures) { textures.push_back({texture.source, texture.sampler}); }
+
+    auto textureIndex = [this](const Texture* texture) -> s32 { return texture ? static_cast<s32>(texture - m_textures.data()) : -1; };
+
+    std::vector<MeshCache::MaterialRecord> materials;
+    materials.reserve(m_materials.size());
+    for(const Material& material: m_materials)
+    {
+        MeshCache::MaterialRecord record{};
+        record.alphaMode = material.alphaMode;
+        record.alphaCutoff = material.alphaCutoff;
+        record.metallicFactor = material.metallicFactor;
+        record.roughnessFactor = material.roughnessFactor;
+        std::memcpy(record.baseColorFactor, glm::value_ptr(material.baseColorFactor), sizeof(record.baseColorFactor));
+        std::memcpy(record.emissiveFactor, glm::value_ptr(material.emissiveFactor), sizeof(record.emissiveFactor));
+        record.baseColorTexture = textureIndex(material.baseColorTexture);
+        record.metallicRoughnessTexture = textureIndex(material.metallicRoughnessTexture);
+        record.normalTexture = textureIndex(material.normalTexture);
+        record.occlusionTexture = textureIndex(material.occlusionTexture);
+        record.emissiveTexture = textureIndex(material.emissiveTexture);
+        record.specularGlossinessTexture = textureIndex(material.extension.specularGlossinessTexture);
+        record.diffuseTexture = textureIndex(material.extension.diffuseTexture);
+        std::memcpy(record.diffuseFactor, glm::value_ptr(material.extension.diffuseFactor), sizeof(record.diffuseFactor));
+        std::memcpy(record.specularFactor, glm::value_ptr(material.extension.specularFactor), sizeof(record.specularFactor));
+        record.texCoordSets[0] = material.texCoordSets.baseColor;
+        record.texCoordSets[1] = material.texCoordSets.metallicRoughness;
+        record.texCoordSets[2] = material.texCoordSets.specularGlossiness;
+        record.texCoordSets[3] = material.texCoordSets.normal;
+        record.texCoordSets[4] = material.texCoordSets.occlusion;
+        record.texCoordSets[5] = material.texCoordSets.emissive;
+        record.doubleSided = material.doubleSided;
+        record.metallicRoughness = material.pbrWorkflows.metallicRoughness;
+        record.specularGlossiness = material.pbrWorkflows.specularGlossiness;
+        record.unlit = material.unlit;
+        record.index = material.index;
+        record.emissiveStrength = material.emissiveStrength;
+        addString(material.name, record.nameOffset, record.nameLength);
+        materials.push_back(record);
+    }
+
+    std::unordered_map<const Node*, s32> linearIndices;
+    for(size_t i = 0; i < m_linearNodes.size(); i++) { linearIndices[m_linearNodes[i]] = static_cast<s32>(i); }
+
+    std::vector<MeshCache::NodeRecord>      nodes;
+    std::vector<MeshCache::PrimitiveRecord> primitives;
+    nodes.reserve(m_linearNodes.size());
+    for(const Node* node: m_linearNodes)
+    {
+        MeshCache::NodeRecord record{};
+        record.parent = node->m_parent ? linearIndices.at(node->m_parent) : -1;
+        record.index = node->m_index;
+        record.firstPrimitive = -1;
+        addString(node->m_name, record.nameOffset, record.nameLength);
+        std::memcpy(record.translation, glm::value_ptr(node->m_translation), sizeof(record.translation));
+        std::memcpy(record.scale, glm::value_ptr(node->m_scale), sizeof(record.scale));
+        std::memcpy(record.rotation, glm::value_ptr(node->m_rotation), sizeof(record.rotation));
+        std::memcpy(record.matrix, glm::value_ptr(node->m_matrix), sizeof(record.matrix));
+        record.bvh = ToBoundsRecord(node->m_bvh);
+        record.aabb = ToBoundsRecord(node->m_aabb);
+
+        if(node->m_mesh)
+        {
+            record.firstPrimitive = static_cast<s32>(primitives.size());
+            record.primitiveCount = static_cast<n32>(node->m_mesh->m_primitives.size());
+            record.meshBounds = ToBoundsRecord(node->m_mesh->m_bb);
+
+            for(const Primitive* primitive: node->m_mesh->m_primitives)
+            {
+                // the default material is the only one living outside of the glTF's material list
+                s32 material = &primitive->m_material == &m_materials.back() ? -1 : primitive->m_material.index;
+                primitives.push_back({primitive->m_firstIndex, primitive->m_indexCount, primitive->m_firstVertex, primitive->m_vertexCount,
+                                      static_cast<n32>(primitive->m_indexType), material, ToBoundsRecord(primitive->m_bb),
+                                      primitive->m_firstMeshlet, primitive->m_meshletCount, primitive->m_firstLod, primitive->m_lodCount});
+            }
+        }
+
+        nodes.push_back(record);
+    }
+
+    MeshCache::Header header{};
+    header.vertexStride = GetVertexStride(m_importSettings.vertexFormat);
+    header.vertexFormat = static_cast<n32>(m_importSettings.vertexFormat);
+    header.optimized = m_importSettings.optimizeMeshes;
+    header.generatedLods = m_importSettings.generateLods;
+    std::memcpy(header.dimensionsMin, glm::value_ptr(m_dimensions.min), sizeof(header.dimensionsMin));
+    std::memcpy(header.dimensionsMax, glm::value_ptr(m_dimensions.max), sizeof(header.dimensionsMax));
+
+    MeshCache::Writer writer;
+    writer.SetSection(MeshCache::SECTION_VERTICES, geometry.vertices, geometry.vertexSize);
+    writer.SetSection(MeshCache::SECTION_INDICES, geometry.indices, geometry.indexSize);
+    writer.SetSection(MeshCache::SECTION_SHORT_INDICES, geometry.shortIndices, geometry.shortIndexSize);
+    writer.SetSection(MeshCache::SECTION_NODES, nodes);
+    writer.SetSection(MeshCache::SECTION_PRIMITIVES, primitives);
+    writer.SetSection(MeshCache::SECTION_MESHLETS, m_meshlets);
+    writer.SetSection(MeshCache::SECTION_LODS, m_lods);
+    writer.SetSection(MeshCache::SECTION_MATERIALS, materials);
+    writer.SetSection(MeshCache::SECTION_TEXTURES, textures);
+    writer.SetSection(MeshCache::SECTION_SAMPLERS, samplers);
+    writer.SetSection(MeshCache::SECTION_IMAGES, images);
+    writer.SetSection(MeshCache::SECTION_STRINGS, strings.data(), strings.size());
+    writer.Save(filename, header);
+}
+
+bool Model::LoadFromCache(const MeshCache& cache, const std::string& filename)
+{
+    const MeshCache::Header& header = cache.GetHeader();
+    const n32                vertexStride = GetVertexStride(m_importSettings.vertexFormat);
+    if(header.vertexFormat != static_cast<n32>(m_importSettings.vertexFormat) || header.vertexStride != vertexStride ||
+       header.optimized != static_cast<n32>(m_importSettings.optimizeMeshes) ||
+       header.generatedLods != static_cast<n32>(m_importSettings.generateLods))
+    {
+        HGINFO("Mesh cache of %s was baked with other import settings", filename.c_str());
+        return false;
+    }
+
+    auto sectionFits = [&cache](MeshCache::Section section, size_t recordSize) { return cache.GetSectionSize(section) % recordSize == 0; };
+    if(!sectionFits(MeshCache::SECTION_VERTICES, vertexStride) || !sectionFits(MeshCache::SECTION_INDICES, sizeof(n32)) ||
+       !sectionFits(MeshCache::SECTION_SHORT_INDICES, sizeof(n16)) ||
+       !sectionFits(MeshCache::SECTION_NODES, sizeof(MeshCache::NodeRecord)) ||
+       !sectionFits(MeshCache::SECTION_PRIMITIVES, sizeof(MeshCache::PrimitiveRecord)) ||
+       !sectionFits(MeshCache::SECTION_MESHLETS, sizeof(Utils::Meshlet)) || !sectionFits(MeshCache::SECTION_LODS, sizeof(PrimitiveLod)) ||
+       !sectionFits(MeshCache::SECTION_MATERIALS, sizeof(MeshCache::MaterialRecord)) ||
+       !sectionFits(MeshCache::SECTION_TEXTURES, sizeof(MeshCache::TextureRecord)) ||
+       !sectionFits(MeshCache::SECTION_SAMPLERS, sizeof(MeshCache::SamplerRecord)) ||
+       !sectionFits(MeshCache::SECTION_IMAGES, sizeof(MeshCache::ImageRecord)))
+    {
+        return false;
+    }
+
+    n32 nodeCount, primitiveCount, meshletCount, lodCount, materialCount, textureCount, samplerCount, imageCount, stringCount;
+    const auto* nodes = cache.GetRecords<MeshCache::NodeRecord>(MeshCache::SECTION_NODES, nodeCount);
+    const auto* primitives = cache.GetRecords<MeshCache::PrimitiveRecord>(MeshCache::SECTION_PRIMITIVES, primitiveCount);
+    const auto* meshlets = cache.GetRecords<Utils::Meshlet>(MeshCache::SECTION_MESHLETS, meshletCount);
+    const auto* lods = cache.GetRecords<PrimitiveLod>(MeshCache::SECTION_LODS, lodCount);
+    const auto* materials = cache.GetRecords<MeshCache::MaterialRecord>(MeshCache::SECTION_MATERIALS, materialCount);
+    const auto* textures = cache.GetRecords<MeshCache::TextureRecord>(MeshCache::SECTION_TEXTURES, textureCount);
+    const auto* samplers = cache.GetRecords<MeshCache::SamplerRecord>(MeshCache::SECTION_SAMPLERS, samplerCount);
+    const auto* images = cache.GetRecords<MeshCache::ImageRecord>(MeshCache::SECTION_IMAGES, imageCount);
+    const auto* strings = cache.GetRecords<char>(MeshCache::SECTION_STRINGS, stringCount);
+
+    const n64 vertexCount = cache.GetSectionSize(MeshCache::SECTION_VERTICES) / vertexStride;
+    const n64 indexCount = cache.GetSectionSize(MeshCache::SECTION_INDICES) / sizeof(n32);
+    const n64 shortIndexCount = cache.GetSectionSize(MeshCache::SECTION_SHORT_INDICES) / sizeof(n16);
+    if(vertexCount == 0 || materialCount == 0) { return false; }
+
+    // check every cross reference before creating anything, a bad cache must be able to fall back to a clean import
+    auto validString = [&](n32 offset, n32 length) { return static_cast<n64>(offset) + length <= stringCount; };
+    auto validTexture = [&](s32 texture) { return texture >= -1 && texture < static_cast<s32>(textureCount); };
+
+    for(n32 i = 0; i < textureCount; i++)
+    {
+        if(textures[i].image < 0 || textures[i].image >= static_cast<s32>(imageCount)) { return false; }
+        if(textures[i].sampler < -1 || textures[i].sampler >= static_cast<s32>(samplerCount)) { return false; }
+    }
+    for(n32 i = 0; i < materialCount; i++)
+    {
+        const MeshCache::MaterialRecord& m = materials[i];
+        if(!validString(m.nameOffset, m.nameLength) || !validTexture(m.baseColorTexture) || !validTexture(m.metallicRoughnessTexture) ||
+           !validTexture(m.normalTexture) || !validTexture(m.occlusionTexture) || !validTexture(m.emissiveTexture) ||
+           !validTexture(m.specularGlossinessTexture) || !validTexture(m.diffuseTexture))
+        {
+            return false;
+        }
+    }
+    for(n32 i = 0; i < primitiveCount; i++)
+    {
+        const MeshCache::PrimitiveRecord& p = primitives[i];
+        if(p.material < -1 || p.material >= static_cast<s32>(materialCount) - 1) { return false; }
+        if(p.indexType != VK_INDEX_TYPE_UINT16 && p.indexType != VK_INDEX_TYPE_UINT32) { return false; }
+        if(static_cast<n64>(p.firstIndex) + p.indexCount > (p.indexType == VK_INDEX_TYPE_UINT16 ? shortIndexCount : indexCount)) { return false; }
+        if(static_cast<n64>(p.firstVertex) + p.vertexCount > vertexCount) { return false; }
+        if(static_cast<n64>(p.firstMeshlet) + p.meshletCount > meshletCount) { return false; }
+        for(n32 m = p.firstMeshlet; m < p.firstMeshlet + p.meshletCount; m++)
+        {
+            if(static_cast<n64>(meshlets[m].firstIndex) + meshlets[m].indexCount > p.indexCount) { return false; }
+        }
+        if(static_cast<n64>(p.firstLod) + p.lodCount > lodCount) { return false; }
+        for(n32 l = p.firstLod; l < p.firstLod + p.lodCount; l++)
+        {
+            const PrimitiveLod& lod = lods[l];
+            if(lod.indexType != VK_INDEX_TYPE_UINT16 && lod.indexType != VK_INDEX_TYPE_UINT32) { return false; }
+            const n64           lodIndexLimit = lod.indexType == VK_INDEX_TYPE_UINT16 ? shortIndexCount : indexCount;
+            if(static_cast<n64>(lod.firstIndex) + lod.indexCount > lodIndexLimit) { return false; }
+            if(static_cast<n64>(lod.firstVertex) + lod.vertexCount > vertexCount) { return false; }
+        }
+    }
+    for(n32 i = 0; i < nodeCount; i++)
+    {
+        const MeshCache::NodeRecord& n = nodes[i];
+        if(!validString(n.nameOffset, n.nameLength)) { return false; }
+        if(n.parent != -1 && (n.parent <= static_cast<s32>(i) || n.parent >= static_cast<s32>(nodeCount))) { return false; }
+        if(n.firstPrimitive != -1 && (n.firstPrimitive < 0 || static_cast<n64>(n.firstPrimitive) + n.primitiveCount > primitiveCount)) { return false; }
+    }
+
+    // images were never copied into the cache, decode them straight out of a mapping of the source file
+    Utils::MappedFile source;
+    if(imageCount > 0 && !source.Open(filename)) { return false; }
+    for(n32 i = 0; i < imageCount; i++)
+    {
+        if(images[i].offset > source.GetSize() || images[i].size > source.GetSize() - images[i].offset) { return false; }
+    }
+
+    // Samplers and textures
+    for(n32 i = 0; i < samplerCount; i++)
+    {
+        Texture::TexSamplerInfo sampler{};
+        sampler.magFilter = static_cast<VkFilter>(samplers[i].magFilter);
+        sampler.minFilter = static_cast<VkFilter>(samplers[i].minFilter);
+        sampler.addressModeU = static_cast<VkSamplerAddressMode>(samplers[i].addressModeU);
+        sampler.addressModeV = static_cast<VkSamplerAddressMode>(samplers[i].addressModeV);
+        sampler.addressModeW = static_cast<VkSamplerAddressMode>(samplers[i].addressModeW);
+        m_textureSamplers.push_back(sampler);
+    }
+
+    // textures and geometry go up in a single submission
+    UploadBatch upload{m_device};
+
+    // materials only point at the textures, the images behind them get created once they're decoded
+    m_textures.resize(textureCount);
+
+    // Materials, the last record is the default material
+    auto textureFromIndex = [this](s32 index) -> Texture* { return index >= 0 ? &m_textures[index] : nullptr; };
+
+    m_materials.reserve(materialCount);
+    for(n32 i = 0; i < materialCount; i++)
+    {
+        const MeshCache::MaterialRecord& record = materials[i];
+
+        Material material{};
+        material.alphaMode = static_cast<Material::AlphaMode>(record.alphaMode);
+        material.alphaCutoff = record.alphaCutoff;
+        material.metallicFactor = record.metallicFactor;
+        material.roughnessFactor = record.roughnessFactor;
+        material.baseColorFactor = glm::make_vec4(record.baseColorFactor);
+        material.emissiveFactor = glm::make_vec4(record.emissiveFactor);
+        material.baseColorTexture = textureFromIndex(record.baseColorTexture);
+        material.metallicRoughnessTexture = textureFromIndex(record.metallicRoughnessTexture);
+        material.normalTexture = textureFromIndex(record.normalTexture);
+        material.occlusionTexture = textureFromIndex(record.occlusionTexture);
+        material.emissiveTexture = textureFromIndex(record.emissiveTexture);
+        material.extension.specularGlossinessTexture = textureFromIndex(record.specularGlossinessTexture);
+        material.extension.diffuseTexture = textureFromIndex(record.diffuseTexture);
+        material.extension.diffuseFactor = glm::make_vec4(record.diffuseFactor);
+        material.extension.specularFactor = glm::make_vec3(record.specularFactor);
+        material.texCoordSets.baseColor = record.texCoordSets[0];
+        material.texCoordSets.metallicRoughness = record.texCoordSets[1];
+        material.texCoordSets.specularGlossiness = record.texCoordSets[2];
+        material.texCoordSets.normal = record.texCoordSets[3];
+        material.texCoordSets.occlusion = record.texCoordSets[4];
+        material.texCoordSets.emissive = record.texCoordSets[5];
+        material.doubleSided = record.doubleSided;
+        material.pbrWorkflows.metallicRoughness = record.metallicRoughness;
+        material.pbrWorkflows.specularGlossiness = record.specularGlossiness;
+        material.unlit = record.unlit;
+        material.index = record.index;
+        material.emissiveStrength = record.emissiveStrength;
+        material.name.assign(strings + record.nameOffset, record.nameLength);
+        m_materials.push_back(material);
+
+        std::vector<Primitive*> empty{};
+        m_materialBatches.emplace(i, empty);
+    }
+
+    // images are decoded (or read from the texture cache) in parallel, now that the materials say what each one gets compressed as
+    std::vector<s32> textureImages(textureCount);
+    for(n32 i = 0; i < textureCount; i++) { textureImages[i] = textures[i].image; }
+    const bool                     compressTextures = m_importSettings.compressTextures && m_device->SupportsBCTextures();
+    const std::vector<ImageImport> imageImports =
+        GetImageImports(m_materials, m_textures.data(), textureImages, imageCount, compressTextures, m_importSettings.mipFilter);
+
+    std::vector<tinygltf::Image>        decodedImages(imageCount);
+    std::vector<Utils::CompressedImage> compressedImages(imageCount);
+    std::vector<n64>                    imageKeys(imageCount);
+    ImageImportStats                    imageStats;
+    Systems::JobSystem::ParallelFor(imageCount, 1, [&](n32 begin, n32 end) {
+        for(n32 i = begin; i < end; i++)
+        {
+            const MeshCache::ImageRecord& record = images[i];
+            ImportImage(source.GetData() + record.offset, record.size, imageImports[i], decodedImages[i], compressedImages[i], imageKeys[i],
+                        imageStats);
+        }
+    });
+    HGINFO("Imported %u images (%u block compressed, %u from the texture cache) in %.2f ms of job time (%.2f ms building uncompressed mips)",
+           imageCount, imageStats.compressed.load(), imageStats.cacheHits.load(), static_cast<f32>(imageStats.microseconds.load()) / 1000.0f,
+           static_cast<f32>(imageStats.mipMicroseconds.load()) / 1000.0f);
+
+    m_textureKeys.resize(textureCount);
+    for(n32 i = 0; i < textureCount; i++)
+    {
+        Texture::TexSamplerInfo textureSampler{VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                                               VK_SAMPLER_ADDRESS_MODE_REPEAT};
+        if(textures[i].sampler != -1) { textureSampler = m_textureSamplers[textures[i].sampler]; }
+
+        const s32 image = textures[i].image;
+        AcquireTexture(i, imageKeys[image], textureSampler, decodedImages[image], compressedImages[image], upload);
+    }
+    LogTextureMemory(m_textures, compressedImages);
+    decodedImages.clear();
+
+    // Nodes, parents are linked up afterwards since they come after their children
+    std::vector<Node*> linearNodes(nodeCount);
+    for(n32 i = 0; i < nodeCount; i++)
+    {
+        const MeshCache::NodeRecord& record = nodes[i];
+
+        Node* node = new Node{};
+        node->m_index = record.index;
+        node->m_name.assign(strings + record.nameOffset, record.nameLength);
+        node->m_matrix = glm::make_mat4x4(record.matrix);
+        node->m_translation = glm::make_vec3(record.translation);
+        node->m_scale = glm::make_vec3(record.scale);
+        node->m_rotation = glm::make_quat(record.rotation);
+        node->m_bvh = FromBoundsRecord(record.bvh);
+        node->m_aabb = FromBoundsRecord(record.aabb);
+
+        if(record.firstPrimitive >= 0)
+        {
+            Mesh* mesh = new Mesh(m_device, node->m_matrix);
+            for(n32 p = 0; p < record.primitiveCount; p++)
+            {
+                const MeshCache::PrimitiveRecord& primitiveRecord = primitives[record.firstPrimitive + p];
+
+                Material&  material = primitiveRecord.material >= 0 ? m_materials[primitiveRecord.material] : m_materials.back();
+                Primitive* primitive = new Primitive(primitiveRecord.firstIndex, primitiveRecord.indexCount, primitiveRecord.vertexCount, material);
+                primitive->m_bb = FromBoundsRecord(primitiveRecord.bounds);
+                primitive->m_firstVertex = primitiveRecord.firstVertex;
+                primitive->m_indexType = static_cast<VkIndexType>(primitiveRecord.indexType);
+                primitive->m_firstMeshlet = primitiveRecord.firstMeshlet;
+                primitive->m_meshletCount = primitiveRecord.meshletCount;
+                primitive->m_firstLod = primitiveRecord.firstLod;
+                primitive->m_lodCount = primitiveRecord.lodCount;
+                primitive->m_owner = node;
+                mesh->m_primitives.push_back(primitive);
+            }
+            mesh->m_bb = FromBoundsRecord(record.meshBounds);
+            node->m_mesh = mesh;
+        }
+
+        linearNodes[i] = node;
+    }
+
+    for(n32 i = 0; i < nodeCount; i++)
+    {
+        Node* node = linearNodes[i];
+        if(nodes[i].parent >= 0)
+        {
+            node->m_parent = linearNodes[nodes[i].parent];
+            node->m_parent->m_children.push_back(node);
+        }
+        else { m_nodes.push_back(node); }
+    }
+    m_linearNodes = std::move(linearNodes);
+
+    SetupDequantization();
+
+    for(auto node: m_linearNodes)
+    {
+        if(node->m_mesh) { node->Update(); }
+    }
+
+    GeometryData geometry{};
+    geometry.vertices = cache.GetSectionData(MeshCache::SECTION_VERTICES);
+    geometry.vertexSize = cache.GetSectionSize(MeshCache::SECTION_VERTICES);
+    geometry.indices = cache.GetSectionData(MeshCache::SECTION_INDICES);
+    geometry.indexSize = cache.GetSectionSize(MeshCache::SECTION_INDICES);
+    geometry.shortIndices = cache.GetSectionData(MeshCache::SECTION_SHORT_INDICES);
+    geometry.shortIndexSize = cache.GetSectionSize(MeshCache::SECTION_SHORT_INDICES);
+    CreateGeometryBuffers(geometry, upload);
+    upload.Wait();
+    TextureRegistry::MarkReady(this);
+
+    m_meshlets.assign(meshlets, meshlets + meshletCount);
+    m_lods.assign(lods, lods + lodCount);
+
+    m_dimensions.min = glm::make_vec3(header.dimensionsMin);
+    m_dimensions.max = glm::make_vec3(header.dimensionsMax);
+    CalculateSceneAABB();
+
+    return true;
+}
+
+void Model::BindIndexBuffer(CommandRecorder& recorder, VkIndexType indexType)
+{
+    Buffer& indexBuffer = indexType == VK_INDEX_TYPE_UINT16 ? m_shortIndices : m_indices;
+    recorder.BindIndexBuffer(indexBuffer.GetBuffer(), 0, indexType);
+}
+
+static n32 GetDrawList(VkIndexType indexType) { return indexType == VK_INDEX_TYPE_UINT16 ? 0 : 1; }
+
+void Model::DrawList::Add(VkIndexType indexType, n32 indexCount, n32 firstIndex, n32 vertexOffset, n32 drawIndex)
+{
+    const n32 list = GetDrawList(indexType);
+    HGASSERT(counts[list] < capacities[list] && "More indexed draws than Model::CreateDrawBuffers accounted for");
+    allocations[list].commands[counts[list]++] = {indexCount, 1, firstIndex, static_cast<s32>(vertexOffset), drawIndex};
+}
+
+void Model::DrawList::AddNonIndexed(n32 vertexCount, n32 firstVertex, n32 drawIndex)
+{
+    HGASSERT(counts[2] < capacities[2] && "More non indexed draws than Model::CreateDrawBuffers accounted for");
+    // laid out as a VkDrawIndirectCommand, firstInstance lands in vertexOffset and the last word is unused
+    allocations[2].commands[counts[2]++] = {vertexCount, 1, firstVertex, static_cast<s32>(drawIndex), 0};
+}
+
+void Model::DrawPrimitive(CommandRecorder& recorder, DrawList& drawList, const Primitive* primitive)
+{
+    if(!primitive->m_hasIndices)
+    {
+        drawList.AddNonIndexed(primitive->m_vertexCount, primitive->m_firstVertex, primitive->m_drawIndex);
+        return;
+    }
+
+    drawList.Add(primitive->m_indexType, primitive->m_indexCount, primitive->m_firstIndex, primitive->m_firstVertex, primitive->m_drawIndex);
+}
+
+void Model::SubmitDrawList(CommandRecorder& recorder, const DrawList& drawList, RenderStats* stats)
+{
+    // without multi draw indirect a call can only read one command, so every command gets a call of its own
+    const bool multiDraw = m_device->SupportsMultiDrawIndirect();
+
+    const VkIndexType indexTypes[] = {VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32};
+    for(n32 list = 0; list < 3; list++)
+    {
+        const n32 count = drawList.counts[list];
+        if(count == 0) { continue; }
+
+        const IndirectDrawBuffer::Allocation& allocation = drawList.allocations[list];
+        const bool                            indexed = list < 2;
+        if(indexed) { BindIndexBuffer(recorder, indexTypes[list]); }
+
+        const n32 calls = multiDraw ? 1 : count;
+        const n32 drawsPerCall = multiDraw ? count : 1;
+        for(n32 call = 0; call < calls; call++)
+        {
+            const VkDeviceSize offset = allocation.offset + static_cast<VkDeviceSize>(call) * INDIRECT_COMMAND_STRIDE;
+            if(indexed) { vkCmdDrawIndexedIndirect(recorder.GetCommandBuffer(), allocation.buffer, offset, drawsPerCall, INDIRECT_COMMAND_STRIDE); }
+            else { vkCmdDrawIndirect(recorder.GetCommandBuffer(), allocation.buffer, offset, drawsPerCall, INDIRECT_COMMAND_STRIDE); }
+        }
+
+        if(stats) { stats->indirectCalls += calls; }
+    }
+}
+
+void Model::DrawIndirectCount(CommandRecorder& recorder, VkPipelineLayout& pipelineLayout, const IndirectCountDraw& draw, RenderStats* stats)
+{
+    const VkDescriptorSet descriptorSets[] = {m_descriptorSetMaterials, m_descriptorSetDraws};
+    recorder.BindDescriptorSets(pipelineLayout, 3, 2, descriptorSets);
+
+    const VkIndexType indexTypes[] = {VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32};
+    for(n32 list = 0; list < 2; list++)
+    {
+        if(m_maxIndirectDraws[list] == 0) { continue; }
+
+        BindIndexBuffer(recorder, indexTypes[list]);
+        vkCmdDrawIndexedIndirectCount(recorder.GetCommandBuffer(), draw.commands, draw.commandOffsets[list], draw.counts, draw.countOffsets[list],
+                                      draw.maxDraws, INDIRECT_COMMAND_STRIDE);
+        if(stats) { stats->indirectCalls++; }
+    }
+
+    if(m_maxIndirectDraws[2] > 0)
+    {
+        vkCmdDrawIndirectCount(recorder.GetCommandBuffer(), draw.commands, draw.commandOffsets[2], draw.counts, draw.countOffsets[2], draw.maxDraws,
+                               INDIRECT_COMMAND_STRIDE);
+        if(stats) { stats->indirectCalls++; }
+    }
+}
+
+const PrimitiveLod* Model::SelectLod(const Primitive* primitive, glm::vec3 center, f32 radius, f32 scale, const DrawCullInfo& cullInfo) const
+{
+    if(primitive->m_lodCount == 0 || cullInfo.pixelsPerUnit <= 0.0f) { return nullptr; }
+
+    const f32 distance = glm::length(center - cullInfo.cameraPosition) - radius;
+    if(distance <= 0.0f) { return nullptr; }
+
+    // pixels a world unit covers at the primitive's closest point
+    const f32 pixels = cullInfo.pixelsPerUnit / distance;
+
+    // coarsest level that is still good enough
+    for(n32 l = primitive->m_firstLod + primitive->m_lodCount; l-- > primitive->m_firstLod;)
+    {
+        const PrimitiveLod& lod = m_lods[l];
+        bool                acceptable = lod.coverage > 0.0f ? 2.0f * radius * pixels < lod.coverage * cullInfo.viewportHeight
+                                                             : lod.error * scale * pixels <= cullInfo.lodErrorPixels;
+        if(acceptable) { return &lod; }
+    }
+    return nullptr;
+}
+
+static bool IsSphereOutsideFrustum(const std::array<Plane, 6>& planes, glm::vec3 center, f32 radius)
+{
+    for(const Plane& plane: planes)
+    {
+        if(glm::dot(plane.normal, center) + plane.distance < -radius) { return true; }
+    }
+    return false;
+}
+
+static bool IsAABBOutsideFrustum(const std::array<Plane, 6>& planes, glm::vec3 min, glm::vec3 max)
+{
+    // the box is outside once the corner furthest along a plane's normal is behind it
+    for(const Plane& plane: planes)
+    {
+        const glm::vec3 corner = glm::mix(min, max, glm::greaterThanEqual(plane.normal, glm::vec3(0.0f)));
+        if(glm::dot(plane.normal, corner) + plane.distance < 0.0f) { return true; }
+    }
+    return false;
+}
+
+void Model::UpdateWorldBounds(WorldBounds& bounds, const glm::mat4& modelMatrix) const
+{
+    if(bounds.model == this && bounds.modelMatrix == modelMatrix && bounds.transformGeneration == m_transformGeneration) { return; }
+
+    bounds.model = this;
+    bounds.modelMatrix = modelMatrix;
+    bounds.transformGeneration = m_transformGeneration;
+    bounds.meshes.assign(m_meshCount, {});
+    bounds.primitives.assign(m_drawCount, glm::vec4(0.0f, 0.0f, 0.0f, -1.0f));
+    bounds.meshVisible.assign(m_meshCount, 1);
+
+    for(Node* node: m_linearNodes)
+    {
+        Mesh* mesh = node->m_mesh;
+        if(!mesh) { continue; }
+
+        // spheres are culled in world space, scaled by the largest axis of the transform
+        WorldBounds::MeshBounds& meshBounds = bounds.meshes[mesh->m_meshIndex];
+        meshBounds.transform = modelMatrix * mesh->m_uniformBlock.matrix;
+        meshBounds.inverse = glm::inverse(meshBounds.transform);
+        meshBounds.scale = std::sqrt(std::max({glm::length2(glm::vec3(meshBounds.transform[0])), glm::length2(glm::vec3(meshBounds.transform[1])),
+                                               glm::length2(glm::vec3(meshBounds.transform[2]))}));
+        if(mesh->m_bb.valid)
+        {
+            meshBounds.box = mesh->m_bb.GetAABB(meshBounds.transform);
+            meshBounds.box.valid = true;
+        }
+
+        for(const Primitive* primitive: mesh->m_primitives)
+        {
+            if(!primitive->m_bb.valid) { continue; }
+
+            const glm::vec3 center = glm::vec3(meshBounds.transform * glm::vec4((primitive->m_bb.min + primitive->m_bb.max) * 0.5f, 1.0f));
+            const f32       radius = glm::length(primitive->m_bb.max - primitive->m_bb.min) * 0.5f * meshBounds.scale;
+            bounds.primitives[primitive->m_drawIndex] = glm::vec4(center, radius);
+        }
+    }
+}
+
+void Model::DrawPrimitiveCulled(CommandRecorder& recorder, DrawList& drawList, const Primitive* primitive, const DrawCullInfo& cullInfo,
+                                const WorldBounds& bounds)
+{
+    RenderStats stats{};
+
+    // cones are tested in mesh space, whether a triangle faces the camera doesn't change under an affine transform
+    const WorldBounds::MeshBounds& meshBounds = bounds.meshes[primitive->m_owner->m_mesh->m_meshIndex];
+    const glm::mat4&               transform = meshBounds.transform;
+    const f32                      scale = meshBounds.scale;
+
+    const PrimitiveLod* lod = nullptr;
+    const glm::vec4     sphere = bounds.primitives[primitive->m_drawIndex];
+    if(sphere.w >= 0.0f)
+    {
+        const glm::vec3 center = glm::vec3(sphere);
+        if(IsSphereOutsideFrustum(cullInfo.frustumPlanes, center, sphere.w))
+        {
+            if(cullInfo.stats) { cullInfo.stats->primitivesCulled++; }
+            return;
+        }
+
+        lod = SelectLod(primitive, center, sphere.w, scale, cullInfo);
+    }
+
+    // reduced levels are far away and small on screen, they are drawn whole
+    if(lod)
+    {
+        if(lod->indexCount == 0) { drawList.AddNonIndexed(lod->vertexCount, lod->firstVertex, primitive->m_drawIndex); }
+        else { drawList.Add(lod->indexType, lod->indexCount, lod->firstIndex, lod->firstVertex, primitive->m_drawIndex); }
+
+        if(cullInfo.stats)
+        {
+            cullInfo.stats->drawCalls++;
+            cullInfo.stats->reducedLods++;
+            cullInfo.stats->triangles += (lod->indexCount ? lod->indexCount : lod->vertexCount) / 3;
+        }
+        return;
+    }
+
+    if(!primitive->m_hasIndices || primitive->m_meshletCount == 0)
+    {
+        DrawPrimitive(recorder, drawList, primitive);
+        if(cullInfo.stats)
+        {
+            cullInfo.stats->drawCalls++;
+            cullInfo.stats->triangles += (primitive->m_hasIndices ? primitive->m_indexCount : primitive->m_vertexCount) / 3;
+        }
+        return;
+    }
+
+    const glm::vec3 cameraPosition = glm::vec3(meshBounds.inverse * glm::vec4(cullInfo.cameraPosition, 1.0f));
+    const bool      cullBackfaces = !primitive->m_material.doubleSided;
+
+    // meshlets are stored back to back, so neighbouring survivors are drawn with a single command
+    n32  runStart = 0;
+    n32  runCount = 0;
+    auto flush = [&]() {
+        if(runCount == 0) { return; }
+        drawList.Add(primitive->m_indexType, runCount, primitive->m_firstIndex + runStart, primitive->m_firstVertex, primitive->m_drawIndex);
+        stats.drawCalls++;
+        stats.triangles += runCount / 3;
+        runCount = 0;
+    };
+
+    for(n32 m = primitive->m_firstMeshlet; m < primitive->m_firstMeshlet + primitive->m_meshletCount; m++)
+    {
+        const Utils::Meshlet& meshlet = m_meshlets[m];
+        const glm::vec3       center = glm::make_vec3(meshlet.center);
+        stats.clustersTested++;
+
+        const glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+        bool            visible = !IsSphereOutsideFrustum(cullInfo.frustumPlanes, worldCenter, meshlet.radius * scale);
+
+        // every triangle faces away if the view direction to any point of the sphere stays inside the widened normal cone
+        if(visible && cullBackfaces && meshlet.coneCutoff < 1.0f)
+        {
+            const glm::vec3 toCenter = center - cameraPosition;
+            const f32       distance = glm::length(toCenter);
+            if(glm::dot(toCenter, glm::make_vec3(meshlet.coneAxis)) >= meshlet.coneCutoff * (distance + meshlet.radius) + meshlet.radius)
+            {
+                visible = false;
+            }
+        }
+
+        if(!visible)
+        {
+            flush();
+            continue;
+        }
+
+        stats.clustersDrawn++;
+        if(runCount > 0 && runStart + runCount == meshlet.firstIndex) { runCount += meshlet.indexCount; }
+        else
+        {
+            flush();
+            runStart = meshlet.firstIndex;
+            runCount = meshlet.indexCount;
+        }
+    }
+    flush();
+
+    if(cullInfo.stats)
+    {
+        cullInfo.stats->clustersTested += stats.clustersTested;
+        cullInfo.stats->clustersDrawn += stats.clustersDrawn;
+        cullInfo.stats->drawCalls += stats.drawCalls;
+        cullInfo.stats->triangles += stats.triangles;
+    }
+}
+
+void Model::CalculateBoundingBox(Node* node, Node* parent)
 {
     BoundingBox* parentBvh = parent ? &parent->m_bvh : nullptr;
 
@@ -749,6 +2397,11 @@ void Model::GetSceneDimensions()
         }
     }
 
+    CalculateSceneAABB();
+}
+
+void Model::CalculateSceneAABB()
+{
     // Calculate scene aabb
     m_aabb = glm::scale(glm::mat4(1.0f), glm::vec3(m_dimensions.max[0] - m_dimensions.min[0], m_dimensions.max[1] - m_dimensions.min[1],
                                                    m_dimensions.max[2] - m_dimensions.min[2]));
@@ -780,109 +2433,76 @@ Node* Model::NodeFromIndex(n32 index)
     return nodeFound;
 }
 
-void Model::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout& pipelineLayout)
+void Model::Draw(CommandRecorder& recorder, IndirectDrawBuffer& indirectBuffer, VkPipelineLayout& pipelineLayout, const DrawCullInfo* cullInfo)
 {
-    const VkDeviceSize offsets[] = {0};
-    vkCmdBindIndexBuffer(commandBuffer, this->m_indices.GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    // textures are bound once per frame through the bindless set, everything else a primitive needs is looked up through its draw index.
+    // so the model binds its sets once and its draws all go out together once every primitive has been culled
+    const VkDescriptorSet descriptorSets[] = {m_descriptorSetMaterials, m_descriptorSetDraws};
+    recorder.BindDescriptorSets(pipelineLayout, 3, 2, descriptorSets);
 
-    for(auto& [id, prim]: m_materialBatches)
+    DrawList drawList{};
+    for(n32 list = 0; list < 3; list++)
     {
-        auto mat = &m_materials[id];
-
-        if(mat->descriptorSet == VK_NULL_HANDLE)
-        {
-            HGERROR("Invalid material descriptor set, did you forget to allocate it?");
-            HGERROR("Material: %d, %s", id, mat->name.c_str());
-        }
-
-        for(auto& primitive: prim)
-        {
-            std::vector<VkDescriptorSet> descriptorSets{mat->descriptorSet, m_descriptorSetMaterials};
-
-            if(primitive->m_owner->m_mesh) { descriptorSets.push_back(primitive->m_owner->m_mesh->m_uniformBuffer.descriptorSet); }
-
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, static_cast<n32>(descriptorSets.size()),
-                                    descriptorSets.data(), 0, nullptr);
-
-            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(Model::PushConstantData), sizeof(n32),
-                               &mat->index);
-
-            vkCmdDrawIndexed(commandBuffer, primitive->m_indexCount, 1, primitive->m_firstIndex, 0, 0);
-        }
+        drawList.allocations[list] = indirectBuffer.Allocate(m_maxIndirectDraws[list]);
+        drawList.capacities[list] = m_maxIndirectDraws[list];
     }
 
-    // for(auto& node: nodes) { DrawNode(node, commandBuffer, pipelineLayout); }
-}
-
-void Model::Init(DescriptorSetLayout* materialLayout, DescriptorSetLayout* nodeLayout, DescriptorSetLayout* materialBufferLayout,
-                 DescriptorPoolGrowable* imagePool, DescriptorPoolGrowable* uniformPool, DescriptorPoolGrowable* storagePool)
-{
-    if(m_initialized) { return; }
-    HGINFO("Initializing model...");
-
-    for(auto& [id, vec]: m_materialBatches)
+    WorldBounds  localBounds;
+    WorldBounds* bounds = nullptr;
+    if(cullInfo)
     {
-        auto material = &m_materials[id];
-
-        if(material->descriptorSet == VK_NULL_HANDLE)
-        {
-            material->descriptorSet = imagePool->AllocateDescriptor(materialLayout->GetDescriptorSetLayout());
-        }
-
-        std::vector<VkDescriptorImageInfo> imageDescriptors = {
-            m_emptyTexture.GetDescriptorInfo(), m_emptyTexture.GetDescriptorInfo(),
-            material->normalTexture ? material->normalTexture->GetDescriptorInfo() : m_emptyTexture.GetDescriptorInfo(),
-            material->occlusionTexture ? material->occlusionTexture->GetDescriptorInfo() : m_emptyTexture.GetDescriptorInfo(),
-            material->emissiveTexture ? material->emissiveTexture->GetDescriptorInfo() : m_emptyTexture.GetDescriptorInfo()};
-
-        // TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
+        bounds = cullInfo->bounds ? cullInfo->bounds : &localBounds;
+        UpdateWorldBounds(*bounds, cullInfo->modelMatrix);
 
-        if(material->pbrWorkflows.metallicRoughness)
+        // a node outside the frustum takes all of its primitives with it, none of them need a test of their own
+        for(n32 m = 0; m < m_meshCount; m++)
         {
-            if(material->baseColorTexture) { imageDescriptors[0] = material->baseColorTexture->GetDescriptorInfo(); }
-            if(material->metallicRoughnessTexture) { imageDescriptors[1] = material->metallicRoughnessTexture->GetDescriptorInfo(); }
+            const BoundingBox& box = bounds->meshes[m].box;
+            bounds->meshVisible[m] = !box.valid || !IsAABBOutsideFrustum(cullInfo->frustumPlanes, box.min, box.max);
         }
+    }
 
-        if(material->pbrWorkflows.specularGlossiness)
+    for(auto& [id, batch]: m_materialBatches)
+    {
+        for(Primitive* primitive: batch)
         {
-
-            if(material->extension.diffuseTexture) { imageDescriptors[0] = material->extension.diffuseTexture->GetDescriptorInfo(); }
-            if(material->extension.specularGlossinessTexture)
+            if(!cullInfo)
             {
-                imageDescriptors[1] = material->extension.specularGlossinessTexture->GetDescriptorInfo();
+                DrawPrimitive(recorder, drawList, primitive);
+                continue;
             }
-        }
-
-        std::array<VkWriteDescriptorSet, 5> writeDescriptorSets{};
-        for(size_t i = 0; i < imageDescriptors.size(); i++)
-        {
-            writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            writeDescriptorSets[i].descriptorCount = 1;
-            writeDescriptorSets[i].dstSet = material->descriptorSet;
-            writeDescriptorSets[i].dstBinding = static_cast<n32>(i);
-            writeDescriptorSets[i].pImageInfo = &imageDescriptors[i];
 
-            DescriptorWriter(*materialLayout, imagePool).WriteImage(static_cast<n32>(i), &imageDescriptors[i]).Overwrite(material->descriptorSet);
+            if(!bounds->meshVisible[primitive->m_owner->m_mesh->m_meshIndex])
+            {
+                if(cullInfo->stats) { cullInfo->stats->primitivesCulled++; }
+                continue;
+            }
+            DrawPrimitiveCulled(recorder, drawList, primitive, *cullInfo, *bounds);
         }
     }
 
-    for(auto& node: m_nodes)
-    {
-        SetupNodeDescriptorSet(node, uniformPool, nodeLayout);
-        UpdateMaterialBatches(node);
-    }
+    SubmitDrawList(recorder, drawList, cullInfo ? cullInfo->stats : nullptr);
+}
 
+void Model::Init(DescriptorSetLayout* drawDataLayout, DescriptorSetLayout* materialBufferLayout, DescriptorPoolGrowable* storagePool)
+{
+    if(m_initialized) { return; }
+    HGINFO("Initializing model...");
+
+    // runs on the render thread, everything that needs an upload has been done by Load
     if(m_descriptorSetMaterials == VK_NULL_HANDLE)
     {
         m_descriptorSetMaterials = storagePool->AllocateDescriptor(materialBufferLayout->GetDescriptorSetLayout());
     }
-
-    CreateMaterialBuffer();
+    if(m_descriptorSetDraws == VK_NULL_HANDLE) { m_descriptorSetDraws = storagePool->AllocateDescriptor(drawDataLayout->GetDescriptorSetLayout()); }
 
     auto bufInfo = m_shaderMaterialBuffer.DescriptorInfo();
     DescriptorWriter(*materialBufferLayout, storagePool).WriteBuffer(0, &bufInfo).Overwrite(m_descriptorSetMaterials);
 
+    auto meshInfo = m_meshBuffer.DescriptorInfo();
+    auto drawInfo = m_drawDataBuffer.DescriptorInfo();
+    DescriptorWriter(*drawDataLayout, storagePool).WriteBuffer(0, &meshInfo).WriteBuffer(1, &drawInfo).Overwrite(m_descriptorSetDraws);
+
     m_initialized = true;
 }
 
@@ -896,23 +2516,90 @@ void Model::UpdateMaterialBatches(Node* node)
     for(auto& c: node->m_children) { UpdateMaterialBatches(c); }
 }
 
-void Model::SetupNodeDescriptorSet(Node* node, DescriptorPoolGrowable* descriptorPool, DescriptorSetLayout* layout)
+void Model::CreateDrawBuffers(UploadBatch& upload)
 {
-    if(node->m_mesh)
+    // the mesh buffer takes over from here, node updates write into it through their mesh
+    std::vector<Mesh*> meshes;
+    for(Node* node: m_linearNodes)
     {
-        if(node->m_mesh->m_uniformBuffer.descriptorSet == VK_NULL_HANDLE)
-        {
-            node->m_mesh->m_uniformBuffer.descriptorSet = descriptorPool->AllocateDescriptor(layout->GetDescriptorSetLayout());
-        }
+        if(!node->m_mesh) { continue; }
+        node->m_mesh->m_meshIndex = static_cast<n32>(meshes.size());
+        meshes.push_back(node->m_mesh);
+    }
+    m_meshCount = static_cast<n32>(meshes.size());
 
-        auto bufInfo = node->m_mesh->m_uniformBuffer.uniformBuffer.DescriptorInfo();
-        DescriptorWriter(*layout, descriptorPool).WriteBuffer(0, &bufInfo).Overwrite(node->m_mesh->m_uniformBuffer.descriptorSet);
+    m_meshBuffer.Init(m_device, sizeof(Mesh::UniformBlock), std::max<n32>(static_cast<n32>(meshes.size()), 1),
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    m_meshBuffer.Map();
+    for(Mesh* mesh: meshes)
+    {
+        mesh->m_meshBuffer = &m_meshBuffer;
+        mesh->m_transformGeneration = &m_transformGeneration;
+        mesh->WriteUniformBlock();
     }
 
-    for(auto& c: node->m_children) { SetupNodeDescriptorSet(c, descriptorPool, layout); }
+    std::vector<DrawData>     drawData;
+    std::vector<GpuPrimitive> gpuPrimitives;
+    std::vector<GpuLod>       gpuLods;
+    m_maxIndirectDraws[0] = m_maxIndirectDraws[1] = m_maxIndirectDraws[2] = 0;
+    for(auto& [id, batch]: m_materialBatches)
+    {
+        for(Primitive* primitive: batch)
+        {
+            primitive->m_drawIndex = static_cast<n32>(drawData.size());
+            drawData.push_back({primitive->m_owner->m_mesh->m_meshIndex, static_cast<n32>(primitive->m_material.index)});
+
+            GpuPrimitive gpuPrimitive{};
+            gpuPrimitive.sphere = glm::vec4((primitive->m_bb.min + primitive->m_bb.max) * 0.5f, -1.0f);
+            if(primitive->m_bb.valid) { gpuPrimitive.sphere.w = glm::length(primitive->m_bb.max - primitive->m_bb.min) * 0.5f; }
+            gpuPrimitive.meshIndex = primitive->m_owner->m_mesh->m_meshIndex;
+            gpuPrimitive.list = primitive->m_hasIndices ? GetDrawList(primitive->m_indexType) : 2;
+            gpuPrimitive.count = primitive->m_hasIndices ? primitive->m_indexCount : primitive->m_vertexCount;
+            gpuPrimitive.first = primitive->m_hasIndices ? primitive->m_firstIndex : primitive->m_firstVertex;
+            gpuPrimitive.vertexOffset = static_cast<s32>(primitive->m_firstVertex);
+            gpuPrimitive.firstLod = static_cast<n32>(gpuLods.size());
+            gpuPrimitive.lodCount = primitive->m_lodCount;
+            gpuPrimitives.push_back(gpuPrimitive);
+
+            // a primitive writes at most one command per meshlet, or one for a reduced level of detail which has an index type of its own
+            if(primitive->m_hasIndices) { m_maxIndirectDraws[GetDrawList(primitive->m_indexType)] += std::max<n32>(primitive->m_meshletCount, 1); }
+            else { m_maxIndirectDraws[2]++; }
+
+            bool lodLists[3]{};
+            for(n32 l = primitive->m_firstLod; l < primitive->m_firstLod + primitive->m_lodCount; l++)
+            {
+                const PrimitiveLod& lod = m_lods[l];
+                lodLists[lod.indexCount > 0 ? GetDrawList(lod.indexType) : 2] = true;
+
+                GpuLod gpuLod{};
+                gpuLod.list = lod.indexCount > 0 ? GetDrawList(lod.indexType) : 2;
+                gpuLod.count = lod.indexCount > 0 ? lod.indexCount : lod.vertexCount;
+                gpuLod.first = lod.indexCount > 0 ? lod.firstIndex : lod.firstVertex;
+                gpuLod.vertexOffset = static_cast<s32>(lod.firstVertex);
+                gpuLod.error = lod.error;
+                gpuLod.coverage = lod.coverage;
+                gpuLods.push_back(gpuLod);
+            }
+            for(n32 list = 0; list < 3; list++) { m_maxIndirectDraws[list] += lodLists[list] ? 1 : 0; }
+        }
+    }
+    m_drawCount = static_cast<n32>(drawData.size());
+
+    // empty storage buffers can't be bound
+    if(drawData.empty()) { drawData.push_back({}); }
+    if(gpuPrimitives.empty()) { gpuPrimitives.push_back({}); }
+    if(gpuLods.empty()) { gpuLods.push_back({}); }
+
+    CreateDeviceBuffer(m_device, m_drawDataBuffer, drawData.data(), nullptr, drawData.size() * sizeof(DrawData),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, upload);
+    CreateDeviceBuffer(m_device, m_gpuPrimitiveBuffer, gpuPrimitives.data(), nullptr, gpuPrimitives.size() * sizeof(GpuPrimitive),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, upload);
+    CreateDeviceBuffer(m_device, m_gpuLodBuffer, gpuLods.data(), nullptr, gpuLods.size() * sizeof(GpuLod),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, upload);
 }
 
-void Model::CreateMaterialBuffer()
+void Model::CreateMaterialBuffer(UploadBatch& upload)
 {
     std::vector<ShaderMaterial> shaderMaterials{};
     for(auto& material: m_materials)
@@ -932,6 +2619,9 @@ void Model::CreateMaterialBuffer()
 
         // TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
 
+        const Texture* colorTexture = nullptr;
+        const Texture* physicalDescriptorTexture = nullptr;
+
         if(material.pbrWorkflows.metallicRoughness)
         {
             // Metallic roughness workflow
@@ -942,6 +2632,8 @@ void Model::CreateMaterialBuffer()
             shaderMaterial.PhysicalDescriptorTextureSet =
                 material.metallicRoughnessTexture != nullptr ? material.texCoordSets.metallicRoughness : -1;
             shaderMaterial.colorTextureSet = material.baseColorTexture != nullptr ? material.texCoordSets.baseColor : -1;
+            colorTexture = material.baseColorTexture;
+            physicalDescriptorTexture = material.metallicRoughnessTexture;
         }
 
         if(material.pbrWorkflows.specularGlossiness)
@@ -953,25 +2645,31 @@ void Model::CreateMaterialBuffer()
             shaderMaterial.colorTextureSet = material.extension.diffuseTexture != nullptr ? material.texCoordSets.baseColor : -1;
             shaderMaterial.diffuseFactor = material.extension.diffuseFactor;
             shaderMaterial.specularFactor = glm::vec4(material.extension.specularFactor, 1.0f);
+            colorTexture = material.extension.diffuseTexture;
+            physicalDescriptorTexture = material.extension.specularGlossinessTexture;
         }
 
+        using DefaultTexture = TextureRegistry::DefaultTexture;
+        auto bindTexture = [](const Texture* texture, DefaultTexture fallback, n32& image, n32& sampler) {
+            const Texture& bound = texture ? *texture : TextureRegistry::GetDefault(fallback);
+            image = bound.GetBindlessImageIndex();
+            sampler = bound.GetBindlessSamplerIndex();
+        };
+        bindTexture(colorTexture, DefaultTexture::WHITE, shaderMaterial.colorTexture, shaderMaterial.colorSampler);
+        bindTexture(physicalDescriptorTexture, DefaultTexture::WHITE, shaderMaterial.physicalDescriptorTexture,
+                    shaderMaterial.physicalDescriptorSampler);
+        bindTexture(material.normalTexture, DefaultTexture::FLAT_NORMAL, shaderMaterial.normalTexture, shaderMaterial.normalSampler);
+        bindTexture(material.occlusionTexture, DefaultTexture::WHITE, shaderMaterial.occlusionTexture, shaderMaterial.occlusionSampler);
+        bindTexture(material.emissiveTexture, DefaultTexture::BLACK, shaderMaterial.emissiveTexture, shaderMaterial.emissiveSampler);
+
         shaderMaterials.push_back(shaderMaterial);
     }
 
-    VkDeviceSize bufferSize = shaderMaterials.size() * sizeof(ShaderMaterial);
-    Buffer       stagingBuffer{m_device,
-                         bufferSize,
-                         3,
-                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                         VMA_MEMORY_USAGE_CPU_TO_GPU};
-    stagingBuffer.Map();
-    stagingBuffer.WriteToBuffer((void*)shaderMaterials.data(), bufferSize);
-
-    m_shaderMaterialBuffer.Init(m_device, bufferSize, 3, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    // empty storage buffers can't be bound
+    if(shaderMaterials.empty()) { shaderMaterials.push_back({}); }
 
-    Buffer::CopyBuffer(*m_device, stagingBuffer, m_shaderMaterialBuffer, bufferSize);
+    CreateDeviceBuffer(m_device, m_shaderMaterialBuffer, shaderMaterials.data(), nullptr, shaderMaterials.size() * sizeof(ShaderMaterial),
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, upload);
 }
 
 } // namespace Humongous
@@ -0,0 +1,75 @@
+#include "model_cache.hpp"
+#include "logger.hpp"
+
+#include <filesystem>
+
+namespace Humongous
+{
+// the same file imported with different settings is a different model
+static std::string MakeCacheKey(const std::string& resolvedPath, float scale, const ModelImportSettings& settings)
+{
+    return resolvedPath + '|' + std::to_string(scale) + '|' + std::to_string(static_cast<n32>(settings.vertexFormat)) +
+           (settings.optimizeMeshes ? "|o" : "|-") + (settings.generateLods ? "l" : "-") +
+           (settings.compressTextures ? "c" : "-") + (settings.mipFilter == Utils::MipFilter::KAISER ? "k" : "b");
+}
+
+std::shared_ptr<Model> ModelCache::Internal_Acquire(LogicalDevice* device, const std::string& modelPath, float scale,
+                                                    const ModelImportSettings& settings)
+{
+    // different spellings of the same file share one entry
+    std::error_code ec;
+    std::string     resolvedPath = std::filesystem::weakly_canonical(modelPath, ec).string();
+    if(ec) { resolvedPath = modelPath; }
+
+    const std::string key = MakeCacheKey(resolvedPath, scale, settings);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EvictExpired();
+
+    auto it = m_entries.find(key);
+    if(it != m_entries.end())
+    {
+        if(auto model = it->second.model.lock()) { return model; }
+    }
+
+    std::shared_ptr<Model> model = Model::LoadAsync(device, resolvedPath, scale, settings);
+    m_entries[key] = Entry{resolvedPath, model};
+    return model;
+}
+
+std::vector<ModelCache::Residency> ModelCache::Internal_GetResidency()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EvictExpired();
+
+    std::vector<Residency> residency;
+    residency.reserve(m_entries.size());
+    for(auto& [key, entry]: m_entries)
+    {
+        auto model = entry.model.lock();
+        if(!model) { continue; }
+
+        // the temporary lock above is not a user
+        residency.push_back({entry.path, static_cast<n32>(model.use_count() - 1), model->IsReady() ? model->GetResidentBytes() : 0});
+    }
+
+    return residency;
+}
+
+VkDeviceSize ModelCache::Internal_GetResidentBytes()
+{
+    VkDeviceSize total = 0;
+    for(const Residency& residency: Internal_GetResidency()) { total += residency.bytes; }
+    return total;
+}
+
+void ModelCache::EvictExpired()
+{
+    for(auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if(it->second.model.expired()) { it = m_entries.erase(it); }
+        else { ++it; }
+    }
+}
+
+} // namespace Humongous
@@ -1,6 +1,7 @@
 #include "logger.hpp"
 #include "set"
 #include "string"
+#include "utility"
 #include "vector"
 #include <physical_device.hpp>
 #include <vulkan/vk_enum_string_helper.h>
@@ -96,6 +97,7 @@ bool PhysicalDevice::IsDeviceSuitable(vk::PhysicalDevice physicalDevice)
 
     bool haveAllRequiredIndices = FindQueueFamilies(physicalDevice).IsComplete();
     bool deviceHasExtensions = CheckDeviceExtensionSupport(physicalDevice);
+    bool deviceHasRequiredFeatures = CheckDeviceFeatureSupport(physicalDevice);
 
     bool swapChainAdequate = false;
     if(deviceHasExtensions)
@@ -104,13 +106,43 @@ bool PhysicalDevice::IsDeviceSuitable(vk::PhysicalDevice physicalDevice)
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
-    if(deviceHasFeatures && haveAllRequiredIndices && deviceHasExtensions && swapChainAdequate)
+    if(deviceHasFeatures && haveAllRequiredIndices && deviceHasExtensions && deviceHasRequiredFeatures && swapChainAdequate)
     {
         HGINFO("device is suitable");
         HGINFO("Device: %s", deviceProperties.properties.deviceName.data());
     }
 
-    return deviceHasFeatures && haveAllRequiredIndices && deviceHasExtensions && swapChainAdequate;
+    return deviceHasFeatures && haveAllRequiredIndices && deviceHasExtensions && deviceHasRequiredFeatures && swapChainAdequate;
+}
+
+bool PhysicalDevice::CheckDeviceFeatureSupport(vk::PhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceVulkan12Features features12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2        features{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &features12};
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    // what LogicalDevice enables unconditionally, optional features are checked there
+    const std::pair<const char*, VkBool32> requiredFeatures[] = {
+        // the bindless material texture arrays, see BindlessTextures
+        {"runtimeDescriptorArray", features12.runtimeDescriptorArray},
+        {"descriptorBindingPartiallyBound", features12.descriptorBindingPartiallyBound},
+        {"descriptorBindingSampledImageUpdateAfterBind", features12.descriptorBindingSampledImageUpdateAfterBind},
+        {"descriptorBindingUpdateUnusedWhilePending", features12.descriptorBindingUpdateUnusedWhilePending},
+        // the material index is dynamically non uniform once draws of different materials share an indirect call
+        {"shaderSampledImageArrayNonUniformIndexing", features12.shaderSampledImageArrayNonUniformIndexing},
+        // models pass each primitive's draw index in as firstInstance of their indirect commands
+        {"drawIndirectFirstInstance", features.features.drawIndirectFirstInstance},
+    };
+
+    bool supported = true;
+    for(const auto& [name, available]: requiredFeatures)
+    {
+        if(available == VK_TRUE) { continue; }
+        HGINFO("Missing feature: %s", name);
+        supported = false;
+    }
+
+    return supported;
 }
 
 bool PhysicalDevice::CheckDeviceExtensionSupport(vk::PhysicalDevice physicalDevice)
@@ -144,12 +176,21 @@ PhysicalDevice::QueueFamilyData PhysicalDevice::FindQueueFamilies(vk::PhysicalDe
     int i = 0;
     for(const auto& queueFamily: queueFamilyProperties)
     {
-        if(queueFamily.queueFamilyProperties.queueFlags & vk::QueueFlagBits::eGraphics) { indices.graphicsFamily = i; }
+        const vk::QueueFlags flags = queueFamily.queueFamilyProperties.queueFlags;
+        if(flags & vk::QueueFlagBits::eGraphics) { indices.graphicsFamily = i; }
         physicalDevice.getSurfaceSupportKHR(i, m_surface, &presentSupport);
         if(presentSupport) { indices.presentFamily = i; }
+
+        // prefer a pure copy engine over an async compute family, either one runs beside the graphics queue
+        if((flags & vk::QueueFlagBits::eTransfer) && !(flags & vk::QueueFlagBits::eGraphics))
+        {
+            bool hasCompute = static_cast<bool>(flags & vk::QueueFlagBits::eCompute);
+            if(!indices.transferFamily.has_value() || !hasCompute) { indices.transferFamily = i; }
+        }
         i++;
     }
-    HGINFO("Indices graphics: %d, present: %d", indices.graphicsFamily.value(), indices.presentFamily.value());
+    HGINFO("Indices graphics: %d, present: %d, transfer: %d", indices.graphicsFamily.value(), indices.presentFamily.value(),
+           indices.transferFamily.has_value() ? static_cast<s32>(indices.transferFamily.value()) : -1);
 
     return indices;
 }
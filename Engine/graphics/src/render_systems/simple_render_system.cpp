@@ -1,17 +1,34 @@
+#include "bindless_textures.hpp"
+#include "command_recorder.hpp"
 #include "logger.hpp"
 #include <render_systems/simple_render_system.hpp>
 
+#include <chrono>
+
 namespace Humongous
 {
 SimpleRenderSystem::SimpleRenderSystem(LogicalDevice& logicalDevice, const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts,
                                        const ShaderSet& shaderSet)
-    : m_logicalDevice{logicalDevice}, m_pipelineLayout{VK_NULL_HANDLE}
+    : m_logicalDevice{logicalDevice}, m_pipelineLayout{VK_NULL_HANDLE}, m_indirectDraws{logicalDevice}
 {
     HGINFO("Creating simple render system...");
     CreateModelDescriptorSetPool();
     CreateModelDescriptorSetLayout();
     CreatePipelineLayout(descriptorSetLayouts);
-    CreatePipeline(shaderSet);
+    CreatePipelines(shaderSet);
+
+    if(!shaderSet.cullShaderPath.empty() && m_logicalDevice.SupportsDrawIndirectCount())
+    {
+        m_gpuCuller = std::make_unique<GpuCuller>(m_logicalDevice, descriptorSetLayouts[0], shaderSet.cullShaderPath);
+    }
+    else { HGINFO("Culling on the cpu"); }
+
+#ifdef HGCULLBENCHMARK_ENABLED
+    // the batch test on its own, while loading rather than in a frame. a camera at the origin looking down +z, like Camera's
+    std::array<Plane, 6> planes;
+    Camera::ExtractFrustumPlanes(glm::perspectiveLH_ZO(glm::radians(80.0f), 16.0f / 9.0f, 0.1f, 1000.0f), planes);
+    FrustumCuller::Benchmark(planes, glm::vec3(0.0f));
+#endif
     HGINFO("Created simple render system");
 }
 
@@ -24,32 +41,22 @@ SimpleRenderSystem::~SimpleRenderSystem()
 
 void SimpleRenderSystem::CreateModelDescriptorSetPool()
 {
-    std::vector<VkDescriptorType> t1 = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER};
-    std::vector<VkDescriptorType> t2 = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER};
     std::vector<VkDescriptorType> t3 = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
 
-    m_imageSamplerPool = std::make_unique<DescriptorPoolGrowable>(m_logicalDevice, 10, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, t1);
-    m_uniformPool = std::make_unique<DescriptorPoolGrowable>(m_logicalDevice, 10, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, t2);
     m_storagePool = std::make_unique<DescriptorPoolGrowable>(m_logicalDevice, 10, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, t3);
 }
 
 void SimpleRenderSystem::CreateModelDescriptorSetLayout()
 {
-    DescriptorSetLayout::Builder nodeBuilder{m_logicalDevice};
-    nodeBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
-    m_descriptorSetLayouts.node = nodeBuilder.build();
+    // mesh blocks and per primitive draw data, see Model::DrawData
+    DescriptorSetLayout::Builder drawDataBuilder{m_logicalDevice};
+    drawDataBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
+    drawDataBuilder.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
+    m_descriptorSetLayouts.drawData = drawDataBuilder.build();
 
     DescriptorSetLayout::Builder materialBufferBuilder{m_logicalDevice};
     materialBufferBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
     m_descriptorSetLayouts.materialBuffers = materialBufferBuilder.build();
-
-    DescriptorSetLayout::Builder materialBuilder{m_logicalDevice};
-    materialBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-    materialBuilder.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-    materialBuilder.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-    materialBuilder.addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-    materialBuilder.addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-    m_descriptorSetLayouts.material = materialBuilder.build();
 }
 
 void SimpleRenderSystem::CreatePipelineLayout(const std::vector<VkDescriptorSetLayout>& layouts)
@@ -61,16 +68,12 @@ void SimpleRenderSystem::CreatePipelineLayout(const std::vector<VkDescriptorSetL
     pushConstantRange.offset = 0;
     pushConstantRange.size = sizeof(Model::PushConstantData);
 
-    VkPushConstantRange indexRange{};
-    indexRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    indexRange.offset = sizeof(Model::PushConstantData);
-    indexRange.size = sizeof(n32);
-
-    std::vector<VkPushConstantRange> ranges = {pushConstantRange, indexRange};
+    std::vector<VkPushConstantRange> ranges = {pushConstantRange};
 
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {m_descriptorSetLayouts.material->GetDescriptorSetLayout(),
+    // material textures come out of the global bindless set, the materials only carry indices into it
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {BindlessTextures::GetDescriptorSetLayout(),
                                                                m_descriptorSetLayouts.materialBuffers->GetDescriptorSetLayout(),
-                                                               m_descriptorSetLayouts.node->GetDescriptorSetLayout()};
+                                                               m_descriptorSetLayouts.drawData->GetDescriptorSetLayout()};
 
     descriptorSetLayouts.insert(descriptorSetLayouts.begin(), layouts.begin(), layouts.end());
 
@@ -89,55 +92,279 @@ void SimpleRenderSystem::CreatePipelineLayout(const std::vector<VkDescriptorSetL
     HGINFO("Created pipeline layout");
 }
 
-void SimpleRenderSystem::CreatePipeline(const ShaderSet& shaderSet)
+void SimpleRenderSystem::CreatePipelines(const ShaderSet& shaderSet)
+{
+    HGINFO("Creating pipelines...");
+    const std::string vertShaderPaths[] = {shaderSet.vertShaderPath, shaderSet.compactVertShaderPath, shaderSet.quantizedVertShaderPath};
+    const bool        culledOnGpu = !shaderSet.cullShaderPath.empty() && m_logicalDevice.SupportsDrawIndirectCount();
+
+    // GPU_CULLED in draw_data.glsl
+    const VkBool32                 gpuCulled = VK_TRUE;
+    const VkSpecializationMapEntry specializationEntry{0, 0, sizeof(VkBool32)};
+    VkSpecializationInfo           specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &specializationEntry;
+    specializationInfo.dataSize = sizeof(VkBool32);
+    specializationInfo.pData = &gpuCulled;
+
+    for(size_t format = 0; format < m_renderPipelines.size(); format++)
+    {
+        if(vertShaderPaths[format].empty()) { continue; }
+
+        RenderPipeline::PipelineConfigInfo configInfo = RenderPipeline::DefaultPipelineConfigInfo();
+        configInfo.pipelineLayout = m_pipelineLayout;
+
+        configInfo.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        configInfo.multisampleInfo.sampleShadingEnable = VK_FALSE;
+        configInfo.multisampleInfo.minSampleShading = 1.0;
+
+        configInfo.vertShaderPath = vertShaderPaths[format];
+        configInfo.fragShaderPath = shaderSet.fragShaderPath;
+
+        m_renderPipelines[format] = std::make_unique<RenderPipeline>(m_logicalDevice, configInfo);
+
+        if(!culledOnGpu) { continue; }
+        configInfo.vertSpecializationInfo = &specializationInfo;
+        m_culledPipelines[format] = std::make_unique<RenderPipeline>(m_logicalDevice, configInfo);
+    }
+    HGINFO("Created pipelines");
+}
+
+void SimpleRenderSystem::FindVisibleObjects(RenderData& renderData, const std::array<Plane, 6>& planes)
+{
+    auto cullStart = std::chrono::high_resolution_clock::now();
+    m_cullCandidates.clear();
+    if(renderData.objectTree)
+    {
+        // whole groups of objects are rejected at once, only the ones the tree can't rule out are tested on their own
+        renderData.objectTree->QueryFrustum(planes, [&](n32 id) {
+            auto it = renderData.gameObjects.find(id);
+            if(it != renderData.gameObjects.end()) { m_cullCandidates.push_back(&it->second); }
+        });
+
+        m_renderStats.objectsLoading = renderData.objectsLoading;
+    }
+    else
+    {
+        for(auto& [id, obj]: renderData.gameObjects)
+        {
+            if(!obj.model) { continue; }
+
+            // streaming models have nothing to draw until their load has finished, the object just stays invisible until then
+            if(!obj.model->IsReady())
+            {
+                if(obj.model->GetLoadState() == Model::LoadState::LOADING) { m_renderStats.objectsLoading++; }
+                continue;
+            }
+            m_cullCandidates.push_back(&obj);
+        }
+    }
+
+    // the tree only knows the fattened boxes, the exact ones are tested in one batch
+    m_frustumCuller.Clear();
+    for(n32 i = 0; i < static_cast<n32>(m_cullCandidates.size()); i++) { m_frustumCuller.Add(m_cullCandidates[i]->GetBoundingBox(), i); }
+    m_visibleCandidates.clear();
+    m_frustumCuller.Cull(planes, m_visibleCandidates);
+
+    m_renderStats.cullMs =
+        std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - cullStart).count();
+}
+
+void SimpleRenderSystem::CullObjects(RenderData& renderData)
+{
+    if(!m_gpuCuller) { return; }
+
+    auto cullStart = std::chrono::high_resolution_clock::now();
+
+    m_renderStats = {};
+    m_cullBatches.clear();
+    m_batchLookup.clear();
+    m_culledObjects.clear();
+
+    // whole objects are thrown out on the cpu first, the compute pass only culls the primitives of the ones left
+    FindVisibleObjects(renderData, renderData.cam.GetFrustumPlanes());
+
+    // the culling pass wants the object indices of a model next to each other, so the survivors are grouped by model first
+    for(n32 candidate: m_visibleCandidates)
+    {
+        GameObject& obj = *m_cullCandidates[candidate];
+        if(!m_culledPipelines[static_cast<size_t>(obj.model->GetVertexFormat())]) { continue; }
+
+        obj.model->Init(m_descriptorSetLayouts.drawData.get(), m_descriptorSetLayouts.materialBuffers.get(), m_storagePool.get());
+
+        // the matrix only goes to the gpu again once the object has moved
+        auto [slot, added] = m_objectSlots.try_emplace(obj.GetId());
+        if(added) { slot->second.object = m_gpuCuller->AddObject(); }
+        if(added || slot->second.transformVersion != obj.GetTransformVersion())
+        {
+            m_gpuCuller->WriteObject(slot->second.object, obj.transform.Mat4());
+            slot->second.transformVersion = obj.GetTransformVersion();
+        }
+
+        auto [it, inserted] = m_batchLookup.try_emplace(obj.model.get(), static_cast<n32>(m_cullBatches.size()));
+        if(inserted) { m_cullBatches.push_back({obj.model.get(), 0, 0}); }
+        m_cullBatches[it->second].instanceCount++;
+        m_culledObjects.emplace_back(slot->second.object, it->second);
+    }
+
+    n32 instanceCount = 0;
+    for(GpuCuller::Batch& batch: m_cullBatches)
+    {
+        batch.firstInstance = instanceCount;
+        instanceCount += batch.instanceCount;
+        batch.instanceCount = 0;
+    }
+
+    n32* instances = m_gpuCuller->BeginFrame(renderData.frameIndex, instanceCount);
+    for(const auto& [object, batchIndex]: m_culledObjects)
+    {
+        GpuCuller::Batch& batch = m_cullBatches[batchIndex];
+        instances[batch.firstInstance + batch.instanceCount++] = object;
+    }
+
+    GpuCuller::Settings settings{};
+    settings.pixelsPerUnit = renderData.viewportHeight * 0.5f * std::abs(renderData.cam.GetProjection()[1][1]);
+    settings.viewportHeight = renderData.viewportHeight;
+    settings.lodErrorPixels = LOD_ERROR_PIXELS;
+    settings.minPixels = MIN_OBJECT_PIXELS;
+    m_gpuCuller->Cull(renderData.commandBuffer, renderData.uboSets[0], m_cullBatches, settings);
+
+    // the shader's counters come back once the frame that culled them has finished
+    const GpuCuller::Stats& stats = m_gpuCuller->GetStats();
+    m_renderStats.gpuCulled = true;
+    m_renderStats.drawCalls = stats.primitivesVisible;
+    m_renderStats.primitivesCulled = stats.primitivesCulled;
+    m_renderStats.triangles = stats.triangles;
+    m_renderStats.reducedLods = stats.reducedLods;
+    m_objectsDrawn = stats.objectsVisible;
+
+    m_cullMs = std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - cullStart).count();
+}
+
+void SimpleRenderSystem::DrawCulledBatches(CommandRecorder& recorder)
 {
-    HGINFO("Creating pipeline...");
-    RenderPipeline::PipelineConfigInfo configInfo = RenderPipeline::DefaultPipelineConfigInfo();
-    configInfo.pipelineLayout = m_pipelineLayout;
+    // the vertex shaders find the model matrix and draw index through the record firstInstance points at
+    Model::PushConstantData data{};
+    data.drawRecordAddress = m_gpuCuller->GetRecordAddress();
+    data.objectAddress = m_gpuCuller->GetObjectAddress();
 
-    configInfo.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    configInfo.multisampleInfo.sampleShadingEnable = VK_FALSE;
-    configInfo.multisampleInfo.minSampleShading = 1.0;
+    for(n32 b = 0; b < m_cullBatches.size(); b++)
+    {
+        Model* model = m_cullBatches[b].model;
+        recorder.BindPipeline(m_culledPipelines[static_cast<size_t>(model->GetVertexFormat())]->GetPipeline());
 
-    configInfo.vertShaderPath = shaderSet.vertShaderPath;
-    configInfo.fragShaderPath = shaderSet.fragShaderPath;
+        data.vertexAddress = model->GetVertexBuffer().GetDeviceAddress();
+        recorder.PushConstants(m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Model::PushConstantData), &data);
 
-    m_renderPipeline = std::make_unique<RenderPipeline>(m_logicalDevice, configInfo);
-    HGINFO("Created pipeline");
+        model->DrawIndirectCount(recorder, m_pipelineLayout, m_gpuCuller->GetDraw(b), &m_renderStats);
+    }
 }
 
 void SimpleRenderSystem::RenderObjects(RenderData& renderData)
 {
-    m_renderPipeline->Bind(renderData.commandBuffer);
+    auto recordStart = std::chrono::high_resolution_clock::now();
 
-    vkCmdBindDescriptorSets(renderData.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, renderData.uboSets.size(),
-                            renderData.uboSets.data(), 0, nullptr);
+    m_indirectDraws.BeginFrame(renderData.frameIndex);
 
-    vkCmdBindDescriptorSets(renderData.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 1, renderData.sceneSets.size(),
-                            renderData.sceneSets.data(), 0, nullptr);
+    // other render systems record into the same command buffer, so nothing is assumed to be bound going in
+    CommandRecorder recorder{renderData.commandBuffer};
 
-    m_objectsDrawn = 0;
+    recorder.BindDescriptorSets(m_pipelineLayout, 0, static_cast<n32>(renderData.uboSets.size()), renderData.uboSets.data());
+    recorder.BindDescriptorSets(m_pipelineLayout, 1, static_cast<n32>(renderData.sceneSets.size()), renderData.sceneSets.data());
+    recorder.BindDescriptorSet(m_pipelineLayout, 2, BindlessTextures::GetDescriptorSet());
 
-    for(auto& [id, obj]: renderData.gameObjects)
+    if(m_gpuCuller)
     {
-        if(!obj.model) { continue; }
-        Model::PushConstantData data{};
-        data.model = obj.transform.Mat4();
-        data.vertexAddress = obj.model->GetVertexBuffer().GetDeviceAddress();
+        DrawCulledBatches(recorder);
 
-        vkCmdPushConstants(renderData.commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Model::PushConstantData), &data);
+        m_renderStats.bindsIssued = recorder.GetStats().bindsIssued;
+        m_renderStats.bindsSkipped = recorder.GetStats().bindsSkipped;
+        m_renderStats.recordMs = m_cullMs + std::chrono::duration<f32, std::chrono::milliseconds::period>(
+                                                std::chrono::high_resolution_clock::now() - recordStart)
+                                                .count();
+        return;
+    }
+
+    m_objectsDrawn = 0;
+    m_renderStats = {};
 
-        obj.model->Init(m_descriptorSetLayouts.material.get(), m_descriptorSetLayouts.node.get(), m_descriptorSetLayouts.materialBuffers.get(),
-                        m_imageSamplerPool.get(), m_uniformPool.get(), m_storagePool.get());
+    DrawCullInfo cullInfo{};
+    cullInfo.cameraPosition = renderData.camPos;
+    cullInfo.viewportHeight = renderData.viewportHeight;
+    cullInfo.pixelsPerUnit = renderData.viewportHeight * 0.5f * std::abs(renderData.cam.GetProjection()[1][1]);
+    cullInfo.lodErrorPixels = LOD_ERROR_PIXELS;
+    cullInfo.stats = &m_renderStats;
+    cullInfo.frustumPlanes = renderData.cam.GetFrustumPlanes();
 
-        if(!renderData.cam.IsAABBInsideFrustum(obj.GetBoundingBox().min, obj.GetBoundingBox().max)) { continue; }
-        obj.model->Draw(renderData.commandBuffer, m_pipelineLayout);
+    FindVisibleObjects(renderData, cullInfo.frustumPlanes);
 
-        m_objectsDrawn++;
+#ifdef HGCULLBENCHMARK_ENABLED
+    if(renderData.objectTree && ++m_framesRendered % CULL_BENCHMARK_INTERVAL == 0)
+    {
+        BenchmarkCulling(renderData, cullInfo.frustumPlanes, m_renderStats.cullMs);
     }
+#endif
+
+    for(n32 candidate: m_visibleCandidates) { DrawObject(*m_cullCandidates[candidate], renderData, recorder, cullInfo); }
+
+    m_renderStats.bindsIssued = recorder.GetStats().bindsIssued;
+    m_renderStats.bindsSkipped = recorder.GetStats().bindsSkipped;
+    m_renderStats.recordMs =
+        std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - recordStart).count();
 
     // Uncomment if you want to know the number of objects drawn
     // HGINFO("%d objects drawn", draws);
 }
 
+void SimpleRenderSystem::DrawObject(GameObject& obj, const RenderData& renderData, CommandRecorder& recorder, DrawCullInfo& cullInfo)
+{
+    if(!obj.model || !obj.model->IsReady()) { return; }
+
+    RenderPipeline* pipeline = m_renderPipelines[static_cast<size_t>(obj.model->GetVertexFormat())].get();
+    if(!pipeline) { return; }
+
+    obj.model->Init(m_descriptorSetLayouts.drawData.get(), m_descriptorSetLayouts.materialBuffers.get(), m_storagePool.get());
+
+    // projected size of the bounding sphere at its closest point
+    const BoundingBox bounds = obj.GetBoundingBox();
+    const f32         radius = glm::length(bounds.max - bounds.min) * 0.5f;
+    const f32         distance = glm::length((bounds.min + bounds.max) * 0.5f - renderData.camPos) - radius;
+    if(distance > 0.0f && 2.0f * radius * cullInfo.pixelsPerUnit / distance < MIN_OBJECT_PIXELS)
+    {
+        m_renderStats.objectsTooSmall++;
+        return;
+    }
+
+    // all pipelines share one layout, so switching between them keeps the bound descriptor sets
+    recorder.BindPipeline(pipeline->GetPipeline());
+
+    Model::PushConstantData data{};
+    data.model = obj.transform.Mat4();
+    data.vertexAddress = obj.model->GetVertexBuffer().GetDeviceAddress();
+    recorder.PushConstants(m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Model::PushConstantData), &data);
+
+    cullInfo.modelMatrix = data.model;
+    cullInfo.bounds = &obj.GetWorldBounds();
+    obj.model->Draw(recorder, m_indirectDraws, m_pipelineLayout, &cullInfo);
+
+    m_objectsDrawn++;
+}
+
+void SimpleRenderSystem::BenchmarkCulling(const RenderData& renderData, const std::array<Plane, 6>& planes, f32 treeMs)
+{
+    // the same box test over every object, what culling cost before the tree
+    auto start = std::chrono::high_resolution_clock::now();
+    n32  linearVisible = 0;
+    for(auto& [id, obj]: renderData.gameObjects)
+    {
+        if(obj.model && obj.model->IsReady() && !AABBTree::IsOutsideFrustum(planes, obj.GetBoundingBox())) { linearVisible++; }
+    }
+    const f32 linearMs =
+        std::chrono::duration<f32, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+    HGINFO("Culling %u objects: tree and batch %.3fms (%u candidates, height %i), linear scan %.3fms (%u visible)",
+           static_cast<n32>(renderData.gameObjects.size()), treeMs, static_cast<n32>(m_cullCandidates.size()),
+           renderData.objectTree->GetHeight(), linearMs, linearVisible);
+}
+
 } // namespace Humongous
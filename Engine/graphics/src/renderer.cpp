@@ -50,7 +50,7 @@ void Renderer::RecreateSwapChain()
 
         // if(m_window.ShouldWindowClose()) { return; }
     }
-    m_logicalDevice.GetVkDevice().waitIdle();
+    m_logicalDevice.WaitIdle();
 
     if(m_swapChain == nullptr) { m_swapChain = std::make_unique<SwapChain>(m_window, m_physicalDevice, m_logicalDevice); }
     else
@@ -266,6 +266,9 @@ void Renderer::EndFrame()
     submit.signalSemaphoreInfoCount = 1;
     submit.pSignalSemaphoreInfos = &signalInfo;
 
+    // model uploads from loader threads share this queue
+    std::unique_lock<std::mutex> queueLock(m_logicalDevice.GetQueueMutex());
+
     if(m_logicalDevice.GetGraphicsQueue().submit2(1, &submit, GetCurrentFrame().inFlightFence) != vk::Result::eSuccess)
     {
         HGERROR("Failed to submit command buffer");
@@ -282,6 +285,8 @@ void Renderer::EndFrame()
     presentInfo.pImageIndices = &m_currentImageIndex;
 
     auto result = m_logicalDevice.GetPresentQueue().presentKHR(&presentInfo);
+    queueLock.unlock();
+
     if(result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR || m_window.WasWindowResized())
     {
         m_window.ResetWindowResizedFlag();
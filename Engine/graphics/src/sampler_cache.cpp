@@ -0,0 +1,49 @@
+#include "sampler_cache.hpp"
+#include "asserts.hpp"
+#include "hash.hpp"
+#include "logger.hpp"
+
+namespace Humongous
+{
+static_assert(sizeof(VkSamplerCreateFlags) == 4 && sizeof(VkFilter) == 4 && sizeof(VkBool32) == 4, "sampler keys are hashed as raw bytes");
+
+size_t SamplerCache::KeyHash::operator()(const Key& key) const { return static_cast<size_t>(Utils::HashBytes(&key, sizeof(Key))); }
+
+void SamplerCache::Internal_Init(LogicalDevice* device) { m_device = device; }
+
+void SamplerCache::Internal_Shutdown()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    HGINFO("Destroying %zu shared samplers", m_samplers.size());
+    for(auto& [key, sampler]: m_samplers) { vkDestroySampler(m_device->GetVkDevice(), sampler, nullptr); }
+    m_samplers.clear();
+}
+
+VkSampler SamplerCache::Internal_GetSampler(const VkSamplerCreateInfo& createInfo)
+{
+    HGASSERT(m_device && "SamplerCache::Init has to be called before samplers are requested");
+    HGASSERT(createInfo.pNext == nullptr && "Sampler create infos with a pNext chain can't be cached");
+
+    const Key key{createInfo.flags, createInfo.magFilter, createInfo.minFilter, createInfo.mipmapMode, createInfo.addressModeU,
+                  createInfo.addressModeV, createInfo.addressModeW, createInfo.mipLodBias, createInfo.anisotropyEnable, createInfo.maxAnisotropy,
+                  createInfo.compareEnable, createInfo.compareOp, createInfo.minLod, createInfo.maxLod, createInfo.borderColor,
+                  createInfo.unnormalizedCoordinates};
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_samplers.find(key);
+    if(it != m_samplers.end()) { return it->second; }
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    if(vkCreateSampler(m_device->GetVkDevice(), &createInfo, nullptr, &sampler) != VK_SUCCESS)
+    {
+        HGERROR("Failed to create sampler");
+        return VK_NULL_HANDLE;
+    }
+
+    m_samplers.emplace(key, sampler);
+    return sampler;
+}
+
+} // namespace Humongous
@@ -36,7 +36,8 @@ void Node::Update()
     if(m_mesh)
     {
         glm::mat4 m = GetMatrix();
-        m_mesh->m_uniformBuffer.uniformBuffer.WriteToBuffer((void*)&m, sizeof(glm::mat4));
+        m_mesh->m_uniformBlock.matrix = m; // kept on the CPU for cluster culling
+        m_mesh->WriteUniformBlock();
     }
 
     for(auto& child: m_children) { child->Update(); }
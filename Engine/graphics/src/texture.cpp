@@ -4,8 +4,14 @@
 #include "defines.hpp"
 #include "images.hpp"
 #include "logger.hpp"
+#include "mip_builder.hpp"
+#include "sampler_cache.hpp"
+#include "upload_batch.hpp"
+
+#include <cstring>
 
 #define GLM_ENABLE_EXPERIMENTAL
+#include <gli/convert.hpp>
 #include <gli/texture.hpp>
 #include <gli/texture_cube.hpp>
 #include <texture.hpp>
@@ -16,6 +22,143 @@
 
 namespace Humongous
 {
+// the Vulkan format a KTX/DDS file stores its texels in, VK_FORMAT_UNDEFINED for anything not mapped here.
+// 3 component 8 and 16 bit formats are left out on purpose, hardly any device samples them and their texel size breaks copy alignment
+static VkFormat GetVkFormat(gli::format format)
+{
+    switch(format)
+    {
+        case gli::FORMAT_R8_UNORM_PACK8:
+            return VK_FORMAT_R8_UNORM;
+        case gli::FORMAT_RG8_UNORM_PACK8:
+            return VK_FORMAT_R8G8_UNORM;
+        case gli::FORMAT_RGBA8_UNORM_PACK8:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        case gli::FORMAT_RGBA8_SRGB_PACK8:
+            return VK_FORMAT_R8G8B8A8_SRGB;
+        case gli::FORMAT_BGRA8_UNORM_PACK8:
+            return VK_FORMAT_B8G8R8A8_UNORM;
+        case gli::FORMAT_BGRA8_SRGB_PACK8:
+            return VK_FORMAT_B8G8R8A8_SRGB;
+        case gli::FORMAT_R16_SFLOAT_PACK16:
+            return VK_FORMAT_R16_SFLOAT;
+        case gli::FORMAT_RG16_SFLOAT_PACK16:
+            return VK_FORMAT_R16G16_SFLOAT;
+        case gli::FORMAT_RGBA16_SFLOAT_PACK16:
+            return VK_FORMAT_R16G16B16A16_SFLOAT;
+        case gli::FORMAT_R32_SFLOAT_PACK32:
+            return VK_FORMAT_R32_SFLOAT;
+        case gli::FORMAT_RG32_SFLOAT_PACK32:
+            return VK_FORMAT_R32G32_SFLOAT;
+        case gli::FORMAT_RGBA32_SFLOAT_PACK32:
+            return VK_FORMAT_R32G32B32A32_SFLOAT;
+        case gli::FORMAT_RG11B10_UFLOAT_PACK32:
+            return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+        case gli::FORMAT_RGB9E5_UFLOAT_PACK32:
+            return VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+        case gli::FORMAT_RGB_DXT1_UNORM_BLOCK8:
+            return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        case gli::FORMAT_RGB_DXT1_SRGB_BLOCK8:
+            return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        case gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8:
+            return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case gli::FORMAT_RGBA_DXT1_SRGB_BLOCK8:
+            return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case gli::FORMAT_RGBA_DXT3_UNORM_BLOCK16:
+            return VK_FORMAT_BC2_UNORM_BLOCK;
+        case gli::FORMAT_RGBA_DXT3_SRGB_BLOCK16:
+            return VK_FORMAT_BC2_SRGB_BLOCK;
+        case gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16:
+            return VK_FORMAT_BC3_UNORM_BLOCK;
+        case gli::FORMAT_RGBA_DXT5_SRGB_BLOCK16:
+            return VK_FORMAT_BC3_SRGB_BLOCK;
+        case gli::FORMAT_R_ATI1N_UNORM_BLOCK8:
+            return VK_FORMAT_BC4_UNORM_BLOCK;
+        case gli::FORMAT_RG_ATI2N_UNORM_BLOCK16:
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case gli::FORMAT_RGB_BP_UFLOAT_BLOCK16:
+            return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+        case gli::FORMAT_RGB_BP_SFLOAT_BLOCK16:
+            return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+        case gli::FORMAT_RGBA_BP_UNORM_BLOCK16:
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+        case gli::FORMAT_RGBA_BP_SRGB_BLOCK16:
+            return VK_FORMAT_BC7_SRGB_BLOCK;
+        case gli::FORMAT_RGB_ETC2_UNORM_BLOCK8:
+            return VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+        case gli::FORMAT_RGB_ETC2_SRGB_BLOCK8:
+            return VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK;
+        case gli::FORMAT_RGBA_ETC2_UNORM_BLOCK8:
+            return VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK;
+        case gli::FORMAT_RGBA_ETC2_SRGB_BLOCK8:
+            return VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK;
+        case gli::FORMAT_RGBA_ETC2_UNORM_BLOCK16:
+            return VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+        case gli::FORMAT_RGBA_ETC2_SRGB_BLOCK16:
+            return VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK;
+        case gli::FORMAT_R_EAC_UNORM_BLOCK8:
+            return VK_FORMAT_EAC_R11_UNORM_BLOCK;
+        case gli::FORMAT_RG_EAC_UNORM_BLOCK16:
+            return VK_FORMAT_EAC_R11G11_UNORM_BLOCK;
+        case gli::FORMAT_RGBA_ASTC_4X4_UNORM_BLOCK16:
+            return VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+        case gli::FORMAT_RGBA_ASTC_4X4_SRGB_BLOCK16:
+            return VK_FORMAT_ASTC_4x4_SRGB_BLOCK;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+static bool CanSampleFormat(LogicalDevice* device, VkFormat format)
+{
+    if(format == VK_FORMAT_UNDEFINED) { return false; }
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(device->GetPhysicalDevice().GetVkPhysicalDevice(), format, &formatProperties);
+
+    const VkFormatFeatureFlags required =
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
+// textures go up exactly as they're stored whenever the device can sample that format. otherwise BC1 to BC5 data is expanded to RGBA8
+// and uncompressed data converted to RGBA16F on the cpu, anything else can't be used on this device and returns VK_FORMAT_UNDEFINED
+template <typename T> static VkFormat PrepareForUpload(T& texture, LogicalDevice* device, const std::string& path)
+{
+    const gli::format storedFormat = texture.format();
+    const VkFormat    format = GetVkFormat(storedFormat);
+    if(CanSampleFormat(device, format)) { return format; }
+
+    if(!gli::is_compressed(storedFormat))
+    {
+        HGWARN("%s is in a format the device can't sample, converting it to RGBA16F", path.c_str());
+        texture = gli::convert(texture, gli::FORMAT_RGBA16_SFLOAT_PACK16);
+        return VK_FORMAT_R16G16B16A16_SFLOAT;
+    }
+
+    const bool           srgb = gli::is_srgb(storedFormat);
+    const gli::texture&  source = texture;
+    gli::texture         decoded(source.target(), srgb ? gli::FORMAT_RGBA8_SRGB_PACK8 : gli::FORMAT_RGBA8_UNORM_PACK8, source.extent(),
+                                 source.layers(), source.faces(), source.levels());
+    for(size_t face = 0; face < source.faces(); face++)
+    {
+        for(size_t level = 0; level < source.levels(); level++)
+        {
+            const gli::extent3d extent = source.extent(level);
+            if(!Utils::DecompressImage(format, static_cast<const n8*>(source.data(0, face, level)), extent.x, extent.y,
+                                       static_cast<n8*>(decoded.data(0, face, level))))
+            {
+                HGERROR("%s is block compressed in a format the device can't sample and the engine can't decode", path.c_str());
+                return VK_FORMAT_UNDEFINED;
+            }
+        }
+    }
+
+    HGWARN("%s is block compressed in a format the device can't sample, decoded it to RGBA8", path.c_str());
+    texture = T(decoded);
+    return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
 Texture::Texture(LogicalDevice* logicalDevice, const std::string& imagePath, const ImageType& imageType) : m_logicalDevice{logicalDevice}
 {
     CreateFromFile(imagePath, logicalDevice, imageType);
@@ -23,7 +166,8 @@ Texture::Texture(LogicalDevice* logicalDevice, const std::string& imagePath, con
 
 void Texture::Destroy()
 {
-    if(m_textureSampler) { vkDestroySampler(m_logicalDevice->GetVkDevice(), m_textureSampler, nullptr); }
+    BindlessTextures::ReleaseImage(m_bindlessImage);
+    m_bindlessImage = BindlessTextures::INVALID_INDEX;
 
     if(m_textureImage.imageView != VK_NULL_HANDLE) { vkDestroyImageView(m_logicalDevice->GetVkDevice(), m_textureImage.imageView, nullptr); }
     if(m_textureImage.image != VK_NULL_HANDLE)
@@ -32,6 +176,15 @@ void Texture::Destroy()
     }
 }
 
+VkDeviceSize Texture::GetMemorySize() const
+{
+    if(m_textureImage.image == VK_NULL_HANDLE) { return 0; }
+
+    VmaAllocationInfo allocationInfo{};
+    vmaGetAllocationInfo(m_logicalDevice->GetVmaAllocator(), m_textureImage.allocation, &allocationInfo);
+    return allocationInfo.size;
+}
+
 void Texture::CreateFromFile(const std::string& path, LogicalDevice* device, const ImageType& imageType)
 {
     this->m_logicalDevice = device;
@@ -39,54 +192,65 @@ void Texture::CreateFromFile(const std::string& path, LogicalDevice* device, con
     CreateTextureImage(path, imageType);
 }
 
-void Texture::CreateFromGLTFImage(tinygltf::Image& gltfimage, TexSamplerInfo textureSampler, LogicalDevice* device, VkQueue copyQueue)
+void Texture::CreateFromGLTFImage(tinygltf::Image& gltfimage, TexSamplerInfo textureSampler, LogicalDevice* device, UploadBatch* batch)
 {
     m_logicalDevice = device;
 
-    unsigned char* buffer = nullptr;
-    VkDeviceSize   bufferSize = 0;
-    bool           deleteBuffer = false;
-    if(gltfimage.component == 3)
-    {
-        // Most devices don't support RGB only on Vulkan so convert if necessary
-        // TODO: Check actual format support and transform only if required
-        bufferSize = gltfimage.width * gltfimage.height * 4;
-        buffer = new unsigned char[bufferSize];
-        unsigned char* rgba = buffer;
-        unsigned char* rgb = &gltfimage.image[0];
-        for(s32 i = 0; i < gltfimage.width * gltfimage.height; ++i)
-        {
-            for(s32 j = 0; j < 3; ++j) { rgba[j] = rgb[j]; }
-            rgba += 4;
-            rgb += 3;
-        }
-        deleteBuffer = true;
-    }
-    else
-    {
-        buffer = &gltfimage.image[0];
-        bufferSize = gltfimage.image.size();
-    }
+    const n32 width = gltfimage.width, height = gltfimage.height;
+    HGASSERT(gltfimage.image.size() == Utils::GetMipChainSize(width, height) && "glTF images are expected to hold their whole mip chain");
 
-    VkFormat           format = VK_FORMAT_R8G8B8A8_UNORM;
-    VkFormatProperties formatProperties;
+    std::vector<VkDeviceSize> levelOffsets;
+    for(n32 i = 0; i < Utils::GetMipLevelCount(width, height); i++) { levelOffsets.push_back(Utils::GetMipLevelOffset(width, height, i)); }
 
-    m_width = gltfimage.width;
-    m_height = gltfimage.height;
-    m_miplevels = static_cast<n32>(floor(log2(std::max(m_width, m_height))) + 1.0);
+    CreateFromLevels(VK_FORMAT_R8G8B8A8_UNORM, width, height, gltfimage.image.data(), gltfimage.image.size(), levelOffsets, textureSampler,
+                     batch);
+}
 
-    vkGetPhysicalDeviceFormatProperties(m_logicalDevice->GetPhysicalDevice().GetVkPhysicalDevice(), format, &formatProperties);
-    HGASSERT(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-    HGASSERT(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+void Texture::CreateFromCompressedImage(const Utils::CompressedImage& image, TexSamplerInfo textureSampler, LogicalDevice* device,
+                                        UploadBatch* batch)
+{
+    m_logicalDevice = device;
 
-    Buffer stagingBuffer{m_logicalDevice,
-                         bufferSize,
-                         1,
-                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                         VMA_MEMORY_USAGE_CPU_TO_GPU};
-    stagingBuffer.Map();
-    stagingBuffer.WriteToBuffer((void*)buffer, bufferSize);
+    CreateFromLevels(image.format, image.width, image.height, image.data.data(), image.data.size(), image.levelOffsets, textureSampler, batch);
+}
+
+void Texture::CreateFromColor(const n8 rgba[4], LogicalDevice* device)
+{
+    m_logicalDevice = device;
+
+    TexSamplerInfo textureSampler{VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                                  VK_SAMPLER_ADDRESS_MODE_REPEAT};
+    CreateFromLevels(VK_FORMAT_R8G8B8A8_UNORM, 1, 1, rgba, 4, {0}, textureSampler, nullptr);
+}
+
+void Texture::CreateFromLevels(VkFormat format, n32 width, n32 height, const n8* data, VkDeviceSize size,
+                               const std::vector<VkDeviceSize>& levelOffsets, TexSamplerInfo textureSampler, UploadBatch* batch)
+{
+    UploadBatch  localBatch{m_logicalDevice};
+    UploadBatch& upload = batch ? *batch : localBatch;
+
+    m_width = width;
+    m_height = height;
+    m_miplevels = static_cast<n32>(levelOffsets.size());
+
+    UploadBatch::StagingAllocation staging = upload.AllocateStaging(size);
+    std::memcpy(staging.data, data, size);
+
+    std::vector<VkBufferImageCopy> bufferCopyRegions;
+    for(n32 i = 0; i < m_miplevels; i++)
+    {
+        VkBufferImageCopy bufferCopyRegion{};
+        bufferCopyRegion.bufferOffset = staging.offset + levelOffsets[i];
+        bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        bufferCopyRegion.imageSubresource.mipLevel = i;
+        bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+        bufferCopyRegion.imageSubresource.layerCount = 1;
+        bufferCopyRegion.imageExtent.width = std::max(m_width >> i, 1u);
+        bufferCopyRegion.imageExtent.height = std::max(m_height >> i, 1u);
+        bufferCopyRegion.imageExtent.depth = 1;
+
+        bufferCopyRegions.push_back(bufferCopyRegion);
+    }
 
     Utils::AllocatedImageCreateInfo createInfo{.logicalDevice = *m_logicalDevice, .allocatedImage = m_textureImage};
     createInfo.width = m_width;
@@ -95,7 +259,7 @@ void Texture::CreateFromGLTFImage(tinygltf::Image& gltfimage, TexSamplerInfo tex
     createInfo.layerCount = 1;
     createInfo.format = format;
     createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    createInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    createInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     createInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     createInfo.aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
     createInfo.flags = 0;
@@ -104,115 +268,11 @@ void Texture::CreateFromGLTFImage(tinygltf::Image& gltfimage, TexSamplerInfo tex
 
     Utils::CreateAllocatedImage(createInfo);
 
-    Utils::TransitionImageLayout(*m_logicalDevice, m_textureImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    m_textureImage.imageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-
-    VkBufferImageCopy bufferCopyRegion{};
-    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    bufferCopyRegion.imageSubresource.mipLevel = 0;
-    bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-    bufferCopyRegion.imageSubresource.layerCount = 1;
-    bufferCopyRegion.imageExtent.width = m_width;
-    bufferCopyRegion.imageExtent.height = m_height;
-    bufferCopyRegion.imageExtent.depth = 1;
-
-    std::vector<VkBufferImageCopy> bufferCopyRegions{bufferCopyRegion};
-
-    Utils::CopyBufferToImage(*m_logicalDevice, stagingBuffer.GetBuffer(), m_textureImage.image, bufferCopyRegions);
-
-    Utils::TransitionImageLayout(*m_logicalDevice, m_textureImage.image, m_textureImage.imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-    m_textureImage.imageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-
-    VkCommandBuffer blitCmd = m_logicalDevice->BeginSingleTimeCommands();
-
-    VkImageSubresourceRange subresourceRange = {};
-    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    subresourceRange.levelCount = 1;
-    subresourceRange.layerCount = 1;
-
-    for(n32 i = 1; i < m_miplevels; i++)
-    {
-        VkImageBlit2 imageBlit{.sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2};
-
-        imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageBlit.srcSubresource.layerCount = 1;
-        imageBlit.srcSubresource.mipLevel = i - 1;
-        imageBlit.srcOffsets[1].x = s32(m_width >> (i - 1));
-        imageBlit.srcOffsets[1].y = s32(m_height >> (i - 1));
-        imageBlit.srcOffsets[1].z = 1;
-
-        imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageBlit.dstSubresource.layerCount = 1;
-        imageBlit.dstSubresource.mipLevel = i;
-        imageBlit.dstOffsets[1].x = s32(m_width >> i);
-        imageBlit.dstOffsets[1].y = s32(m_height >> i);
-        imageBlit.dstOffsets[1].z = 1;
-
-        VkImageSubresourceRange mipSubRange = {};
-        mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        mipSubRange.baseMipLevel = i;
-        mipSubRange.levelCount = 1;
-        mipSubRange.layerCount = 1;
-
-        {
-            Utils::ImageTransitionInfo imageTransition{};
-            imageTransition.image = m_textureImage.image;
-            imageTransition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageTransition.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            imageTransition.cmd = blitCmd;
-            imageTransition.logicalDevice = m_logicalDevice;
-            imageTransition.layerCount = mipSubRange.layerCount;
-            imageTransition.levelCount = mipSubRange.levelCount;
-            imageTransition.baseMipLevel = mipSubRange.baseMipLevel;
-            imageTransition.baseArrayLayer = mipSubRange.baseArrayLayer;
-
-            Utils::TransitionImageLayout(imageTransition);
-        }
-
-        VkBlitImageInfo2 imageBlitInfo{};
-        imageBlitInfo.sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2;
-        imageBlitInfo.filter = VK_FILTER_LINEAR;
-        imageBlitInfo.dstImage = m_textureImage.image;
-        imageBlitInfo.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageBlitInfo.srcImage = m_textureImage.image;
-        imageBlitInfo.srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        imageBlitInfo.pRegions = &imageBlit;
-        imageBlitInfo.regionCount = 1;
-
-        vkCmdBlitImage2(blitCmd, &imageBlitInfo);
-
-        {
-            Utils::ImageTransitionInfo imageTransition{};
-            imageTransition.image = m_textureImage.image;
-            imageTransition.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            imageTransition.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            imageTransition.cmd = blitCmd;
-            imageTransition.logicalDevice = m_logicalDevice;
-            imageTransition.layerCount = mipSubRange.layerCount;
-            imageTransition.levelCount = mipSubRange.levelCount;
-            imageTransition.baseMipLevel = mipSubRange.baseMipLevel;
-            imageTransition.baseArrayLayer = mipSubRange.baseArrayLayer;
-
-            Utils::TransitionImageLayout(imageTransition);
-        }
-    }
-
-    subresourceRange.levelCount = m_miplevels;
-    {
-        Utils::ImageTransitionInfo info{};
-        info.image = m_textureImage.image;
-        info.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        info.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        info.baseMipLevel = subresourceRange.baseMipLevel;
-        info.levelCount = subresourceRange.levelCount;
-        info.layerCount = subresourceRange.layerCount;
-        info.cmd = blitCmd;
-        info.logicalDevice = m_logicalDevice;
-
-        Utils::TransitionImageLayout(info);
-    }
+    // every level is copied in one go, nothing is left to generate on the gpu
+    upload.UploadImage(staging.buffer, m_textureImage.image, bufferCopyRegions, m_miplevels);
+    upload.TransitionImageLayout(m_textureImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0,
+                                 m_miplevels);
     m_textureImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    m_logicalDevice->EndSingleTimeCommands(blitCmd);
 
     SamplerCreateInfo samplerCreateInfo{};
     samplerCreateInfo.minFilter = textureSampler.minFilter;
@@ -223,7 +283,9 @@ void Texture::CreateFromGLTFImage(tinygltf::Image& gltfimage, TexSamplerInfo tex
 
     CreateTextureImageSampler(samplerCreateInfo);
 
-    if(deleteBuffer) { delete[] buffer; }
+    // the image is in its final layout once the batch retires, nothing samples the slot before then
+    m_bindlessImage = BindlessTextures::RegisterImage(m_textureImage.imageView, m_textureImage.imageLayout);
+    m_bindlessSampler = BindlessTextures::GetSamplerIndex(m_textureSampler);
 }
 
 void Texture::CreateTextureImage(const std::string& imagePath, const ImageType& imageType)
@@ -235,22 +297,19 @@ void Texture::CreateTextureImage(const std::string& imagePath, const ImageType&
         gli::texture2d tex2D(gli::load(imagePath.c_str()));
 
         HGASSERT(!tex2D.empty() && "Failed to load texture image");
+        const VkFormat format = PrepareForUpload(tex2D, m_logicalDevice, imagePath);
+        HGASSERT(format != VK_FORMAT_UNDEFINED && "Texture format isn't supported on this device");
 
         m_width = static_cast<n32>(tex2D[0].extent().x);
         m_height = static_cast<n32>(tex2D[0].extent().y);
         m_miplevels = static_cast<n32>(tex2D.levels());
 
-        Buffer stagingBuffer{m_logicalDevice,
-                             tex2D.size(),
-                             1,
-                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                             VMA_MEMORY_USAGE_CPU_TO_GPU};
-        stagingBuffer.Map();
-        stagingBuffer.WriteToBuffer((void*)tex2D.data(), tex2D.size());
+        UploadBatch                    upload{m_logicalDevice};
+        UploadBatch::StagingAllocation staging = upload.AllocateStaging(tex2D.size());
+        std::memcpy(staging.data, tex2D.data(), tex2D.size());
 
         std::vector<VkBufferImageCopy> bufferCopyRegions;
-        size_t                         offset = 0;
+        size_t                         offset = staging.offset;
 
         for(n32 i = 0; i < m_miplevels; i++)
         {
@@ -274,7 +333,7 @@ void Texture::CreateTextureImage(const std::string& imagePath, const ImageType&
         createInfo.height = m_height;
         createInfo.mipLevels = m_miplevels;
         createInfo.layerCount = 1;
-        createInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        createInfo.format = format;
         createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         createInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
         createInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -282,42 +341,11 @@ void Texture::CreateTextureImage(const std::string& imagePath, const ImageType&
 
         Utils::CreateAllocatedImage(createInfo);
 
-        VkCommandBuffer cmd = m_logicalDevice->BeginSingleTimeCommands();
-
-        Utils::ImageTransitionInfo first{};
-        first.cmd = cmd;
-        first.image = m_textureImage.image;
-        first.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        first.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        first.logicalDevice = m_logicalDevice;
-        first.baseMipLevel = 0;
-        first.levelCount = m_miplevels;
-        first.baseArrayLayer = 0;
-        first.layerCount = 1;
-
-        Utils::TransitionImageLayout(first);
-
-        m_logicalDevice->EndSingleTimeCommands(cmd);
-        m_textureImage.imageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-
-        Utils::CopyBufferToImage(*m_logicalDevice, stagingBuffer.GetBuffer(), m_textureImage.image, bufferCopyRegions);
-
-        VkCommandBuffer cmd2 = m_logicalDevice->BeginSingleTimeCommands();
-
-        Utils::ImageTransitionInfo second{};
-        second.cmd = cmd2;
-        second.image = m_textureImage.image;
-        second.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        second.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        second.logicalDevice = m_logicalDevice;
-        second.baseMipLevel = 0;
-        second.levelCount = m_miplevels;
-        second.baseArrayLayer = 0;
-        second.layerCount = 1;
-
-        Utils::TransitionImageLayout(second);
-
-        m_logicalDevice->EndSingleTimeCommands(cmd2);
+        // one submission for the whole upload
+        upload.UploadImage(staging.buffer, m_textureImage.image, bufferCopyRegions, m_miplevels, 1);
+        upload.TransitionImageLayout(m_textureImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0,
+                                     m_miplevels, 0, 1);
+        upload.Wait();
         m_textureImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
         samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -332,21 +360,18 @@ void Texture::CreateTextureImage(const std::string& imagePath, const ImageType&
     {
         gli::texture_cube texCube(gli::load(imagePath));
         HGASSERT(!texCube.empty() && "Failed to load texture!");
+        const VkFormat format = PrepareForUpload(texCube, m_logicalDevice, imagePath);
+        HGASSERT(format != VK_FORMAT_UNDEFINED && "Texture format isn't supported on this device");
         m_width = static_cast<n32>(texCube.extent().x);
         m_height = static_cast<n32>(texCube.extent().y);
         m_miplevels = static_cast<n32>(texCube.levels());
 
-        Buffer stagingBuffer{m_logicalDevice,
-                             texCube.size(),
-                             1,
-                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                             VMA_MEMORY_USAGE_CPU_TO_GPU};
-        stagingBuffer.Map();
-        stagingBuffer.WriteToBuffer((n8*)texCube.data());
+        UploadBatch                    upload{m_logicalDevice};
+        UploadBatch::StagingAllocation staging = upload.AllocateStaging(texCube.size());
+        std::memcpy(staging.data, texCube.data(), texCube.size());
 
         std::vector<VkBufferImageCopy> bufferCopyRegions;
-        size_t                         offset = 0;
+        size_t                         offset = staging.offset;
 
         for(n32 face = 0; face < 6; face++)
         {
@@ -372,7 +397,7 @@ void Texture::CreateTextureImage(const std::string& imagePath, const ImageType&
         Utils::AllocatedImageCreateInfo createInfo{.logicalDevice = *m_logicalDevice, .allocatedImage = m_textureImage};
         createInfo.layerCount = 6;
         createInfo.mipLevels = m_miplevels;
-        createInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        createInfo.format = format;
         createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         createInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
         createInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -384,42 +409,11 @@ void Texture::CreateTextureImage(const std::string& imagePath, const ImageType&
 
         Utils::CreateAllocatedImage(createInfo);
 
-        VkCommandBuffer cmd = m_logicalDevice->BeginSingleTimeCommands();
-
-        Utils::ImageTransitionInfo first{};
-        first.cmd = cmd;
-        first.image = m_textureImage.image;
-        first.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        first.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        first.logicalDevice = m_logicalDevice;
-        first.baseMipLevel = 0;
-        first.levelCount = m_miplevels;
-        first.baseArrayLayer = 0;
-        first.layerCount = 6;
-
-        Utils::TransitionImageLayout(first);
-
-        m_logicalDevice->EndSingleTimeCommands(cmd);
-        m_textureImage.imageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-
-        Utils::CopyBufferToImage(*m_logicalDevice, stagingBuffer.GetBuffer(), m_textureImage.image, bufferCopyRegions);
-
-        VkCommandBuffer cmd2 = m_logicalDevice->BeginSingleTimeCommands();
-
-        Utils::ImageTransitionInfo second{};
-        second.cmd = cmd;
-        second.image = m_textureImage.image;
-        second.oldLayout = m_textureImage.imageLayout;
-        second.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        second.logicalDevice = m_logicalDevice;
-        second.baseMipLevel = 0;
-        second.levelCount = m_miplevels;
-        second.baseArrayLayer = 0;
-        second.layerCount = 6;
-
-        Utils::TransitionImageLayout(second);
-
-        m_logicalDevice->EndSingleTimeCommands(cmd2);
+        // one submission for the whole upload
+        upload.UploadImage(staging.buffer, m_textureImage.image, bufferCopyRegions, m_miplevels, 6);
+        upload.TransitionImageLayout(m_textureImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0,
+                                     m_miplevels, 0, 6);
+        upload.Wait();
         m_textureImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
         samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -451,11 +445,9 @@ void Texture::CreateTextureImageSampler(const SamplerCreateInfo& info, const Ima
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = static_cast<float>(m_miplevels);
-    if(vkCreateSampler(m_logicalDevice->GetVkDevice(), &samplerInfo, nullptr, &m_textureSampler) != VK_SUCCESS)
-    {
-        HGERROR("Failed to create texture sampler");
-    }
+    // the image view already limits sampling to the levels it has, leaving the lod unclamped lets every mip count share a sampler
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    m_textureSampler = SamplerCache::GetSampler(samplerInfo);
 }
 
 }; // namespace Humongous
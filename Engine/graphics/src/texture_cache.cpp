@@ -0,0 +1,237 @@
+#include "texture_cache.hpp"
+#include "logger.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace Humongous
+{
+static_assert(sizeof(TextureCache::Header) == 80, "KTX2 header layout");
+static_assert(sizeof(TextureCache::LevelIndex) == 24, "KTX2 level index layout");
+
+static constexpr n32 DFD_BASIC_BLOCK_SIZE = 24;
+static constexpr n32 DFD_SAMPLE_SIZE = 16;
+
+static const char* GetRoleSuffix(Utils::TextureRole role)
+{
+    switch(role)
+    {
+        case Utils::TextureRole::NORMAL:
+            return "normal";
+        case Utils::TextureRole::OCCLUSION:
+            return "occlusion";
+        case Utils::TextureRole::DATA:
+            return "data";
+        default:
+            return "color";
+    }
+}
+
+static n32 GetLevelLength(VkFormat format, n32 width, n32 height, n32 level)
+{
+    const n32 levelWidth = std::max<n32>(width >> level, 1), levelHeight = std::max<n32>(height >> level, 1);
+    return ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * Utils::GetBlockSize(format);
+}
+
+// the basic data format descriptor KTX2 requires, one sample per 64 bit half of the block
+static std::vector<n32> BuildDataFormatDescriptor(VkFormat format)
+{
+    struct Sample
+    {
+        n32 bitOffset;
+        n32 channel;
+    };
+
+    // KHR_DF_MODEL_BC1A .. BC5 and the channel ids they use, 15 is alpha
+    n32                 colorModel = 0;
+    std::vector<Sample> samples;
+    switch(format)
+    {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            colorModel = 128;
+            samples = {{0, 0}};
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+            colorModel = 130;
+            samples = {{0, 15}, {64, 0}};
+            break;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            colorModel = 131;
+            samples = {{0, 0}};
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            colorModel = 132;
+            samples = {{0, 0}, {64, 1}};
+            break;
+        default:
+            break;
+    }
+
+    const n32        blockSize = DFD_BASIC_BLOCK_SIZE + DFD_SAMPLE_SIZE * static_cast<n32>(samples.size());
+    std::vector<n32> words;
+    words.push_back(sizeof(n32) + blockSize); // total size, the block follows
+    words.push_back(0);                       // vendor khronos, descriptor type basic
+    words.push_back(2 | (blockSize << 16));   // version 1.3
+    words.push_back(colorModel | (1 << 8) | (1 << 16)); // BT709 primaries, linear transfer, straight alpha
+    words.push_back(3 | (3 << 8));                      // 4x4x1x1 texel blocks, stored minus one
+    words.push_back(Utils::GetBlockSize(format));       // bytes in plane 0
+    words.push_back(0);
+    for(const Sample& sample: samples)
+    {
+        words.push_back(sample.bitOffset | (63 << 16) | (sample.channel << 24)); // bit length is stored minus one as well
+        words.push_back(0);
+        words.push_back(0);
+        words.push_back(0xFFFFFFFF);
+    }
+
+    return words;
+}
+
+std::string TextureCache::GetCachePath(n64 sourceHash, Utils::TextureRole role, Utils::MipFilter mipFilter)
+{
+    namespace fs = std::filesystem;
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx_%s_%s.ktx2", static_cast<unsigned long long>(sourceHash), GetRoleSuffix(role),
+                  mipFilter == Utils::MipFilter::KAISER ? "kaiser" : "box");
+    return (fs::path(HGASSETDIRPATH) / "cache" / "textures" / name).string();
+}
+
+bool TextureCache::Load(n64 sourceHash, Utils::TextureRole role, Utils::MipFilter mipFilter, Utils::CompressedImage& image)
+{
+    const std::string cachePath = GetCachePath(sourceHash, role, mipFilter);
+    if(!std::filesystem::exists(cachePath)) { return false; }
+
+    Utils::MappedFile file;
+    if(!file.Open(cachePath) || file.GetSize() < sizeof(Header))
+    {
+        HGWARN("Unable to read texture cache %s", cachePath.c_str());
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, file.GetData(), sizeof(Header));
+
+    const VkFormat format = static_cast<VkFormat>(header.vkFormat);
+    if(std::memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 || Utils::GetBlockSize(format) == 0 || header.pixelWidth == 0 ||
+       header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount != 0 || header.faceCount != 1 || header.levelCount == 0 ||
+       header.levelCount > 32 || header.supercompressionScheme != 0 ||
+       file.GetSize() < sizeof(Header) + static_cast<size_t>(header.levelCount) * sizeof(LevelIndex))
+    {
+        HGWARN("Texture cache %s isn't in a layout the engine writes, rebuilding it", cachePath.c_str());
+        return false;
+    }
+
+    std::vector<LevelIndex> levels(header.levelCount);
+    std::memcpy(levels.data(), file.GetData() + sizeof(Header), levels.size() * sizeof(LevelIndex));
+
+    image = {};
+    image.format = format;
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+    for(n32 l = 0; l < header.levelCount; l++)
+    {
+        const LevelIndex& level = levels[l];
+        if(level.byteLength != GetLevelLength(format, image.width, image.height, l) || level.byteOffset > file.GetSize() ||
+           level.byteLength > file.GetSize() - level.byteOffset)
+        {
+            HGWARN("Texture cache %s is corrupt, rebuilding it", cachePath.c_str());
+            image = {};
+            return false;
+        }
+
+        image.levelOffsets.push_back(image.data.size());
+        image.levelSizes.push_back(level.byteLength);
+        image.data.insert(image.data.end(), file.GetData() + level.byteOffset, file.GetData() + level.byteOffset + level.byteLength);
+    }
+
+    return true;
+}
+
+bool TextureCache::Save(n64 sourceHash, Utils::TextureRole role, Utils::MipFilter mipFilter, const Utils::CompressedImage& image)
+{
+    namespace fs = std::filesystem;
+
+    const n32 levelCount = image.GetLevelCount();
+    const n32 blockSize = Utils::GetBlockSize(image.format);
+    if(!image.IsValid() || blockSize == 0) { return false; }
+
+    const std::vector<n32> dfd = BuildDataFormatDescriptor(image.format);
+
+    Header header{};
+    std::memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+    header.vkFormat = image.format;
+    header.typeSize = 1;
+    header.pixelWidth = image.width;
+    header.pixelHeight = image.height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = static_cast<n32>(sizeof(Header) + levelCount * sizeof(LevelIndex));
+    header.dfdByteLength = static_cast<n32>(dfd.size() * sizeof(n32));
+
+    // level data starts on a block boundary, the smallest level comes first
+    std::vector<LevelIndex> levels(levelCount);
+    n64                     offset = header.dfdByteOffset + header.dfdByteLength;
+    for(s32 l = static_cast<s32>(levelCount) - 1; l >= 0; l--)
+    {
+        offset = (offset + blockSize - 1) / blockSize * blockSize;
+        levels[l] = {offset, image.levelSizes[l], image.levelSizes[l]};
+        offset += image.levelSizes[l];
+    }
+
+    const fs::path cachePath = GetCachePath(sourceHash, role, mipFilter);
+    // two models can embed the same image, their loads must not write into the same temporary file
+    const n64      threadHash = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    const fs::path tempPath = fs::path(cachePath).concat(".tmp" + std::to_string(threadHash));
+
+    std::error_code ec;
+    fs::create_directories(cachePath.parent_path(), ec);
+
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if(!file)
+        {
+            HGWARN("Unable to create texture cache %s", tempPath.string().c_str());
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        file.write(reinterpret_cast<const char*>(levels.data()), static_cast<std::streamsize>(levels.size() * sizeof(LevelIndex)));
+        file.write(reinterpret_cast<const char*>(dfd.data()), header.dfdByteLength);
+
+        const char padding[16]{};
+        n64        written = header.dfdByteOffset + header.dfdByteLength;
+        for(s32 l = static_cast<s32>(levelCount) - 1; l >= 0; l--)
+        {
+            file.write(padding, static_cast<std::streamsize>(levels[l].byteOffset - written));
+            file.write(reinterpret_cast<const char*>(image.data.data() + image.levelOffsets[l]), static_cast<std::streamsize>(image.levelSizes[l]));
+            written = levels[l].byteOffset + levels[l].byteLength;
+        }
+
+        if(!file)
+        {
+            HGWARN("Failed to write texture cache %s", tempPath.string().c_str());
+            file.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tempPath, cachePath, ec);
+    if(ec)
+    {
+        HGWARN("Failed to move texture cache into place: %s", ec.message().c_str());
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace Humongous
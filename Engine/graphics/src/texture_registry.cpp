@@ -0,0 +1,114 @@
+#include "texture_registry.hpp"
+
+namespace Humongous
+{
+void TextureRegistry::Internal_Init(LogicalDevice* device)
+{
+    const n8 colors[static_cast<n32>(DefaultTexture::COUNT)][4] = {
+        {255, 255, 255, 255}, // WHITE
+        {0, 0, 0, 255},       // BLACK
+        {128, 128, 255, 255}, // FLAT_NORMAL, only xy are read, z is rebuilt in the shader
+    };
+
+    for(n32 i = 0; i < static_cast<n32>(DefaultTexture::COUNT); i++) { m_defaults[i].CreateFromColor(colors[i], device); }
+}
+
+void TextureRegistry::Internal_Shutdown()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // models still alive at this point release into an empty registry, see Internal_Release
+    for(auto& [key, entry]: m_entries) { entry.texture.Destroy(); }
+    m_entries.clear();
+    m_deduplicatedBytes = 0;
+
+    for(Texture& texture: m_defaults) { texture.Destroy(); }
+}
+
+Texture TextureRegistry::Internal_Acquire(n64 key, const void* owner, const std::function<void(Texture&)>& create)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto [it, inserted] = m_entries.try_emplace(key);
+    Entry& entry = it->second;
+    if(!inserted)
+    {
+        // only waits for whoever claimed the entry to record its upload, not for the upload itself
+        m_readyCondition.wait(lock, [&]() { return entry.created; });
+        entry.references++;
+        m_deduplicatedBytes += entry.bytes;
+        return entry.texture;
+    }
+
+    // the entry is claimed, so nobody else creates it. creating runs outside the lock, other loaders keep creating theirs meanwhile
+    entry.references = 1;
+    entry.owner = owner;
+    lock.unlock();
+
+    Texture texture;
+    create(texture);
+
+    lock.lock();
+    entry.texture = texture;
+    entry.bytes = texture.GetMemorySize();
+    entry.created = true;
+    lock.unlock();
+
+    m_readyCondition.notify_all();
+    return texture;
+}
+
+void TextureRegistry::Internal_Release(n64 key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // models that outlive Shutdown find their entries gone
+    auto it = m_entries.find(key);
+    if(it == m_entries.end()) { return; }
+
+    Entry& entry = it->second;
+    if(--entry.references > 0)
+    {
+        m_deduplicatedBytes -= entry.bytes;
+        return;
+    }
+
+    entry.texture.Destroy();
+    m_entries.erase(it);
+}
+
+void TextureRegistry::Internal_MarkReady(const void* owner)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(auto& [key, entry]: m_entries)
+        {
+            if(entry.owner != owner) { continue; }
+            entry.ready = true;
+            entry.owner = nullptr;
+        }
+    }
+
+    m_readyCondition.notify_all();
+}
+
+void TextureRegistry::Internal_WaitUntilReady(const std::vector<n64>& keys)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_readyCondition.wait(lock, [&]() {
+        for(n64 key: keys)
+        {
+            auto it = m_entries.find(key);
+            if(it != m_entries.end() && !it->second.ready) { return false; }
+        }
+        return true;
+    });
+}
+
+VkDeviceSize TextureRegistry::Internal_GetDeduplicatedBytes()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_deduplicatedBytes;
+}
+
+} // namespace Humongous
@@ -0,0 +1,238 @@
+#include "upload_batch.hpp"
+#include "asserts.hpp"
+#include "images.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Humongous
+{
+UploadBatch::UploadBatch(LogicalDevice* device) : m_device{device} {}
+
+UploadBatch::~UploadBatch() { Wait(); }
+
+UploadBatch::StagingAllocation UploadBatch::AllocateStaging(VkDeviceSize size, VkDeviceSize alignment)
+{
+    HGASSERT(m_fence == VK_NULL_HANDLE && "Can't stage into an upload batch that is in flight");
+
+    StagingChunk* chunk = nullptr;
+    VkDeviceSize  offset = 0;
+    for(auto& candidate: m_chunks)
+    {
+        offset = (candidate.used + alignment - 1) & ~(alignment - 1);
+        if(offset + size <= candidate.buffer->GetBufferSize())
+        {
+            chunk = &candidate;
+            break;
+        }
+    }
+
+    if(!chunk)
+    {
+        StagingChunk newChunk{};
+        newChunk.buffer = std::make_unique<Buffer>();
+        newChunk.buffer->InitStaging(m_device, std::max(size, STAGING_CHUNK_SIZE));
+        m_chunks.push_back(std::move(newChunk));
+
+        chunk = &m_chunks.back();
+        offset = 0;
+    }
+
+    chunk->used = offset + size;
+    return {chunk->buffer->GetBuffer(), offset, static_cast<n8*>(chunk->buffer->GetMappedMemory()) + offset};
+}
+
+void UploadBatch::CopyBuffer(VkBuffer src, VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+    VkBufferCopy2 copyRegion{.sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2};
+    copyRegion.srcOffset = srcOffset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = size;
+
+    VkCopyBufferInfo2 copyBufferInfo{.sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2};
+    copyBufferInfo.srcBuffer = src;
+    copyBufferInfo.dstBuffer = dst;
+    copyBufferInfo.regionCount = 1;
+    copyBufferInfo.pRegions = &copyRegion;
+
+    vkCmdCopyBuffer2(GetTransferCommandBuffer(), &copyBufferInfo);
+    if(m_device->HasDedicatedTransferQueue()) { m_writtenBuffers.push_back(dst); }
+}
+
+void UploadBatch::UploadToBuffer(const void* data, VkDeviceSize size, VkBuffer dst)
+{
+    if(size == 0) { return; }
+
+    StagingAllocation staging = AllocateStaging(size);
+    std::memcpy(staging.data, data, size);
+    CopyBuffer(staging.buffer, staging.offset, dst, 0, size);
+}
+
+void UploadBatch::UploadImage(VkBuffer src, VkImage image, const std::vector<VkBufferImageCopy>& regions, n32 mipLevels, n32 layerCount)
+{
+    VkCommandBuffer cmd = GetTransferCommandBuffer();
+
+    Utils::ImageTransitionInfo info{};
+    info.cmd = cmd;
+    info.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    info.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    info.logicalDevice = m_device;
+    info.image = image;
+    info.levelCount = mipLevels;
+    info.layerCount = layerCount;
+
+    Utils::TransitionImageLayout(info);
+    Utils::CopyBufferToImage(cmd, src, image, regions);
+
+    if(!m_device->HasDedicatedTransferQueue()) { return; }
+
+    // the layout stays the same, the barrier pair only moves the image over to the graphics family
+    VkImageMemoryBarrier2 ownershipBarrier{.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+    ownershipBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    ownershipBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    ownershipBarrier.srcQueueFamilyIndex = m_device->GetTransferQueueIndex();
+    ownershipBarrier.dstQueueFamilyIndex = m_device->GetGraphicsQueueIndex();
+    ownershipBarrier.image = image;
+    ownershipBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layerCount};
+
+    VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    depInfo.imageMemoryBarrierCount = 1;
+    depInfo.pImageMemoryBarriers = &ownershipBarrier;
+
+    ownershipBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    ownershipBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+
+    ownershipBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    ownershipBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+    ownershipBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    ownershipBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier2(GetCommandBuffer(), &depInfo);
+}
+
+void UploadBatch::TransitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, n32 baseMipLevel, n32 levelCount,
+                                        n32 baseArrayLayer, n32 layerCount)
+{
+    Utils::ImageTransitionInfo info{};
+    info.cmd = GetCommandBuffer();
+    info.oldLayout = oldLayout;
+    info.newLayout = newLayout;
+    info.logicalDevice = m_device;
+    info.image = image;
+    info.baseMipLevel = baseMipLevel;
+    info.levelCount = levelCount;
+    info.baseArrayLayer = baseArrayLayer;
+    info.layerCount = layerCount;
+
+    Utils::TransitionImageLayout(info);
+}
+
+void UploadBatch::Retain(std::unique_ptr<Buffer> buffer) { m_retained.push_back(std::move(buffer)); }
+
+VkCommandBuffer UploadBatch::GetCommandBuffer()
+{
+    HGASSERT(m_fence == VK_NULL_HANDLE && "Can't record into an upload batch that is in flight");
+
+    if(m_graphicsCommandBuffer == VK_NULL_HANDLE) { m_graphicsCommandBuffer = m_device->BeginSingleTimeCommands(); }
+    return m_graphicsCommandBuffer;
+}
+
+VkCommandBuffer UploadBatch::GetTransferCommandBuffer()
+{
+    // no dedicated transfer queue means no ownership to hand over, so the copies just go in with everything else
+    if(!m_device->HasDedicatedTransferQueue()) { return GetCommandBuffer(); }
+
+    HGASSERT(m_fence == VK_NULL_HANDLE && "Can't record into an upload batch that is in flight");
+
+    if(m_transferCommandBuffer == VK_NULL_HANDLE)
+    {
+        m_transferCommandBuffer = m_device->BeginSingleTimeCommands(LogicalDevice::QueueType::TRANSFER);
+    }
+    return m_transferCommandBuffer;
+}
+
+void UploadBatch::ReleaseWrittenBuffers()
+{
+    if(m_writtenBuffers.empty()) { return; }
+
+    std::sort(m_writtenBuffers.begin(), m_writtenBuffers.end());
+    m_writtenBuffers.erase(std::unique(m_writtenBuffers.begin(), m_writtenBuffers.end()), m_writtenBuffers.end());
+
+    std::vector<VkBufferMemoryBarrier2> barriers(m_writtenBuffers.size(), {.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2});
+    for(size_t i = 0; i < barriers.size(); i++)
+    {
+        barriers[i].srcQueueFamilyIndex = m_device->GetTransferQueueIndex();
+        barriers[i].dstQueueFamilyIndex = m_device->GetGraphicsQueueIndex();
+        barriers[i].buffer = m_writtenBuffers[i];
+        barriers[i].size = VK_WHOLE_SIZE;
+        barriers[i].srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+        barriers[i].srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    }
+
+    VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    depInfo.bufferMemoryBarrierCount = static_cast<n32>(barriers.size());
+    depInfo.pBufferMemoryBarriers = barriers.data();
+    vkCmdPipelineBarrier2(GetTransferCommandBuffer(), &depInfo);
+
+    // the acquire half, geometry is read through device addresses and index fetches so the reads are left broad
+    for(auto& barrier: barriers)
+    {
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        barrier.srcAccessMask = VK_ACCESS_2_NONE;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+    }
+    vkCmdPipelineBarrier2(GetCommandBuffer(), &depInfo);
+
+    m_writtenBuffers.clear();
+}
+
+VkFence UploadBatch::Submit()
+{
+    if(IsEmpty() || m_fence != VK_NULL_HANDLE) { return m_fence; }
+
+    ReleaseWrittenBuffers();
+
+    if(m_transferCommandBuffer != VK_NULL_HANDLE) { m_fence = m_device->SubmitUploadCommands(m_transferCommandBuffer, GetCommandBuffer()); }
+    else { m_fence = m_device->SubmitSingleTimeCommands(m_graphicsCommandBuffer); }
+    return m_fence;
+}
+
+bool UploadBatch::IsComplete()
+{
+    if(IsEmpty()) { return true; }
+    if(m_fence == VK_NULL_HANDLE || vkGetFenceStatus(m_device->GetVkDevice(), m_fence) != VK_SUCCESS) { return false; }
+
+    Retire();
+    return true;
+}
+
+void UploadBatch::Wait()
+{
+    if(IsEmpty()) { return; }
+
+    Submit();
+    Retire();
+}
+
+void UploadBatch::Retire()
+{
+    // the graphics submission waits on the transfer one, so its fence covers both
+    m_device->RetireSingleTimeCommands(m_graphicsCommandBuffer, m_fence);
+    if(m_transferCommandBuffer != VK_NULL_HANDLE)
+    {
+        m_device->FreeSingleTimeCommands(m_transferCommandBuffer, LogicalDevice::QueueType::TRANSFER);
+    }
+    m_graphicsCommandBuffer = VK_NULL_HANDLE;
+    m_transferCommandBuffer = VK_NULL_HANDLE;
+    m_fence = VK_NULL_HANDLE;
+    m_retained.clear();
+
+    // regular sized chunks get reused by whatever the batch records next, oversized ones go back to the allocator
+    std::erase_if(m_chunks, [](const StagingChunk& chunk) { return chunk.buffer->GetBufferSize() > STAGING_CHUNK_SIZE; });
+    if(m_chunks.size() > MAX_RECYCLED_CHUNKS) { m_chunks.resize(MAX_RECYCLED_CHUNKS); }
+    for(auto& chunk: m_chunks) { chunk.used = 0; }
+}
+
+} // namespace Humongous
@@ -1,13 +1,18 @@
 #include "vulkan_app.hpp"
 #include "allocator.hpp"
+#include "bindless_textures.hpp"
 #include "camera.hpp"
 #include "globals.hpp"
 #include "keyboard_handler.hpp"
 #include "logger.hpp"
 #include "model.hpp"
+#include "model_cache.hpp"
+#include "sampler_cache.hpp"
+#include "texture_registry.hpp"
 #include "ui/ui.hpp"
 #define VMA_IMPLEMENTATION
 #include "asset_manager.hpp"
+#include "job_system.hpp"
 #include "ui/widget.hpp"
 #include "vk_mem_alloc.h"
 
@@ -21,7 +26,7 @@ VulkanApp::VulkanApp(int argc, char* argv[])
 
 VulkanApp::~VulkanApp()
 {
-    m_logicalDevice->GetVkDevice().waitIdle();
+    m_logicalDevice->WaitIdle();
     m_mainDeletionQueue.Flush();
 }
 
@@ -48,7 +53,12 @@ void VulkanApp::Init(int argc, char* argv[])
         Systems::AssetManager::Init();
     }
 
+    Systems::JobSystem::Init();
+
     Allocator::Initialize(m_logicalDevice.get());
+    SamplerCache::Init(m_logicalDevice.get());
+    BindlessTextures::Init(m_logicalDevice.get());
+    TextureRegistry::Init(m_logicalDevice.get());
 
     UI::Init(m_instance.get(), m_logicalDevice.get(), m_window.get());
 
@@ -63,6 +73,10 @@ void VulkanApp::Init(int argc, char* argv[])
         m_renderer.reset();
         m_cam.reset();
         UI::Shutdown();
+        Systems::JobSystem::Shutdown();
+        TextureRegistry::Shutdown();
+        BindlessTextures::Shutdown();
+        SamplerCache::Shutdown();
         Allocator::Shutdown();
         m_logicalDevice.reset();
         m_physicalDevice.reset();
@@ -75,9 +89,16 @@ void VulkanApp::LoadGameObjects()
 {
     HGINFO("Loading game objects...");
 
+    // models stream in on the job system and are shared through the cache, objects show up once their model is resident
+
+    // the scene is by far the largest vertex stream, so it gets the smallest vertex format
+    ModelImportSettings sceneSettings{};
+    sceneSettings.vertexFormat = VertexFormat::QUANTIZED;
+    sceneSettings.optimizeMeshes = true;
+
     std::shared_ptr<Model> model;
-    model =
-        std::make_shared<Model>(m_logicalDevice.get(), Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::MODEL, "Sponza"), 1.00);
+    model = ModelCache::Acquire(m_logicalDevice.get(), Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::MODEL, "Sponza"), 1.00,
+                                sceneSettings);
 
     GameObject obj = GameObject::CreateGameObject();
     obj.transform.translation = {0.0f, 0.0f, 0.0f};
@@ -88,8 +109,8 @@ void VulkanApp::LoadGameObjects()
     m_gameObjects.emplace(obj.GetId(), std::move(obj));
 
     std::shared_ptr<Model> model2;
-    model2 = std::make_shared<Model>(m_logicalDevice.get(),
-                                     Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::MODEL, "DamagedHelmet"), 1.00);
+    model2 = ModelCache::Acquire(m_logicalDevice.get(), Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::MODEL, "DamagedHelmet"),
+                                 1.00);
 
     GameObject obj2 = GameObject::CreateGameObject();
     obj2.transform.translation = {1.0f, 0.0f, 0.0f};
@@ -100,8 +121,8 @@ void VulkanApp::LoadGameObjects()
     m_gameObjects.emplace(obj2.GetId(), std::move(obj2));
 
     std::shared_ptr<Model> model3;
-    model3 = std::make_shared<Model>(m_logicalDevice.get(), Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::MODEL, "old_hunter"),
-                                     1.00);
+    model3 =
+        ModelCache::Acquire(m_logicalDevice.get(), Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::MODEL, "old_hunter"), 1.00);
     GameObject obj3 = GameObject::CreateGameObject();
     obj3.transform.translation = {-1.0f, 0.0f, 0.0f};
     obj3.transform.rotation = {glm::radians(180.0f), 0, 0};
@@ -110,7 +131,7 @@ void VulkanApp::LoadGameObjects()
 
     m_gameObjects.emplace(obj3.GetId(), std::move(obj3));
 
-    // std::shared_ptr<Model> m = std::make_shared<Model>(
+    // std::shared_ptr<Model> m = ModelCache::Acquire(
     //     m_logicalDevice.get(), Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::MODEL, "high_res_car"), 1.0f);
 
     // int x = 0, y = 0, z = 0;
@@ -202,7 +223,10 @@ void VulkanApp::Run()
     std::vector<VkDescriptorSetLayout> skyboxLayouts = {m_cam->GetDescriptorSetLayout()};
 
     ShaderSet set = {Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::SHADER, "simple.vert"),
-                     Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::SHADER, "unlit.frag")};
+                     Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::SHADER, "unlit.frag"),
+                     Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::SHADER, "simple_compact.vert"),
+                     Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::SHADER, "simple_quantized.vert"),
+                     Systems::AssetManager::GetAsset(Systems::AssetManager::AssetType::SHADER, "cull.comp")};
 
     m_simpleRenderSystem = std::make_unique<SimpleRenderSystem>(*m_logicalDevice, simpleLayouts, set);
     m_skyboxRenderSystem = std::make_unique<SkyboxRenderSystem>(m_logicalDevice.get(), "papermill", skyboxLayouts);
@@ -264,6 +288,7 @@ void VulkanApp::Run()
 
         if(!minimized && focused)
         {
+            n32 objectsLoading = 0;
             for(auto& [k, v]: m_gameObjects)
             {
                 // if(k % 2 == 0)
@@ -280,7 +305,8 @@ void VulkanApp::Run()
                 //         {v.transform.translation.x, glm::sin(static_cast<float>(Globals::Time::TimeSinceStart())), v.transform.translation.z},
                 //         static_cast<float>(Globals::Time::AverageDeltaTime()) * 4);
                 // }
-                v.Update();
+                v.Update(&m_objectTree);
+                if(v.IsLoading()) { objectsLoading++; }
             }
 
             if(auto cmd = m_renderer->BeginFrame())
@@ -292,10 +318,16 @@ void VulkanApp::Run()
                                 .gameObjects = m_gameObjects,
                                 .frameIndex = m_renderer->GetFrameIndex(),
                                 .cam = *m_cam,
-                                .camPos = viewerObject.transform.translation};
+                                .camPos = viewerObject.transform.translation,
+                                .viewportHeight = static_cast<f32>(m_renderer->GetExtent().height),
+                                .objectTree = &m_objectTree,
+                                .objectsLoading = objectsLoading};
 
                 m_cam->UpdateUBO(m_renderer->GetFrameIndex(), viewerObject.transform.translation);
 
+                // compute work can't be recorded while rendering
+                m_simpleRenderSystem->CullObjects(data);
+
                 m_renderer->BeginRendering(cmd);
 
                 m_skyboxRenderSystem->RenderSkybox(data.frameIndex, data.uboSets, cmd);
@@ -304,7 +336,7 @@ void VulkanApp::Run()
                 UI::BeginUIFrame(cmd);
                 objectWidget.Draw();
 
-                UI::Debug_DrawMetrics(m_simpleRenderSystem->GetObjectsDrawn());
+                UI::Debug_DrawMetrics(m_simpleRenderSystem->GetObjectsDrawn(), m_simpleRenderSystem->GetRenderStats());
 
                 UI::EndUIFRame(cmd);
 
@@ -313,7 +345,7 @@ void VulkanApp::Run()
             }
         }
     }
-    m_logicalDevice->GetVkDevice().waitIdle();
+    m_logicalDevice->WaitIdle();
 
     HGINFO("Quitting...");
 }
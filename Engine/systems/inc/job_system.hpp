@@ -0,0 +1,71 @@
+#pragma once
+
+#include "defines.hpp"
+#include "non_copyable.hpp"
+#include "singleton.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Humongous
+{
+namespace Systems
+{
+
+class JobSystem : public Singleton<JobSystem>, NonCopyable
+{
+public:
+    using Job = std::function<void()>;
+    using Counter = std::atomic<n32>;
+
+    /***
+     * spawns the worker threads.
+     * a threadCount of 0 uses one worker per hardware thread minus the calling one,
+     * the HG_WORKER_THREADS environment variable overrides both.
+     * */
+    static void Init(n32 threadCount = 0) { Get().Internal_Init(threadCount); }
+    static void Shutdown() { Get().Internal_Shutdown(); }
+
+    // queues a job, if a counter is passed it gets incremented now and decremented once the job has finished
+    static void Execute(Job job, Counter* counter = nullptr) { Get().Internal_Execute(std::move(job), counter); }
+
+    // for jobs that block on other long running jobs themselves, like whole asset loads. they're only started by an idle worker and
+    // never by a Wait helping out, so one can't end up on the stack of another one it has to wait for
+    static void ExecuteLongRunning(Job job) { Get().Internal_ExecuteLongRunning(std::move(job)); }
+
+    // blocks until the counter reaches zero, the calling thread helps out with queued jobs while it waits
+    static void Wait(Counter& counter) { Get().Internal_Wait(counter); }
+
+    // splits [0, count) into batches of batchSize and runs func(begin, end) for every batch, returns once all of them are done
+    static void ParallelFor(n32 count, n32 batchSize, const std::function<void(n32 begin, n32 end)>& func)
+    {
+        Get().Internal_ParallelFor(count, batchSize, func);
+    }
+
+    static n32 GetWorkerCount() { return static_cast<n32>(Get().m_workers.size()); }
+
+private:
+    std::vector<std::thread> m_workers;
+    std::deque<Job>          m_jobs;
+    std::deque<Job>          m_longRunningJobs;
+    std::mutex               m_mutex;
+    std::condition_variable  m_condition;
+    bool                     m_stop{false};
+
+    void Internal_Init(n32 threadCount);
+    void Internal_Shutdown();
+    void Internal_Execute(Job job, Counter* counter);
+    void Internal_ExecuteLongRunning(Job job);
+    void Internal_Wait(Counter& counter);
+    void Internal_ParallelFor(n32 count, n32 batchSize, const std::function<void(n32 begin, n32 end)>& func);
+
+    void WorkerLoop();
+    bool TryRunPendingJob();
+};
+
+} // namespace Systems
+} // namespace Humongous
@@ -0,0 +1,134 @@
+#include "job_system.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace Humongous::Systems
+{
+
+void JobSystem::Internal_Init(n32 threadCount)
+{
+    if(!m_workers.empty()) { return; }
+
+    if(threadCount == 0)
+    {
+        n32 hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    if(const char* env = std::getenv("HG_WORKER_THREADS"))
+    {
+        s32 requested = std::atoi(env);
+        if(requested >= 0) { threadCount = static_cast<n32>(requested); }
+    }
+
+    m_stop = false;
+    m_workers.reserve(threadCount);
+    for(n32 i = 0; i < threadCount; i++) { m_workers.emplace_back([this]() { WorkerLoop(); }); }
+
+    HGINFO("Started job system with %u worker threads", threadCount);
+}
+
+void JobSystem::Internal_Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+
+    for(auto& worker: m_workers)
+    {
+        if(worker.joinable()) { worker.join(); }
+    }
+    m_workers.clear();
+}
+
+void JobSystem::Internal_Execute(Job job, Counter* counter)
+{
+    if(counter) { counter->fetch_add(1, std::memory_order_relaxed); }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.emplace_back([job = std::move(job), counter]() {
+            job();
+            if(counter) { counter->fetch_sub(1, std::memory_order_release); }
+        });
+    }
+    m_condition.notify_one();
+}
+
+void JobSystem::Internal_ExecuteLongRunning(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_longRunningJobs.push_back(std::move(job));
+    }
+    m_condition.notify_one();
+}
+
+void JobSystem::Internal_Wait(Counter& counter)
+{
+    while(counter.load(std::memory_order_acquire) > 0)
+    {
+        if(!TryRunPendingJob()) { std::this_thread::yield(); }
+    }
+}
+
+void JobSystem::Internal_ParallelFor(n32 count, n32 batchSize, const std::function<void(n32 begin, n32 end)>& func)
+{
+    if(count == 0) { return; }
+    batchSize = std::max(batchSize, 1u);
+
+    // nothing to gain from queueing, just run it here
+    if(m_workers.empty() || count <= batchSize)
+    {
+        func(0, count);
+        return;
+    }
+
+    Counter counter{0};
+    for(n32 begin = 0; begin < count; begin += batchSize)
+    {
+        n32 end = std::min(begin + batchSize, count);
+        Internal_Execute([&func, begin, end]() { func(begin, end); }, &counter);
+    }
+
+    Internal_Wait(counter);
+}
+
+void JobSystem::WorkerLoop()
+{
+    while(true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stop || !m_jobs.empty() || !m_longRunningJobs.empty(); });
+
+            if(m_stop && m_jobs.empty() && m_longRunningJobs.empty()) { return; }
+
+            // short jobs first, somebody may be waiting on them
+            std::deque<Job>& queue = m_jobs.empty() ? m_longRunningJobs : m_jobs;
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        job();
+    }
+}
+
+bool JobSystem::TryRunPendingJob()
+{
+    Job job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_jobs.empty()) { return false; }
+
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+    }
+    job();
+    return true;
+}
+
+} // namespace Humongous::Systems
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "defines.hpp"
+#include <cstddef>
+#include <cstring>
+
+namespace Humongous
+{
+namespace Utils
+{
+// fast, non-cryptographic 64 bit hash over raw bytes, good enough to tell whether an asset has changed
+inline n64 HashBytes(const void* data, size_t size, n64 seed = 0xcbf29ce484222325ull)
+{
+    const n8* bytes = static_cast<const n8*>(data);
+    n64       hash = seed ^ (static_cast<n64>(size) * 0x9e3779b97f4a7c15ull);
+
+    size_t i = 0;
+    for(; i + sizeof(n64) <= size; i += sizeof(n64))
+    {
+        n64 word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 32;
+    }
+    for(; i < size; i++) { hash = (hash ^ bytes[i]) * 0x100000001b3ull; }
+
+    // final avalanche so that short inputs still touch every bit
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+} // namespace Utils
+} // namespace Humongous
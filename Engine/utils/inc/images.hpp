@@ -62,6 +62,10 @@ void CopyImageToImage(VkCommandBuffer cmd, AllocatedImage& src, AllocatedImage&
 
 void CopyBufferToImage(LogicalDevice& logicalDevice, VkBuffer buffer, VkImage image, n32 width, n32 height);
 void CopyBufferToImage(LogicalDevice& logicalDevice, VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy>& bufferCopyRegions);
+void CopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy>& bufferCopyRegions);
+
+// appends an opaque alpha to every pixel, 4 pixels at a time with SSE2 on x86-64
+void ExpandRGBToRGBA(const n8* rgb, n8* rgba, size_t pixelCount);
 
 } // namespace Utils
 } // namespace Humongous
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "defines.hpp"
+#include <cstddef>
+#include <string>
+
+namespace Humongous
+{
+namespace Utils
+{
+// read only memory mapping of a whole file, unmapped when it goes out of scope
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    bool      IsOpen() const { return m_data != nullptr; }
+    const n8* GetData() const { return m_data; }
+    size_t    GetSize() const { return m_size; }
+
+private:
+    const n8* m_data = nullptr;
+    size_t    m_size = 0;
+
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+} // namespace Utils
+} // namespace Humongous
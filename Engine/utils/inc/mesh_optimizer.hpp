@@ -0,0 +1,133 @@
+#pragma once
+
+#include "defines.hpp"
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace Humongous
+{
+namespace Utils
+{
+/***
+ * Import time processing of indexed triangle lists. The usual order is
+ * WeldVertices -> OptimizeVertexCache -> OptimizeOverdraw -> OptimizeVertexFetch, meshlets are built after that and followed by
+ * OptimizeMeshlets and another OptimizeVertexFetch. every step works in place on a single primitive's vertices and local indices.
+ * */
+
+struct VertexCacheStats
+{
+    n32 triangles = 0;
+    n32 vertices = 0; // referenced vertices
+    n32 misses = 0;
+
+    f32 GetACMR() const { return triangles ? static_cast<f32>(misses) / triangles : 0.0f; } // average cache miss ratio, misses per triangle
+    f32 GetATVR() const { return vertices ? static_cast<f32>(misses) / vertices : 0.0f; }   // average transformed vertex ratio, 1.0 is ideal
+
+    VertexCacheStats& operator+=(const VertexCacheStats& other)
+    {
+        triangles += other.triangles;
+        vertices += other.vertices;
+        misses += other.misses;
+        return *this;
+    }
+};
+
+static constexpr n32 VERTEX_CACHE_SIZE = 16;
+
+// simulates a FIFO post transform cache
+VertexCacheStats AnalyzeVertexCache(const n32* indices, size_t indexCount, n32 vertexCount, n32 cacheSize = VERTEX_CACHE_SIZE);
+
+// Tipsify (Sander et al. 2007), reorders triangles so vertices get reused while they are still in the cache
+void OptimizeVertexCache(n32* indices, size_t indexCount, n32 vertexCount, n32 cacheSize = VERTEX_CACHE_SIZE);
+
+// splits the cache optimized triangle order into clusters and draws outward facing clusters first, keeps cache locality inside clusters
+void OptimizeOverdraw(n32* indices, size_t indexCount, const f32* positions, size_t positionStride, n32 vertexCount,
+                      n32 cacheSize = VERTEX_CACHE_SIZE);
+
+static constexpr n32 MESHLET_MAX_VERTICES = 64;
+static constexpr n32 MESHLET_MAX_TRIANGLES = 124;
+
+// a contiguous range of a primitive's index stream, bounds are in mesh space
+struct Meshlet
+{
+    n32 firstIndex; // relative to the primitive's first index
+    n32 indexCount;
+    f32 center[3];
+    f32 radius;
+    f32 coneAxis[3];
+    f32 coneCutoff; // sine of the normal cone's half angle, 1.0 if the cone can't be culled
+};
+
+// reorders triangles so each meshlet is a contiguous index range, grows meshlets through shared vertices from the current triangle order
+void BuildMeshlets(n32* indices, size_t indexCount, const f32* positions, size_t positionStride, n32 vertexCount, std::vector<Meshlet>& meshlets,
+                   n32 maxVertices = MESHLET_MAX_VERTICES, n32 maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// runs OptimizeVertexCache on every meshlet's own index range, meshlets keep their triangles and their bounds stay valid.
+// BuildMeshlets picks triangles by adjacency and distance, this gets the cache order back afterwards
+void OptimizeMeshlets(n32* indices, const Meshlet* meshlets, size_t meshletCount, n32 cacheSize = VERTEX_CACHE_SIZE);
+
+// vertex streams the simplifier reads, all of them share one stride
+struct SimplifyVertexData
+{
+    const f32* positions = nullptr;
+    const f32* normals = nullptr; // optional
+    const f32* uvs = nullptr;     // optional
+    size_t     stride = 0;
+    n32        vertexCount = 0;
+    // error in mesh units that a unit change of the attribute counts as
+    f32 normalWeight = 0.0f;
+    f32 uvWeight = 0.0f;
+};
+
+// quadric error metric edge collapse (Garland and Heckbert 1997). vertices are only ever collapsed onto other existing vertices, so the
+// result indexes the same vertex range as the input. open borders and uv/normal seams are preserved.
+// stops at targetIndexCount or once the next collapse would exceed targetError, returns the error of the result in mesh units
+f32 SimplifyMesh(const n32* indices, size_t indexCount, const SimplifyVertexData& vertices, size_t targetIndexCount, f32 targetError,
+                 std::vector<n32>& destination);
+
+// merges bitwise equal vertices, returns the new vertex count. needs std::hash and operator== for the vertex type
+template <typename Vertex> n32 WeldVertices(Vertex* vertices, n32 vertexCount, n32* indices, size_t indexCount)
+{
+    std::unordered_map<Vertex, n32> unique;
+    unique.reserve(vertexCount);
+
+    std::vector<n32> remap(vertexCount);
+    n32              uniqueCount = 0;
+    for(n32 v = 0; v < vertexCount; v++)
+    {
+        auto [it, inserted] = unique.emplace(vertices[v], uniqueCount);
+        if(inserted) { vertices[uniqueCount++] = vertices[v]; }
+        remap[v] = it->second;
+    }
+
+    for(size_t i = 0; i < indexCount; i++) { indices[i] = remap[indices[i]]; }
+    return uniqueCount;
+}
+
+// orders vertices by first use in the index stream, unreferenced vertices are dropped. returns the new vertex count
+template <typename Vertex> n32 OptimizeVertexFetch(Vertex* vertices, n32 vertexCount, n32* indices, size_t indexCount)
+{
+    constexpr n32    unused = ~0u;
+    std::vector<n32> remap(vertexCount, unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertexCount);
+
+    for(size_t i = 0; i < indexCount; i++)
+    {
+        n32& target = remap[indices[i]];
+        if(target == unused)
+        {
+            target = static_cast<n32>(reordered.size());
+            reordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = target;
+    }
+
+    for(size_t v = 0; v < reordered.size(); v++) { vertices[v] = reordered[v]; }
+    return static_cast<n32>(reordered.size());
+}
+
+} // namespace Utils
+} // namespace Humongous
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "defines.hpp"
+#include <cstddef>
+
+namespace Humongous
+{
+namespace Utils
+{
+/***
+ * Cpu side mip chains for 8 bit RGBA images. Every level is filtered from the one above it in floating point, separably,
+ * so the chain comes out in one go and can be copied into the image with a single multi region copy.
+ * Levels are stored one after the other, level 0 first, each one tightly packed.
+ * */
+
+enum class MipContent : n8
+{
+    COLOR,  // sRGB encoded color, filtered in linear space. alpha is always linear
+    LINEAR, // data that is filtered as stored, like metallic roughness or occlusion
+    NORMAL, // tangent space normals, renormalized on every level
+};
+
+enum class MipFilter : n8
+{
+    BOX,    // averages the texels a destination texel covers
+    KAISER, // Kaiser windowed sinc, keeps the smaller levels sharper than the box
+};
+
+n32 GetMipLevelCount(n32 width, n32 height);
+// byte offset of a level in the chain, the offset of level GetMipLevelCount is the size of the whole chain
+size_t GetMipLevelOffset(n32 width, n32 height, n32 level);
+size_t GetMipChainSize(n32 width, n32 height);
+
+// writes the whole chain to out, level 0 is copied from rgba as is. rgba may point at the start of out
+void BuildMipChain(const n8* rgba, n32 width, n32 height, MipContent content, MipFilter filter, n8* out);
+
+} // namespace Utils
+} // namespace Humongous
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "defines.hpp"
+#include "mip_builder.hpp"
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace Humongous
+{
+namespace Utils
+{
+/***
+ * Import time block compression of 8 bit RGBA images. The mip chain is built on the cpu (see BuildMipChain) and every level is
+ * compressed on its own, so the result can be copied into the image as is. Which BC format is used, and how the mips are filtered,
+ * depends on what the image is sampled as, see TextureRole.
+ * */
+
+enum class TextureRole : n8
+{
+    COLOR,     // sRGB color, BC1 or BC3 if any pixel isn't fully opaque
+    DATA,      // linear data like metallic roughness, compressed the same way as color
+    NORMAL,    // BC5, only x and y are kept, the shader rebuilds z
+    OCCLUSION, // BC4, only the red channel is kept
+};
+
+struct CompressedImage
+{
+    VkFormat                  format = VK_FORMAT_UNDEFINED;
+    n32                       width = 0;
+    n32                       height = 0;
+    std::vector<VkDeviceSize> levelOffsets; // into data, level 0 first
+    std::vector<VkDeviceSize> levelSizes;
+    std::vector<n8>           data;
+
+    bool IsValid() const { return format != VK_FORMAT_UNDEFINED && !levelSizes.empty(); }
+    n32  GetLevelCount() const { return static_cast<n32>(levelSizes.size()); }
+};
+
+// bytes per 4x4 block of one of the formats CompressImage produces
+n32 GetBlockSize(VkFormat format);
+
+MipContent GetMipContent(TextureRole role);
+
+CompressedImage CompressImage(const n8* rgba, n32 width, n32 height, TextureRole role, MipFilter mipFilter);
+
+// expands BC1 to BC5 blocks back into 8 bit RGBA, for devices that can't sample them. returns false for any other format
+bool DecompressImage(VkFormat format, const n8* blocks, n32 width, n32 height, n8* rgba);
+
+} // namespace Utils
+} // namespace Humongous
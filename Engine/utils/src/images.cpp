@@ -1,6 +1,12 @@
 #include "images.hpp"
 #include "logger.hpp"
 
+// every x86-64 target has SSE2, so the wide path is always built there
+#if defined(__SSE2__) || defined(_M_X64)
+#define HG_IMAGES_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace Humongous
 {
 namespace Utils
@@ -221,13 +227,47 @@ void CopyBufferToImage(LogicalDevice& logicalDevice, VkBuffer buffer, VkImage im
 void CopyBufferToImage(LogicalDevice& logicalDevice, VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy>& bufferCopyRegions)
 {
     VkCommandBuffer commandBuffer = logicalDevice.BeginSingleTimeCommands();
+    CopyBufferToImage(commandBuffer, buffer, image, bufferCopyRegions);
+    logicalDevice.EndSingleTimeCommands(commandBuffer);
+}
 
+void CopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy>& bufferCopyRegions)
+{
     // vkCmdCopyBufferToImage2(commandBuffer, );
 
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<n32>(bufferCopyRegions.size()),
+    vkCmdCopyBufferToImage(cmd, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<n32>(bufferCopyRegions.size()),
                            bufferCopyRegions.data());
+}
 
-    logicalDevice.EndSingleTimeCommands(commandBuffer);
+void ExpandRGBToRGBA(const n8* rgb, n8* rgba, size_t pixelCount)
+{
+    size_t i = 0;
+
+#ifdef HG_IMAGES_SSE2
+    // 4 pixels per iteration. each load reads 16 bytes but only uses 12, so stop while the remaining input still covers it.
+    // shifting the whole register left by k bytes lines pixel k up with its 32 bit lane, a mask then keeps just that pixel's 3 bytes
+    const __m128i lane0 = _mm_setr_epi32(0x00FFFFFF, 0, 0, 0);
+    const __m128i lane1 = _mm_setr_epi32(0, 0x00FFFFFF, 0, 0);
+    const __m128i lane2 = _mm_setr_epi32(0, 0, 0x00FFFFFF, 0);
+    const __m128i lane3 = _mm_setr_epi32(0, 0, 0, 0x00FFFFFF);
+    const __m128i alpha = _mm_set1_epi32(static_cast<s32>(0xFF000000u));
+    for(; i + 6 <= pixelCount; i += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+        __m128i       expanded = _mm_or_si128(_mm_and_si128(pixels, lane0), _mm_and_si128(_mm_slli_si128(pixels, 1), lane1));
+        expanded = _mm_or_si128(expanded, _mm_and_si128(_mm_slli_si128(pixels, 2), lane2));
+        expanded = _mm_or_si128(expanded, _mm_and_si128(_mm_slli_si128(pixels, 3), lane3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), _mm_or_si128(expanded, alpha));
+    }
+#endif
+
+    for(; i < pixelCount; i++)
+    {
+        rgba[i * 4 + 0] = rgb[i * 3 + 0];
+        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+        rgba[i * 4 + 3] = 0xFF;
+    }
 }
 
 } // namespace Utils
@@ -0,0 +1,847 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+
+namespace Humongous::Utils
+{
+
+// vertex -> triangle adjacency, the triangles using vertex v are triangles[offsets[v]] up to triangles[offsets[v + 1]]
+struct TriangleAdjacency
+{
+    std::vector<n32> offsets;
+    std::vector<n32> triangles;
+};
+
+static void BuildTriangleAdjacency(const n32* indices, size_t indexCount, n32 vertexCount, TriangleAdjacency& adjacency)
+{
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    for(size_t i = 0; i < indexCount; i++) { adjacency.offsets[indices[i] + 1]++; }
+    for(n32 v = 0; v < vertexCount; v++) { adjacency.offsets[v + 1] += adjacency.offsets[v]; }
+
+    adjacency.triangles.resize(indexCount);
+    std::vector<n32> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for(size_t i = 0; i < indexCount; i++) { adjacency.triangles[fill[indices[i]]++] = static_cast<n32>(i / 3); }
+}
+
+VertexCacheStats AnalyzeVertexCache(const n32* indices, size_t indexCount, n32 vertexCount, n32 cacheSize)
+{
+    VertexCacheStats stats{};
+    stats.triangles = static_cast<n32>(indexCount / 3);
+
+    // a vertex is in the cache if it entered less than cacheSize misses ago
+    std::vector<n32> timestamps(vertexCount, 0);
+    std::vector<b8>  referenced(vertexCount, 0);
+    n32              time = cacheSize + 1;
+
+    for(size_t i = 0; i < indexCount; i++)
+    {
+        n32 index = indices[i];
+        if(!referenced[index])
+        {
+            referenced[index] = 1;
+            stats.vertices++;
+        }
+
+        if(time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            stats.misses++;
+        }
+    }
+
+    return stats;
+}
+
+void OptimizeVertexCache(n32* indices, size_t indexCount, n32 vertexCount, n32 cacheSize)
+{
+    const n32 triangleCount = static_cast<n32>(indexCount / 3);
+    if(triangleCount == 0 || vertexCount == 0) { return; }
+
+    TriangleAdjacency adjacency;
+    BuildTriangleAdjacency(indices, indexCount, vertexCount, adjacency);
+
+    std::vector<n32> liveTriangles(vertexCount, 0);
+    for(n32 v = 0; v < vertexCount; v++) { liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v]; }
+
+    std::vector<n32> cacheTime(vertexCount, 0);
+    std::vector<b8>  emitted(triangleCount, 0);
+    std::vector<n32> deadEnd;
+    std::vector<n32> candidates;
+    std::vector<n32> output;
+    deadEnd.reserve(indexCount);
+    output.reserve(indexCount);
+
+    n32 time = cacheSize + 1;
+    n32 cursor = 0;
+    s64 fanning = 0;
+
+    while(fanning >= 0)
+    {
+        const n32 vertex = static_cast<n32>(fanning);
+        candidates.clear();
+
+        // emit every remaining triangle around the fanning vertex
+        for(n32 a = adjacency.offsets[vertex]; a < adjacency.offsets[vertex + 1]; a++)
+        {
+            n32 t = adjacency.triangles[a];
+            if(emitted[t]) { continue; }
+            emitted[t] = 1;
+
+            for(n32 k = 0; k < 3; k++)
+            {
+                n32 v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+
+                if(time - cacheTime[v] > cacheSize) { cacheTime[v] = time++; }
+            }
+        }
+
+        // next fanning vertex: the candidate that is still in the cache and stays there for all of its remaining triangles
+        s64 best = -1;
+        s64 bestPriority = -1;
+        for(n32 v: candidates)
+        {
+            if(liveTriangles[v] == 0) { continue; }
+
+            s64 priority = 0;
+            if(static_cast<s64>(time) - cacheTime[v] + 2 * static_cast<s64>(liveTriangles[v]) <= cacheSize) { priority = time - cacheTime[v]; }
+            if(priority > bestPriority)
+            {
+                best = v;
+                bestPriority = priority;
+            }
+        }
+
+        // dead end, fall back to a recently used vertex and then to the next one in input order
+        while(best < 0 && !deadEnd.empty())
+        {
+            n32 v = deadEnd.back();
+            deadEnd.pop_back();
+            if(liveTriangles[v] > 0) { best = v; }
+        }
+        while(best < 0 && cursor < vertexCount)
+        {
+            if(liveTriangles[cursor] > 0) { best = cursor; }
+            cursor++;
+        }
+
+        fanning = best;
+    }
+
+    std::memcpy(indices, output.data(), output.size() * sizeof(n32));
+}
+
+void OptimizeOverdraw(n32* indices, size_t indexCount, const f32* positions, size_t positionStride, n32 vertexCount, n32 cacheSize)
+{
+    const n32 triangleCount = static_cast<n32>(indexCount / 3);
+    if(triangleCount < 2) { return; }
+
+    auto position = [&](n32 v) { return reinterpret_cast<const f32*>(reinterpret_cast<const n8*>(positions) + v * positionStride); };
+
+    // a triangle that misses the cache with all three vertices is where the cache optimizer jumped, clusters start there
+    std::vector<n32> clusters;
+    {
+        std::vector<n32> timestamps(vertexCount, 0);
+        n32              time = cacheSize + 1;
+        for(n32 t = 0; t < triangleCount; t++)
+        {
+            n32 misses = 0;
+            for(n32 k = 0; k < 3; k++)
+            {
+                n32 v = indices[t * 3 + k];
+                if(time - timestamps[v] > cacheSize)
+                {
+                    timestamps[v] = time++;
+                    misses++;
+                }
+            }
+            if(t == 0 || misses == 3) { clusters.push_back(t); }
+        }
+    }
+    if(clusters.size() < 2) { return; }
+
+    // mesh centroid, weighted by triangle area
+    f32 meshCentroid[3]{};
+    f32 meshArea = 0.0f;
+    for(n32 t = 0; t < triangleCount; t++)
+    {
+        const f32* a = position(indices[t * 3 + 0]);
+        const f32* b = position(indices[t * 3 + 1]);
+        const f32* c = position(indices[t * 3 + 2]);
+
+        f32 e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        f32 e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        f32 n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        f32 area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+        for(n32 k = 0; k < 3; k++) { meshCentroid[k] += area * (a[k] + b[k] + c[k]) / 3.0f; }
+        meshArea += area;
+    }
+    if(meshArea > 0.0f)
+    {
+        for(f32& c: meshCentroid) { c /= meshArea; }
+    }
+
+    // clusters that face away from the center are likely to occlude the rest, draw them first
+    struct ClusterSort
+    {
+        n32 begin;
+        n32 end;
+        f32 key;
+    };
+
+    std::vector<ClusterSort> sorted(clusters.size());
+    for(size_t c = 0; c < clusters.size(); c++)
+    {
+        n32 begin = clusters[c];
+        n32 end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+        f32 centroid[3]{};
+        f32 normal[3]{};
+        f32 area = 0.0f;
+        for(n32 t = begin; t < end; t++)
+        {
+            const f32* a = position(indices[t * 3 + 0]);
+            const f32* b = position(indices[t * 3 + 1]);
+            const f32* p = position(indices[t * 3 + 2]);
+
+            f32 e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            f32 e2[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+            f32 n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            f32 triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for(n32 k = 0; k < 3; k++)
+            {
+                centroid[k] += triangleArea * (a[k] + b[k] + p[k]) / 3.0f;
+                normal[k] += n[k];
+            }
+            area += triangleArea;
+        }
+
+        f32 key = 0.0f;
+        if(area > 0.0f)
+        {
+            f32 normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if(normalLength > 0.0f)
+            {
+                for(n32 k = 0; k < 3; k++) { key += (centroid[k] / area - meshCentroid[k]) * normal[k] / normalLength; }
+            }
+        }
+
+        sorted[c] = {begin, end, key};
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const ClusterSort& a, const ClusterSort& b) { return a.key > b.key; });
+
+    std::vector<n32> output;
+    output.reserve(indexCount);
+    for(const ClusterSort& cluster: sorted) { output.insert(output.end(), indices + cluster.begin * 3, indices + cluster.end * 3); }
+
+    std::memcpy(indices, output.data(), output.size() * sizeof(n32));
+}
+
+static void ComputeMeshletBounds(Meshlet& meshlet, const n32* indices, const f32* positions, size_t positionStride)
+{
+    auto position = [&](n32 v) { return reinterpret_cast<const f32*>(reinterpret_cast<const n8*>(positions) + v * positionStride); };
+
+    // bounding sphere around the center of the vertex bounds
+    f32 min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    f32 max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for(n32 i = 0; i < meshlet.indexCount; i++)
+    {
+        const f32* p = position(indices[meshlet.firstIndex + i]);
+        for(n32 k = 0; k < 3; k++)
+        {
+            min[k] = std::min(min[k], p[k]);
+            max[k] = std::max(max[k], p[k]);
+        }
+    }
+
+    f32 radiusSquared = 0.0f;
+    for(n32 k = 0; k < 3; k++) { meshlet.center[k] = (min[k] + max[k]) * 0.5f; }
+    for(n32 i = 0; i < meshlet.indexCount; i++)
+    {
+        const f32* p = position(indices[meshlet.firstIndex + i]);
+        f32        d[3] = {p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2]};
+        radiusSquared = std::max(radiusSquared, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    }
+    meshlet.radius = std::sqrt(radiusSquared);
+
+    // normal cone, the axis is the average of the unit triangle normals and the cutoff the widest angle to any of them
+    std::vector<f32> normals;
+    normals.reserve(meshlet.indexCount);
+    f32 axis[3]{};
+    for(n32 i = 0; i < meshlet.indexCount; i += 3)
+    {
+        const f32* a = position(indices[meshlet.firstIndex + i + 0]);
+        const f32* b = position(indices[meshlet.firstIndex + i + 1]);
+        const f32* c = position(indices[meshlet.firstIndex + i + 2]);
+
+        f32 e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        f32 e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        f32 n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        f32 length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if(length <= 0.0f) { continue; } // degenerate triangles are never visible
+
+        for(n32 k = 0; k < 3; k++)
+        {
+            normals.push_back(n[k] / length);
+            axis[k] += n[k] / length;
+        }
+    }
+
+    meshlet.coneCutoff = 1.0f;
+    for(n32 k = 0; k < 3; k++) { meshlet.coneAxis[k] = 0.0f; }
+
+    f32 axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    if(axisLength <= 0.0f) { return; }
+    for(n32 k = 0; k < 3; k++) { axis[k] /= axisLength; }
+
+    f32 minDot = 1.0f;
+    for(size_t i = 0; i < normals.size(); i += 3)
+    {
+        minDot = std::min(minDot, axis[0] * normals[i] + axis[1] * normals[i + 1] + axis[2] * normals[i + 2]);
+    }
+
+    for(n32 k = 0; k < 3; k++) { meshlet.coneAxis[k] = axis[k]; }
+    // a cone of 90 degrees or wider has triangles facing every direction
+    if(minDot > 0.0f) { meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot); }
+}
+
+void BuildMeshlets(n32* indices, size_t indexCount, const f32* positions, size_t positionStride, n32 vertexCount, std::vector<Meshlet>& meshlets,
+                   n32 maxVertices, n32 maxTriangles)
+{
+    const n32 triangleCount = static_cast<n32>(indexCount / 3);
+    if(triangleCount == 0 || vertexCount == 0) { return; }
+
+    auto position = [&](n32 v) { return reinterpret_cast<const f32*>(reinterpret_cast<const n8*>(positions) + v * positionStride); };
+
+    TriangleAdjacency adjacency;
+    BuildTriangleAdjacency(indices, indexCount, vertexCount, adjacency);
+
+    constexpr n32    none = ~0u;
+    std::vector<n32> vertexMeshlet(vertexCount, none); // last meshlet a vertex was added to
+    std::vector<b8>  emitted(triangleCount, 0);
+    std::vector<n32> meshletVertices;
+    std::vector<n32> output;
+    meshletVertices.reserve(maxVertices);
+    output.reserve(indexCount);
+
+    const size_t firstMeshlet = meshlets.size();
+    n32          meshletId = 0;
+    n32          meshletTriangles = 0;
+    n32          meshletStart = 0;
+    f32          vertexSum[3]{};
+    n32          cursor = 0;
+
+    auto newVertices = [&](n32 t)
+    {
+        n32 count = 0;
+        for(n32 k = 0; k < 3; k++) { count += vertexMeshlet[indices[t * 3 + k]] != meshletId; }
+        return count;
+    };
+
+    auto distanceToMeshlet = [&](n32 t)
+    {
+        f32 distance = 0.0f;
+        for(n32 k = 0; k < 3; k++)
+        {
+            f32 centroid = (position(indices[t * 3 + 0])[k] + position(indices[t * 3 + 1])[k] + position(indices[t * 3 + 2])[k]) / 3.0f;
+            f32 d = centroid - vertexSum[k] / static_cast<f32>(meshletVertices.size());
+            distance += d * d;
+        }
+        return distance;
+    };
+
+    auto finishMeshlet = [&]()
+    {
+        if(meshletTriangles == 0) { return; }
+
+        Meshlet meshlet{};
+        meshlet.firstIndex = meshletStart;
+        meshlet.indexCount = meshletTriangles * 3;
+        meshlets.push_back(meshlet);
+
+        meshletId++;
+        meshletTriangles = 0;
+        meshletStart = static_cast<n32>(output.size());
+        meshletVertices.clear();
+        for(f32& s: vertexSum) { s = 0.0f; }
+    };
+
+    for(n32 emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        // prefer triangles that share the most vertices with the meshlet, then the ones closest to it
+        s64 best = -1;
+        n32 bestNew = 4;
+        f32 bestDistance = FLT_MAX;
+        for(n32 v: meshletVertices)
+        {
+            for(n32 a = adjacency.offsets[v]; a < adjacency.offsets[v + 1]; a++)
+            {
+                n32 t = adjacency.triangles[a];
+                if(emitted[t]) { continue; }
+
+                n32 added = newVertices(t);
+                if(meshletVertices.size() + added > maxVertices) { continue; }
+
+                f32 distance = distanceToMeshlet(t);
+                if(added < bestNew || (added == bestNew && distance < bestDistance))
+                {
+                    best = t;
+                    bestNew = added;
+                    bestDistance = distance;
+                }
+            }
+        }
+
+        // nothing connected is left, continue with the nearest of the next few triangles in input order
+        if(best < 0)
+        {
+            while(emitted[cursor]) { cursor++; }
+
+            n32 candidates = 0;
+            for(n32 t = cursor; t < triangleCount && candidates < 16; t++)
+            {
+                if(emitted[t]) { continue; }
+                candidates++;
+
+                if(meshletVertices.empty())
+                {
+                    best = t;
+                    break;
+                }
+
+                n32 added = newVertices(t);
+                if(meshletVertices.size() + added > maxVertices) { continue; }
+
+                f32 distance = distanceToMeshlet(t);
+                if(distance < bestDistance)
+                {
+                    best = t;
+                    bestDistance = distance;
+                }
+            }
+        }
+
+        // meshlet is full
+        if(best < 0)
+        {
+            finishMeshlet();
+            best = cursor;
+        }
+
+        const n32 t = static_cast<n32>(best);
+        emitted[t] = 1;
+        for(n32 k = 0; k < 3; k++)
+        {
+            n32 v = indices[t * 3 + k];
+            output.push_back(v);
+
+            if(vertexMeshlet[v] != meshletId)
+            {
+                vertexMeshlet[v] = meshletId;
+                meshletVertices.push_back(v);
+                for(n32 c = 0; c < 3; c++) { vertexSum[c] += position(v)[c]; }
+            }
+        }
+
+        if(++meshletTriangles == maxTriangles) { finishMeshlet(); }
+    }
+    finishMeshlet();
+
+    std::memcpy(indices, output.data(), output.size() * sizeof(n32));
+    for(size_t m = firstMeshlet; m < meshlets.size(); m++) { ComputeMeshletBounds(meshlets[m], indices, positions, positionStride); }
+}
+
+void OptimizeMeshlets(n32* indices, const Meshlet* meshlets, size_t meshletCount, n32 cacheSize)
+{
+    std::vector<n32> local;
+    std::vector<n32> vertices;
+    for(size_t m = 0; m < meshletCount; m++)
+    {
+        n32* meshletIndices = indices + meshlets[m].firstIndex;
+        const n32 indexCount = meshlets[m].indexCount;
+
+        // a meshlet only has a few dozen vertices, numbering them locally keeps Tipsify from walking the whole primitive's
+        vertices.clear();
+        local.resize(indexCount);
+        for(n32 i = 0; i < indexCount; i++)
+        {
+            auto it = std::find(vertices.begin(), vertices.end(), meshletIndices[i]);
+            local[i] = static_cast<n32>(it - vertices.begin());
+            if(it == vertices.end()) { vertices.push_back(meshletIndices[i]); }
+        }
+
+        OptimizeVertexCache(local.data(), indexCount, static_cast<n32>(vertices.size()), cacheSize);
+        for(n32 i = 0; i < indexCount; i++) { meshletIndices[i] = vertices[local[i]]; }
+    }
+}
+
+// Q(p) = p^T A p + 2 b^T p + c, summed over weighted planes. weight is the triangle area the error gets averaged over
+struct Quadric
+{
+    f64 a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    f64 b0 = 0, b1 = 0, b2 = 0;
+    f64 c = 0;
+    f64 weight = 0;
+
+    void AddPlane(const f64 n[3], f64 d, f64 w)
+    {
+        a00 += w * n[0] * n[0];
+        a01 += w * n[0] * n[1];
+        a02 += w * n[0] * n[2];
+        a11 += w * n[1] * n[1];
+        a12 += w * n[1] * n[2];
+        a22 += w * n[2] * n[2];
+        b0 += w * n[0] * d;
+        b1 += w * n[1] * d;
+        b2 += w * n[2] * d;
+        c += w * d * d;
+    }
+
+    Quadric& operator+=(const Quadric& other)
+    {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+
+    // mean squared distance of p to the planes
+    f64 Evaluate(const f32* p) const
+    {
+        f64 x = p[0], y = p[1], z = p[2];
+        f64 result = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2.0 * (b0 * x + b1 * y + b2 * z);
+        result += c;
+        return weight > 0.0 ? std::abs(result) / weight : 0.0;
+    }
+};
+
+struct PositionKey
+{
+    n32 x, y, z;
+
+    bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct PositionKeyHash
+{
+    size_t operator()(const PositionKey& key) const { return (key.x * 73856093u) ^ (key.y * 19349663u) ^ (key.z * 83492791u); }
+};
+
+static n64 EdgeKey(n32 a, n32 b) { return static_cast<n64>(a) << 32 | b; }
+
+static void Cross(const f32* a, const f32* b, const f32* c, f64 n[3])
+{
+    f64 e1[3] = {static_cast<f64>(b[0]) - a[0], static_cast<f64>(b[1]) - a[1], static_cast<f64>(b[2]) - a[2]};
+    f64 e2[3] = {static_cast<f64>(c[0]) - a[0], static_cast<f64>(c[1]) - a[1], static_cast<f64>(c[2]) - a[2]};
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+f32 SimplifyMesh(const n32* indices, size_t indexCount, const SimplifyVertexData& vertices, size_t targetIndexCount, f32 targetError,
+                 std::vector<n32>& destination)
+{
+    destination.assign(indices, indices + indexCount);
+
+    const n32 vertexCount = vertices.vertexCount;
+    if(indexCount < 3 || vertexCount == 0) { return 0.0f; }
+
+    auto stream = [&](const f32* base, n32 v) { return reinterpret_cast<const f32*>(reinterpret_cast<const n8*>(base) + v * vertices.stride); };
+    auto position = [&](n32 v) { return stream(vertices.positions, v); };
+
+    // vertices with the same position are collapsed together, the copies (wedges) only differ in their attributes
+    std::vector<n32> positionOf(vertexCount);
+    std::vector<n32> nextWedge(vertexCount);
+    {
+        std::unordered_map<PositionKey, n32, PositionKeyHash> unique;
+        unique.reserve(vertexCount);
+        for(n32 v = 0; v < vertexCount; v++)
+        {
+            PositionKey key;
+            std::memcpy(&key, position(v), sizeof(key));
+            auto [it, inserted] = unique.emplace(key, v);
+            positionOf[v] = it->second;
+
+            // circular list through every wedge of a position
+            nextWedge[v] = v;
+            if(!inserted)
+            {
+                nextWedge[v] = nextWedge[it->second];
+                nextWedge[it->second] = v;
+            }
+        }
+    }
+
+    // plane quadrics of the adjacent triangles, open edges additionally get a plane perpendicular to their triangle to keep borders in place
+    std::vector<Quadric> quadrics(vertexCount);
+    std::unordered_set<n64> positionEdges;
+    positionEdges.reserve(indexCount);
+    for(size_t i = 0; i < indexCount; i += 3)
+    {
+        for(n32 k = 0; k < 3; k++) { positionEdges.insert(EdgeKey(positionOf[indices[i + k]], positionOf[indices[i + (k + 1) % 3]])); }
+    }
+
+    std::vector<n32> borderEdges(vertexCount, 0);
+    for(size_t i = 0; i < indexCount; i += 3)
+    {
+        n32 p[3] = {positionOf[indices[i]], positionOf[indices[i + 1]], positionOf[indices[i + 2]]};
+        f64 n[3];
+        Cross(position(p[0]), position(p[1]), position(p[2]), n);
+        f64 length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if(length <= 0.0) { continue; }
+        for(f64& c: n) { c /= length; }
+
+        const f32* p0 = position(p[0]);
+        f64        d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        for(n32 k = 0; k < 3; k++)
+        {
+            quadrics[p[k]].AddPlane(n, d, length * 0.5);
+            quadrics[p[k]].weight += length * 0.5;
+        }
+
+        for(n32 k = 0; k < 3; k++)
+        {
+            n32 a = p[k], b = p[(k + 1) % 3];
+            if(positionEdges.count(EdgeKey(b, a))) { continue; }
+
+            borderEdges[a]++;
+            borderEdges[b]++;
+
+            const f32* pa = position(a);
+            const f32* pb = position(b);
+            f64        edge[3] = {static_cast<f64>(pb[0]) - pa[0], static_cast<f64>(pb[1]) - pa[1], static_cast<f64>(pb[2]) - pa[2]};
+            f64        edgeLength = std::sqrt(edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2]);
+            if(edgeLength <= 0.0) { continue; }
+
+            f64 plane[3] = {edge[1] * n[2] - edge[2] * n[1], edge[2] * n[0] - edge[0] * n[2], edge[0] * n[1] - edge[1] * n[0]};
+            for(f64& c: plane) { c /= edgeLength; }
+            f64 planeDistance = -(plane[0] * pa[0] + plane[1] * pa[1] + plane[2] * pa[2]);
+
+            constexpr f64 borderWeight = 10.0;
+            quadrics[a].AddPlane(plane, planeDistance, edgeLength * edgeLength * borderWeight);
+            quadrics[b].AddPlane(plane, planeDistance, edgeLength * edgeLength * borderWeight);
+        }
+    }
+
+    enum VertexKind : n8
+    {
+        KIND_MANIFOLD, // moves anywhere
+        KIND_BORDER,   // moves along its border
+        KIND_SEAM,     // two wedges, moves along the seam
+        KIND_LOCKED
+    };
+
+    std::vector<n8> kinds(vertexCount, KIND_LOCKED);
+    for(n32 v = 0; v < vertexCount; v++)
+    {
+        if(positionOf[v] != v) { continue; }
+
+        n32 wedges = 1;
+        for(n32 w = nextWedge[v]; w != v; w = nextWedge[w]) { wedges++; }
+
+        if(borderEdges[v] == 0 && wedges <= 2) { kinds[v] = wedges == 1 ? KIND_MANIFOLD : KIND_SEAM; }
+        else if(borderEdges[v] == 2 && wedges == 1) { kinds[v] = KIND_BORDER; }
+    }
+
+    struct Collapse
+    {
+        n32 from; // positions
+        n32 to;
+        f64 cost;
+    };
+
+    const f64 errorLimit = targetError > 0.0f ? static_cast<f64>(targetError) * targetError : 0.0;
+    f64       resultError = 0.0;
+
+    std::unordered_set<n64> attributeEdges;
+    std::vector<Collapse>   collapses;
+    std::vector<n32>        positionIndices;
+    std::vector<n32>        remap(vertexCount);
+    std::vector<b8>         touched(vertexCount);
+    TriangleAdjacency       adjacency;
+
+    // every wedge of from needs a wedge of to it shares an edge with, otherwise the collapse would tear a seam open
+    auto mapWedges = [&](n32 from, n32 to, f64* attributeError) {
+        f64 error = 0.0;
+        n32 w = from;
+        do
+        {
+            s64 target = -1;
+            n32 u = to;
+            do
+            {
+                if(attributeEdges.count(EdgeKey(std::min(w, u), std::max(w, u))))
+                {
+                    target = u;
+                    break;
+                }
+                u = nextWedge[u];
+            } while(u != to);
+            if(target < 0) { return false; }
+
+            remap[w] = static_cast<n32>(target);
+            if(vertices.normals)
+            {
+                const f32* a = stream(vertices.normals, w);
+                const f32* b = stream(vertices.normals, static_cast<n32>(target));
+                f64        d = (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+                error += d * vertices.normalWeight * vertices.normalWeight;
+            }
+            if(vertices.uvs)
+            {
+                const f32* a = stream(vertices.uvs, w);
+                const f32* b = stream(vertices.uvs, static_cast<n32>(target));
+                f64        d = (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]);
+                error += d * vertices.uvWeight * vertices.uvWeight;
+            }
+            w = nextWedge[w];
+        } while(w != from);
+
+        if(attributeError) { *attributeError = error; }
+        return true;
+    };
+
+    auto canCollapse = [&](n32 from, n32 to) {
+        switch(kinds[from])
+        {
+            case KIND_MANIFOLD:
+                return true;
+            case KIND_BORDER:
+                return (kinds[to] == KIND_BORDER || kinds[to] == KIND_LOCKED) &&
+                       positionEdges.count(EdgeKey(from, to)) != positionEdges.count(EdgeKey(to, from));
+            case KIND_SEAM:
+                return kinds[to] == KIND_SEAM || kinds[to] == KIND_LOCKED;
+            default:
+                return false;
+        }
+    };
+
+    size_t triangleCount = indexCount / 3;
+    while(triangleCount * 3 > targetIndexCount)
+    {
+        attributeEdges.clear();
+        attributeEdges.reserve(destination.size());
+        positionIndices.resize(destination.size());
+        for(size_t i = 0; i < destination.size(); i += 3)
+        {
+            for(n32 k = 0; k < 3; k++)
+            {
+                n32 a = destination[i + k], b = destination[i + (k + 1) % 3];
+                attributeEdges.insert(EdgeKey(std::min(a, b), std::max(a, b)));
+                positionIndices[i + k] = positionOf[a];
+            }
+        }
+        BuildTriangleAdjacency(positionIndices.data(), positionIndices.size(), vertexCount, adjacency);
+
+        collapses.clear();
+        for(size_t i = 0; i < positionIndices.size(); i += 3)
+        {
+            for(n32 k = 0; k < 3; k++)
+            {
+                n32 a = positionIndices[i + k], b = positionIndices[i + (k + 1) % 3];
+                for(n32 direction = 0; direction < 2; direction++)
+                {
+                    n32 from = direction ? b : a;
+                    n32 to = direction ? a : b;
+                    f64 attributeError = 0.0;
+                    if(from == to || !canCollapse(from, to) || !mapWedges(from, to, &attributeError)) { continue; }
+
+                    Quadric merged = quadrics[from];
+                    merged += quadrics[to];
+                    collapses.push_back({from, to, merged.Evaluate(position(to)) + attributeError});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        // collapses in one pass never share a triangle, so their flip checks and triangle counts stay valid
+        for(n32 v = 0; v < vertexCount; v++) { remap[v] = v; }
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t collapsed = 0;
+        for(const Collapse& collapse: collapses)
+        {
+            if(triangleCount * 3 <= targetIndexCount || collapse.cost > errorLimit) { break; }
+            if(touched[collapse.from] || touched[collapse.to]) { continue; }
+
+            // reject collapses that flip or fold a remaining triangle
+            bool       flips = false;
+            size_t     removed = 0;
+            const f32* target = position(collapse.to);
+            for(n32 a = adjacency.offsets[collapse.from]; a < adjacency.offsets[collapse.from + 1] && !flips; a++)
+            {
+                const n32* triangle = &positionIndices[adjacency.triangles[a] * 3];
+                if(triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                {
+                    removed++;
+                    continue;
+                }
+
+                const f32* p[3] = {position(triangle[0]), position(triangle[1]), position(triangle[2])};
+                const f32* q[3] = {p[0], p[1], p[2]};
+                for(n32 k = 0; k < 3; k++)
+                {
+                    if(triangle[k] == collapse.from) { q[k] = target; }
+                }
+
+                f64 before[3], after[3];
+                Cross(p[0], p[1], p[2], before);
+                Cross(q[0], q[1], q[2], after);
+                f64 dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                f64 lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+                                        (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+                flips = dot <= 0.25 * lengths;
+            }
+            if(flips) { continue; }
+
+            mapWedges(collapse.from, collapse.to, nullptr);
+            quadrics[collapse.to] += quadrics[collapse.from];
+            resultError = std::max(resultError, collapse.cost);
+            triangleCount -= removed;
+            collapsed++;
+
+            for(n32 a = adjacency.offsets[collapse.from]; a < adjacency.offsets[collapse.from + 1]; a++)
+            {
+                const n32* triangle = &positionIndices[adjacency.triangles[a] * 3];
+                for(n32 k = 0; k < 3; k++) { touched[triangle[k]] = 1; }
+            }
+            touched[collapse.to] = 1;
+        }
+        if(collapsed == 0) { break; }
+
+        // remaps never chain within a pass since every collapse target is touched
+        size_t write = 0;
+        for(size_t i = 0; i < destination.size(); i += 3)
+        {
+            n32 a = remap[destination[i]], b = remap[destination[i + 1]], c = remap[destination[i + 2]];
+            if(positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c]) { continue; }
+            destination[write++] = a;
+            destination[write++] = b;
+            destination[write++] = c;
+        }
+        destination.resize(write);
+        triangleCount = write / 3;
+    }
+
+    return static_cast<f32>(std::sqrt(resultError));
+}
+
+} // namespace Humongous::Utils
@@ -0,0 +1,290 @@
+#include "mip_builder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define HG_MIPS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Humongous
+{
+namespace Utils
+{
+static constexpr f32 KAISER_RADIUS = 3.0f; // in destination texels
+static constexpr f32 KAISER_ALPHA = 4.0f;
+static constexpr f32 PI = 3.14159265358979f;
+
+// 12 bit linear values are plenty to land on the right 8 bit sRGB value
+static constexpr n32 LINEAR_TO_SRGB_STEPS = 4096;
+
+static const std::array<f32, 256>& GetSRGBToLinearTable()
+{
+    static const std::array<f32, 256> table = []() {
+        std::array<f32, 256> values{};
+        for(n32 i = 0; i < 256; i++)
+        {
+            const f32 srgb = static_cast<f32>(i) / 255.0f;
+            values[i] = srgb <= 0.04045f ? srgb / 12.92f : std::pow((srgb + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table;
+}
+
+static const std::array<n8, LINEAR_TO_SRGB_STEPS + 1>& GetLinearToSRGBTable()
+{
+    static const std::array<n8, LINEAR_TO_SRGB_STEPS + 1> table = []() {
+        std::array<n8, LINEAR_TO_SRGB_STEPS + 1> values{};
+        for(n32 i = 0; i <= LINEAR_TO_SRGB_STEPS; i++)
+        {
+            const f32 linear = static_cast<f32>(i) / LINEAR_TO_SRGB_STEPS;
+            const f32 srgb = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+            values[i] = static_cast<n8>(std::lround(srgb * 255.0f));
+        }
+        return values;
+    }();
+    return table;
+}
+
+static f32 BesselI0(f32 x)
+{
+    f32 sum = 1.0f, term = 1.0f;
+    for(n32 k = 1; k < 16; k++)
+    {
+        const f32 half = x / (2.0f * k);
+        term *= half * half;
+        sum += term;
+    }
+    return sum;
+}
+
+// x is in destination texels
+static f32 KaiserSinc(f32 x)
+{
+    if(std::abs(x) >= KAISER_RADIUS) { return 0.0f; }
+
+    const f32 sinc = x == 0.0f ? 1.0f : std::sin(PI * x) / (PI * x);
+    const f32 t = x / KAISER_RADIUS;
+    return sinc * BesselI0(KAISER_ALPHA * std::sqrt(1.0f - t * t)) / BesselI0(KAISER_ALPHA);
+}
+
+// the taps of every destination texel along one axis, padded to the same count. taps past the edge are folded onto the edge texel
+struct FilterTable
+{
+    n32              tapCount = 0;
+    std::vector<n32> first;
+    std::vector<f32> weights;
+};
+
+static void BuildFilterTable(n32 sourceSize, n32 destinationSize, MipFilter filter, FilterTable& table)
+{
+    const f32 scale = static_cast<f32>(sourceSize) / destinationSize;
+    const f32 radius = (filter == MipFilter::BOX ? 0.5f : KAISER_RADIUS) * scale;
+
+    table.tapCount = std::min<n32>(static_cast<n32>(std::ceil(radius * 2.0f)) + 1, sourceSize);
+    table.first.assign(destinationSize, 0);
+    table.weights.assign(static_cast<size_t>(destinationSize) * table.tapCount, 0.0f);
+
+    std::vector<f32> taps(sourceSize);
+    for(n32 d = 0; d < destinationSize; d++)
+    {
+        const f32 center = (d + 0.5f) * scale;
+        const s32 begin = static_cast<s32>(std::floor(center - radius)), end = static_cast<s32>(std::ceil(center + radius));
+
+        std::fill(taps.begin(), taps.end(), 0.0f);
+        s32 lowest = sourceSize - 1, highest = 0;
+        f32 sum = 0.0f;
+        for(s32 i = begin; i < end; i++)
+        {
+            f32 weight;
+            if(filter == MipFilter::BOX) { weight = std::max(0.0f, std::min<f32>(i + 1, center + radius) - std::max<f32>(i, center - radius)); }
+            else { weight = KaiserSinc((i + 0.5f - center) / scale); }
+            if(weight == 0.0f) { continue; }
+
+            const s32 clamped = std::clamp(i, 0, static_cast<s32>(sourceSize) - 1);
+            taps[clamped] += weight;
+            lowest = std::min(lowest, clamped);
+            highest = std::max(highest, clamped);
+            sum += weight;
+        }
+
+        const n32 first = std::min<n32>(lowest, sourceSize - table.tapCount);
+        table.first[d] = first;
+        for(n32 t = 0; t < table.tapCount && first + t <= static_cast<n32>(highest); t++)
+        {
+            table.weights[static_cast<size_t>(d) * table.tapCount + t] = taps[first + t] / sum;
+        }
+    }
+}
+
+// dst += weight * src over count floats
+static void AccumulateRow(f32* dst, const f32* src, f32 weight, size_t count)
+{
+    size_t i = 0;
+#ifdef HG_MIPS_SSE
+    const __m128 w = _mm_set1_ps(weight);
+    for(; i + 4 <= count; i += 4) { _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i)))); }
+#endif
+    for(; i < count; i++) { dst[i] += weight * src[i]; }
+}
+
+static void DecodeRow(const n8* row, n32 width, MipContent content, f32* out)
+{
+    const auto& toLinear = GetSRGBToLinearTable();
+    for(n32 x = 0; x < width; x++)
+    {
+        const n8* texel = row + x * 4;
+        f32*      decoded = out + x * 4;
+        if(content == MipContent::COLOR)
+        {
+            decoded[0] = toLinear[texel[0]];
+            decoded[1] = toLinear[texel[1]];
+            decoded[2] = toLinear[texel[2]];
+        }
+        else
+        {
+            decoded[0] = texel[0] / 255.0f;
+            decoded[1] = texel[1] / 255.0f;
+            decoded[2] = texel[2] / 255.0f;
+        }
+        decoded[3] = texel[3] / 255.0f;
+    }
+}
+
+// filters one decoded row along x, one texel is 4 floats
+static void FilterRow(const f32* row, const FilterTable& table, n32 nextWidth, f32* out)
+{
+    for(n32 x = 0; x < nextWidth; x++)
+    {
+        const f32* texel = row + static_cast<size_t>(table.first[x]) * 4;
+        const f32* weights = table.weights.data() + static_cast<size_t>(x) * table.tapCount;
+#ifdef HG_MIPS_SSE
+        __m128 sum = _mm_setzero_ps();
+        for(n32 t = 0; t < table.tapCount; t++) { sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(texel + t * 4))); }
+        _mm_storeu_ps(out + x * 4, sum);
+#else
+        for(n32 c = 0; c < 4; c++) { out[x * 4 + c] = 0.0f; }
+        for(n32 t = 0; t < table.tapCount; t++)
+        {
+            for(n32 c = 0; c < 4; c++) { out[x * 4 + c] += weights[t] * texel[t * 4 + c]; }
+        }
+#endif
+    }
+}
+
+static void EncodeRow(f32* row, n32 width, MipContent content, n8* out)
+{
+    const auto& toSRGB = GetLinearToSRGBTable();
+    for(n32 x = 0; x < width; x++)
+    {
+        f32* texel = row + x * 4;
+        if(content == MipContent::NORMAL)
+        {
+            const f32 nx = texel[0] * 2.0f - 1.0f, ny = texel[1] * 2.0f - 1.0f, nz = texel[2] * 2.0f - 1.0f;
+            const f32 length = std::sqrt(nx * nx + ny * ny + nz * nz);
+            if(length > 1e-6f)
+            {
+                texel[0] = nx / length * 0.5f + 0.5f;
+                texel[1] = ny / length * 0.5f + 0.5f;
+                texel[2] = nz / length * 0.5f + 0.5f;
+            }
+        }
+
+        for(n32 c = 0; c < 4; c++)
+        {
+            const f32 value = std::clamp(texel[c], 0.0f, 1.0f);
+            if(content == MipContent::COLOR && c != 3) { out[x * 4 + c] = toSRGB[static_cast<n32>(value * LINEAR_TO_SRGB_STEPS + 0.5f)]; }
+            else { out[x * 4 + c] = static_cast<n8>(value * 255.0f + 0.5f); }
+        }
+    }
+}
+
+// the buffers one level is filtered through, kept across levels. everything is a few rows big so it stays in cache
+struct MipScratch
+{
+    FilterTable      rowTable;
+    FilterTable      columnTable;
+    std::vector<f32> decodedRow;
+    std::vector<f32> filteredRows; // ring of rows already filtered along x, slot = source row % ring size
+    std::vector<s32> filteredRowIndices;
+    std::vector<f32> outputRow;
+};
+
+// streams the level above through a ring of x filtered rows, each output row sums the ring rows its column taps cover
+static void DownsampleLevel(const n8* source, n32 width, n32 height, n32 nextWidth, n32 nextHeight, MipContent content, MipFilter filter,
+                            MipScratch& scratch, n8* destination)
+{
+    // an axis that is already down to one texel is carried over as is, the box table does exactly that
+    BuildFilterTable(width, nextWidth, nextWidth == width ? MipFilter::BOX : filter, scratch.rowTable);
+    BuildFilterTable(height, nextHeight, nextHeight == height ? MipFilter::BOX : filter, scratch.columnTable);
+
+    const n32    ringSize = scratch.columnTable.tapCount;
+    const size_t rowFloats = static_cast<size_t>(nextWidth) * 4;
+    scratch.decodedRow.resize(static_cast<size_t>(width) * 4);
+    scratch.filteredRows.resize(rowFloats * ringSize);
+    scratch.filteredRowIndices.assign(ringSize, -1);
+    scratch.outputRow.resize(rowFloats);
+
+    for(n32 y = 0; y < nextHeight; y++)
+    {
+        std::fill(scratch.outputRow.begin(), scratch.outputRow.end(), 0.0f);
+
+        const f32* weights = scratch.columnTable.weights.data() + static_cast<size_t>(y) * ringSize;
+        for(n32 t = 0; t < ringSize; t++)
+        {
+            const s32 sourceRow = static_cast<s32>(scratch.columnTable.first[y] + t);
+            const n32 slot = sourceRow % ringSize;
+            f32*      filtered = scratch.filteredRows.data() + rowFloats * slot;
+            if(scratch.filteredRowIndices[slot] != sourceRow)
+            {
+                DecodeRow(source + static_cast<size_t>(sourceRow) * width * 4, width, content, scratch.decodedRow.data());
+                FilterRow(scratch.decodedRow.data(), scratch.rowTable, nextWidth, filtered);
+                scratch.filteredRowIndices[slot] = sourceRow;
+            }
+
+            if(weights[t] != 0.0f) { AccumulateRow(scratch.outputRow.data(), filtered, weights[t], rowFloats); }
+        }
+
+        EncodeRow(scratch.outputRow.data(), nextWidth, content, destination + static_cast<size_t>(y) * nextWidth * 4);
+    }
+}
+
+n32 GetMipLevelCount(n32 width, n32 height) { return static_cast<n32>(std::floor(std::log2(std::max(width, height)))) + 1; }
+
+size_t GetMipLevelOffset(n32 width, n32 height, n32 level)
+{
+    size_t offset = 0;
+    for(n32 l = 0; l < level; l++) { offset += static_cast<size_t>(std::max(width >> l, 1u)) * std::max(height >> l, 1u) * 4; }
+    return offset;
+}
+
+size_t GetMipChainSize(n32 width, n32 height) { return GetMipLevelOffset(width, height, GetMipLevelCount(width, height)); }
+
+void BuildMipChain(const n8* rgba, n32 width, n32 height, MipContent content, MipFilter filter, n8* out)
+{
+    if(rgba != out) { std::memcpy(out, rgba, static_cast<size_t>(width) * height * 4); }
+
+    // every level is filtered from the 8 bit level above it, which keeps the working set down to a handful of rows
+    MipScratch scratch;
+    const n32  levelCount = GetMipLevelCount(width, height);
+    n32        levelWidth = width, levelHeight = height;
+    n8*        level = out;
+    for(n32 l = 1; l < levelCount; l++)
+    {
+        const n32 nextWidth = std::max<n32>(levelWidth / 2, 1), nextHeight = std::max<n32>(levelHeight / 2, 1);
+        n8*       nextLevel = level + static_cast<size_t>(levelWidth) * levelHeight * 4;
+        DownsampleLevel(level, levelWidth, levelHeight, nextWidth, nextHeight, content, filter, scratch, nextLevel);
+
+        level = nextLevel;
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+}
+
+} // namespace Utils
+} // namespace Humongous
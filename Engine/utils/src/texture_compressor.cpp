@@ -0,0 +1,377 @@
+#include "texture_compressor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Humongous::Utils
+{
+
+// 16 pixels in row order, clamped to the image edge for blocks hanging over it
+static void FetchBlock(const n8* rgba, n32 width, n32 height, n32 blockX, n32 blockY, n8 block[64])
+{
+    for(n32 y = 0; y < 4; y++)
+    {
+        const n32 sy = std::min(blockY * 4 + y, height - 1);
+        for(n32 x = 0; x < 4; x++)
+        {
+            const n32 sx = std::min(blockX * 4 + x, width - 1);
+            std::memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+        }
+    }
+}
+
+static n16 PackRGB565(const s32 color[3]) { return static_cast<n16>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3)); }
+
+static void UnpackRGB565(n16 packed, s32 color[3])
+{
+    const s32 r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// bounding box endpoints (van Waveren, Real-Time DXT Compression), inset a little and flipped onto the diagonal the colors lie along
+static void EncodeBC1Block(const n8 block[64], n8 out[8])
+{
+    s32 minColor[3] = {255, 255, 255}, maxColor[3] = {0, 0, 0};
+    s32 center[3] = {0, 0, 0};
+    for(n32 i = 0; i < 16; i++)
+    {
+        for(n32 c = 0; c < 3; c++)
+        {
+            minColor[c] = std::min<s32>(minColor[c], block[i * 4 + c]);
+            maxColor[c] = std::max<s32>(maxColor[c], block[i * 4 + c]);
+            center[c] += block[i * 4 + c];
+        }
+    }
+
+    s32 covarianceRG = 0, covarianceRB = 0;
+    for(n32 i = 0; i < 16; i++)
+    {
+        const s32 r = block[i * 4 + 0] * 16 - center[0];
+        covarianceRG += r * (block[i * 4 + 1] * 16 - center[1]);
+        covarianceRB += r * (block[i * 4 + 2] * 16 - center[2]);
+    }
+    if(covarianceRG < 0) { std::swap(minColor[1], maxColor[1]); }
+    if(covarianceRB < 0) { std::swap(minColor[2], maxColor[2]); }
+
+    for(n32 c = 0; c < 3; c++)
+    {
+        const s32 inset = (maxColor[c] - minColor[c]) / 16;
+        maxColor[c] = std::clamp(maxColor[c] - inset, 0, 255);
+        minColor[c] = std::clamp(minColor[c] + inset, 0, 255);
+    }
+
+    n16 color0 = PackRGB565(maxColor);
+    n16 color1 = PackRGB565(minColor);
+    // color0 > color1 selects the four color mode, the palette is symmetric so swapping the endpoints is free
+    if(color0 < color1) { std::swap(color0, color1); }
+
+    n32 indices = 0;
+    if(color0 != color1)
+    {
+        s32 palette[4][3];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+        for(n32 c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for(n32 i = 0; i < 16; i++)
+        {
+            n32 best = 0;
+            s32 bestDistance = INT32_MAX;
+            for(n32 p = 0; p < 4; p++)
+            {
+                s32 distance = 0;
+                for(n32 c = 0; c < 3; c++)
+                {
+                    const s32 d = block[i * 4 + c] - palette[p][c];
+                    distance += d * d;
+                }
+                if(distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+
+    std::memcpy(out, &color0, 2);
+    std::memcpy(out + 2, &color1, 2);
+    std::memcpy(out + 4, &indices, 4);
+}
+
+// one channel of the block, channel is the byte offset inside each pixel. always uses the eight value mode
+static void EncodeBC4Block(const n8 block[64], n32 channel, n8 out[8])
+{
+    s32 minValue = 255, maxValue = 0;
+    for(n32 i = 0; i < 16; i++)
+    {
+        minValue = std::min<s32>(minValue, block[i * 4 + channel]);
+        maxValue = std::max<s32>(maxValue, block[i * 4 + channel]);
+    }
+
+    out[0] = static_cast<n8>(maxValue);
+    out[1] = static_cast<n8>(minValue);
+
+    n64 indices = 0;
+    if(maxValue > minValue)
+    {
+        const s32 range = maxValue - minValue;
+        for(n32 i = 0; i < 16; i++)
+        {
+            // 0 is the max endpoint and 7 the min one, the six values in between are indices 2 to 7 in the format
+            const s32 step = ((maxValue - block[i * 4 + channel]) * 7 + range / 2) / range;
+            const n64 index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            indices |= index << (i * 3);
+        }
+    }
+
+    for(n32 i = 0; i < 6; i++) { out[2 + i] = static_cast<n8>(indices >> (i * 8)); }
+}
+
+// color0 <= color1 selects the three color mode with transparent black, blocks that carry their own alpha always use four colors
+static void DecodeBC1Block(const n8 in[8], bool allowThreeColor, n8 block[64])
+{
+    n16 color0, color1;
+    n32 indices;
+    std::memcpy(&color0, in, 2);
+    std::memcpy(&color1, in + 2, 2);
+    std::memcpy(&indices, in + 4, 4);
+
+    s32 palette[4][4];
+    UnpackRGB565(color0, palette[0]);
+    UnpackRGB565(color1, palette[1]);
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+    for(n32 c = 0; c < 3; c++)
+    {
+        if(color0 > color1 || !allowThreeColor)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    if(color0 <= color1 && allowThreeColor) { palette[3][3] = 0; }
+
+    for(n32 i = 0; i < 16; i++)
+    {
+        const n32 index = (indices >> (i * 2)) & 3;
+        for(n32 c = 0; c < 4; c++) { block[i * 4 + c] = static_cast<n8>(palette[index][c]); }
+    }
+}
+
+// writes one channel of the block, channel is the byte offset inside each pixel
+static void DecodeBC4Block(const n8 in[8], n32 channel, n8 block[64])
+{
+    s32 values[8];
+    values[0] = in[0];
+    values[1] = in[1];
+    if(values[0] > values[1])
+    {
+        for(n32 i = 1; i < 7; i++) { values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7; }
+    }
+    else
+    {
+        for(n32 i = 1; i < 5; i++) { values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5; }
+        values[6] = 0;
+        values[7] = 255;
+    }
+
+    n64 indices = 0;
+    for(n32 i = 0; i < 6; i++) { indices |= static_cast<n64>(in[2 + i]) << (i * 8); }
+    for(n32 i = 0; i < 16; i++) { block[i * 4 + channel] = static_cast<n8>(values[(indices >> (i * 3)) & 7]); }
+}
+
+n32 GetBlockSize(VkFormat format)
+{
+    switch(format)
+    {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+MipContent GetMipContent(TextureRole role)
+{
+    switch(role)
+    {
+        case TextureRole::COLOR:
+            return MipContent::COLOR;
+        case TextureRole::NORMAL:
+            return MipContent::NORMAL;
+        default:
+            return MipContent::LINEAR;
+    }
+}
+
+CompressedImage CompressImage(const n8* rgba, n32 width, n32 height, TextureRole role, MipFilter mipFilter)
+{
+    CompressedImage result{};
+    result.width = width;
+    result.height = height;
+
+    switch(role)
+    {
+        case TextureRole::NORMAL:
+            result.format = VK_FORMAT_BC5_UNORM_BLOCK;
+            break;
+        case TextureRole::OCCLUSION:
+            result.format = VK_FORMAT_BC4_UNORM_BLOCK;
+            break;
+        case TextureRole::COLOR:
+        case TextureRole::DATA:
+        {
+            bool opaque = true;
+            const size_t pixelCount = static_cast<size_t>(width) * height;
+            for(size_t i = 0; i < pixelCount && opaque; i++) { opaque = rgba[i * 4 + 3] == 0xFF; }
+            result.format = opaque ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+            break;
+        }
+    }
+
+    const n32 blockSize = GetBlockSize(result.format);
+    const n32 levelCount = GetMipLevelCount(width, height);
+
+    // every level is reserved up front, a full chain adds up to a third of the top level
+    const size_t topLevelSize = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+    result.data.reserve(topLevelSize + topLevelSize / 3 + static_cast<size_t>(levelCount) * blockSize);
+
+    std::vector<n8> mips(GetMipChainSize(width, height));
+    BuildMipChain(rgba, width, height, GetMipContent(role), mipFilter, mips.data());
+
+    for(n32 l = 0; l < levelCount; l++)
+    {
+        const n32    levelWidth = std::max(width >> l, 1u), levelHeight = std::max(height >> l, 1u);
+        const n8*    level = mips.data() + GetMipLevelOffset(width, height, l);
+        const n32    blocksX = (levelWidth + 3) / 4, blocksY = (levelHeight + 3) / 4;
+        const size_t offset = result.data.size();
+        result.levelOffsets.push_back(offset);
+        result.levelSizes.push_back(static_cast<VkDeviceSize>(blocksX) * blocksY * blockSize);
+        result.data.resize(offset + result.levelSizes.back());
+
+        n8* out = result.data.data() + offset;
+        n8  block[64];
+        for(n32 by = 0; by < blocksY; by++)
+        {
+            for(n32 bx = 0; bx < blocksX; bx++)
+            {
+                FetchBlock(level, levelWidth, levelHeight, bx, by, block);
+                switch(result.format)
+                {
+                    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                        EncodeBC1Block(block, out);
+                        break;
+                    case VK_FORMAT_BC3_UNORM_BLOCK:
+                        EncodeBC4Block(block, 3, out);
+                        EncodeBC1Block(block, out + 8);
+                        break;
+                    case VK_FORMAT_BC4_UNORM_BLOCK:
+                        EncodeBC4Block(block, 0, out);
+                        break;
+                    case VK_FORMAT_BC5_UNORM_BLOCK:
+                        EncodeBC4Block(block, 0, out);
+                        EncodeBC4Block(block, 1, out + 8);
+                        break;
+                    default:
+                        break;
+                }
+                out += blockSize;
+            }
+        }
+    }
+
+    return result;
+}
+
+bool DecompressImage(VkFormat format, const n8* blocks, n32 width, n32 height, n8* rgba)
+{
+    n32 blockSize = 0;
+    switch(format)
+    {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            blockSize = 8;
+            break;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            blockSize = 16;
+            break;
+        default:
+            return false;
+    }
+
+    const n32 blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    n8        block[64];
+    for(n32 by = 0; by < blocksY; by++)
+    {
+        for(n32 bx = 0; bx < blocksX; bx++)
+        {
+            const n8* in = blocks + (static_cast<size_t>(by) * blocksX + bx) * blockSize;
+            switch(format)
+            {
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                    DecodeBC1Block(in, true, block);
+                    for(n32 i = 0; i < 16; i++) { block[i * 4 + 3] = 255; }
+                    break;
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                    DecodeBC1Block(in, true, block);
+                    break;
+                case VK_FORMAT_BC2_UNORM_BLOCK:
+                case VK_FORMAT_BC2_SRGB_BLOCK:
+                    DecodeBC1Block(in + 8, false, block);
+                    for(n32 i = 0; i < 16; i++) { block[i * 4 + 3] = static_cast<n8>(((in[i / 2] >> ((i % 2) * 4)) & 15) * 17); }
+                    break;
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK:
+                    DecodeBC1Block(in + 8, false, block);
+                    DecodeBC4Block(in, 3, block);
+                    break;
+                case VK_FORMAT_BC4_UNORM_BLOCK:
+                    DecodeBC4Block(in, 0, block);
+                    for(n32 i = 0; i < 16; i++) { block[i * 4 + 1] = block[i * 4 + 2] = 0; block[i * 4 + 3] = 255; }
+                    break;
+                default:
+                    DecodeBC4Block(in, 0, block);
+                    DecodeBC4Block(in + 8, 1, block);
+                    for(n32 i = 0; i < 16; i++) { block[i * 4 + 2] = 0; block[i * 4 + 3] = 255; }
+                    break;
+            }
+
+            // blocks hanging over the edge of the image only write the pixels inside it
+            for(n32 y = 0; y < 4 && by * 4 + y < height; y++)
+            {
+                const n32 columns = std::min<n32>(4, width - bx * 4);
+                std::memcpy(rgba + ((static_cast<size_t>(by) * 4 + y) * width + bx * 4) * 4, block + y * 16, columns * 4);
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace Humongous::Utils
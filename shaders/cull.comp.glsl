@@ -0,0 +1,216 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+// one invocation per primitive of every object of a model that survived the cpu's broad phase. visible primitives are compacted
+// into the indirect commands of the list their index type belongs to, the draws then go out with vkCmdDrawIndexedIndirectCount.
+// see GpuCuller
+layout(local_size_x = 64) in;
+
+// Model::GpuPrimitive
+struct GpuPrimitive {
+    vec4 sphere;
+    uint meshIndex;
+    uint list;
+    uint count;
+    uint first;
+    int vertexOffset;
+    uint firstLod;
+    uint lodCount;
+    uint padding;
+};
+
+// Model::GpuLod
+struct GpuLod {
+    uint list;
+    uint count;
+    uint first;
+    int vertexOffset;
+    float error;
+    float coverage;
+    uint padding0;
+    uint padding1;
+};
+
+// Mesh::UniformBlock
+struct MeshData {
+    mat4 matrix;
+    vec4 dequantOffset;
+    vec4 dequantScale;
+};
+
+layout(buffer_reference, std430) readonly buffer GpuPrimitives
+{
+    GpuPrimitive primitives[];
+};
+
+layout(buffer_reference, std430) readonly buffer GpuLods
+{
+    GpuLod lods[];
+};
+
+layout(buffer_reference, std430) readonly buffer Meshes
+{
+    MeshData meshes[];
+};
+
+layout(buffer_reference, std430) readonly buffer ObjectMatrices
+{
+    mat4 matrices[];
+};
+
+// indices into ObjectMatrices, grouped by model
+layout(buffer_reference, std430) readonly buffer Instances
+{
+    uint indices[];
+};
+
+// VkDrawIndexedIndirectCommand, non indexed draws use the first four words as a VkDrawIndirectCommand
+layout(buffer_reference, std430) writeonly buffer Commands
+{
+    uint words[];
+};
+
+// object index, draw index
+layout(buffer_reference, std430) writeonly buffer DrawRecords
+{
+    uvec2 records[];
+};
+
+// GpuCuller::Stats followed by three draw counts per model and a visibility flag per instance
+layout(buffer_reference, std430) buffer Counts
+{
+    uint counts[];
+};
+
+// GpuCuller::PushConstants
+layout(push_constant) uniform Cull
+{
+    GpuPrimitives primitives;
+    GpuLods lods;
+    Meshes meshes;
+    ObjectMatrices objects;
+    Instances instances;
+    Commands commands;
+    DrawRecords records;
+    Counts counts;
+    uint firstInstance;
+    uint instanceCount;
+    uint drawCount;
+    uint firstCommand; // list l of this model starts at firstCommand + l * maxDraws
+    uint maxDraws;
+    uint firstCount;
+    uint firstFlag;
+    float pixelsPerUnit;
+    float viewportHeight;
+    float lodErrorPixels;
+    float minPixels;
+} cull;
+
+layout(set = 0, binding = 0) uniform UBO
+{
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+    vec4 frustumPlanes[6];
+} ubo;
+
+const uint STAT_VISIBLE = 0;
+const uint STAT_CULLED = 1;
+const uint STAT_TRIANGLES = 2;
+const uint STAT_REDUCED_LODS = 3;
+const uint STAT_OBJECTS_VISIBLE = 4;
+
+void main()
+{
+    uint thread = gl_GlobalInvocationID.x;
+    if(thread >= cull.instanceCount * cull.drawCount) { return; }
+
+    uint instance = cull.firstInstance + thread / cull.drawCount;
+    uint object = cull.instances.indices[instance];
+    uint drawIndex = thread % cull.drawCount;
+
+    GpuPrimitive primitive = cull.primitives.primitives[drawIndex];
+
+    uint list = primitive.list;
+    uint count = primitive.count;
+    uint first = primitive.first;
+    int vertexOffset = primitive.vertexOffset;
+    bool reduced = false;
+
+    if(primitive.sphere.w >= 0.0)
+    {
+        // same as Model::DrawPrimitiveCulled, the sphere is scaled by the largest axis of the transform
+        mat4 transform = cull.objects.matrices[object] * cull.meshes.meshes[primitive.meshIndex].matrix;
+        float scale = sqrt(max(max(dot(transform[0].xyz, transform[0].xyz), dot(transform[1].xyz, transform[1].xyz)),
+                               dot(transform[2].xyz, transform[2].xyz)));
+        vec3 center = (transform * vec4(primitive.sphere.xyz, 1.0)).xyz;
+        float radius = primitive.sphere.w * scale;
+
+        for(uint i = 0; i < 6; i++)
+        {
+            if(dot(ubo.frustumPlanes[i].xyz, center) + ubo.frustumPlanes[i].w < -radius)
+            {
+                atomicAdd(cull.counts.counts[STAT_CULLED], 1u);
+                return;
+            }
+        }
+
+        float distance = length(center - ubo.camPos) - radius;
+        if(distance > 0.0 && cull.pixelsPerUnit > 0.0)
+        {
+            // pixels a world unit covers at the primitive's closest point
+            float pixels = cull.pixelsPerUnit / distance;
+            if(2.0 * radius * pixels < cull.minPixels)
+            {
+                atomicAdd(cull.counts.counts[STAT_CULLED], 1u);
+                return;
+            }
+
+            // coarsest level that is still good enough, see Model::SelectLod
+            for(uint l = primitive.firstLod + primitive.lodCount; l-- > primitive.firstLod;)
+            {
+                GpuLod lod = cull.lods.lods[l];
+                bool acceptable = lod.coverage > 0.0 ? 2.0 * radius * pixels < lod.coverage * cull.viewportHeight
+                                                     : lod.error * scale * pixels <= cull.lodErrorPixels;
+                if(acceptable)
+                {
+                    list = lod.list;
+                    count = lod.count;
+                    first = lod.first;
+                    vertexOffset = lod.vertexOffset;
+                    reduced = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    uint slot = atomicAdd(cull.counts.counts[cull.firstCount + list], 1u);
+    uint command = cull.firstCommand + list * cull.maxDraws + slot;
+
+    // firstInstance points the vertex shader at the record, it finds the object's matrix and the draw index there
+    uint base = command * 5;
+    if(list < 2)
+    {
+        cull.commands.words[base + 0] = count;
+        cull.commands.words[base + 1] = 1;
+        cull.commands.words[base + 2] = first;
+        cull.commands.words[base + 3] = uint(vertexOffset);
+        cull.commands.words[base + 4] = command;
+    }
+    else
+    {
+        cull.commands.words[base + 0] = count;
+        cull.commands.words[base + 1] = 1;
+        cull.commands.words[base + 2] = first;
+        cull.commands.words[base + 3] = command;
+    }
+    cull.records.records[command] = uvec2(object, drawIndex);
+
+    atomicAdd(cull.counts.counts[STAT_VISIBLE], 1u);
+    atomicAdd(cull.counts.counts[STAT_TRIANGLES], count / 3);
+    if(reduced) { atomicAdd(cull.counts.counts[STAT_REDUCED_LODS], 1u); }
+
+    // the first visible primitive counts its object
+    if(atomicExchange(cull.counts.counts[cull.firstFlag + instance], 1u) == 0u) { atomicAdd(cull.counts.counts[STAT_OBJECTS_VISIBLE], 1u); }
+}
@@ -0,0 +1,7 @@
+// every material texture lives in one global array, the material says which image and which sampler to combine.
+// needs GL_EXT_nonuniform_qualifier for the runtime sized arrays. the indices come from the material, which can change within a wave
+layout(set = 2, binding = 0) uniform texture2D bindlessTextures[];
+layout(set = 2, binding = 1) uniform sampler bindlessSamplers[];
+
+#define BINDLESS_TEXTURE(textureIndex, samplerIndex) \
+    sampler2D(bindlessTextures[nonuniformEXT(textureIndex)], bindlessSamplers[nonuniformEXT(samplerIndex)])
@@ -0,0 +1,39 @@
+// what the model being drawn knows about its meshes and primitives, see Model::CreateDrawBuffers.
+// every draw passes its primitive's draw index in as firstInstance
+
+// Mesh::UniformBlock
+struct MeshData {
+    mat4 matrix;
+    vec4 dequantOffset;
+    vec4 dequantScale;
+};
+
+// Model::DrawData
+struct DrawData {
+    uint meshIndex;
+    uint materialIndex;
+};
+
+layout(std430, set = 4, binding = 0) readonly buffer Meshes
+{
+    MeshData meshes[];
+};
+
+layout(std430, set = 4, binding = 1) readonly buffer Draws
+{
+    DrawData draws[];
+};
+
+// set when the draws come out of cull.comp.glsl, firstInstance then indexes a record the culling pass wrote, see GpuCuller
+layout(constant_id = 0) const bool GPU_CULLED = false;
+
+// object index, draw index
+layout(buffer_reference, std430) readonly buffer DrawRecords
+{
+    uvec2 records[];
+};
+
+layout(buffer_reference, std430) readonly buffer ObjectMatrices
+{
+    mat4 matrices[];
+};
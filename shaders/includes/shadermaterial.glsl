@@ -14,4 +14,15 @@ struct ShaderMaterial {
 	float alphaMask;	
 	float alphaMaskCutoff;
 	float emissiveStrength;
+	// slots in the bindless arrays, see includes/bindless.glsl
+	uint colorTexture;
+	uint colorSampler;
+	uint physicalDescriptorTexture;
+	uint physicalDescriptorSampler;
+	uint normalTexture;
+	uint normalSampler;
+	uint occlusionTexture;
+	uint occlusionSampler;
+	uint emissiveTexture;
+	uint emissiveSampler;
 };
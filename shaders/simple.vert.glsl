@@ -10,6 +10,7 @@ layout(location = 2) out vec4 outColor;
 layout(location = 3) out vec3 worldPosition;
 layout(location = 4) out vec3 outNormal;
 layout(location = 5) out vec3 camPos;
+layout(location = 6) flat out uint outMaterialIndex;
 
 struct Vertex {
     vec3 position;
@@ -24,10 +25,14 @@ layout(buffer_reference, std140) readonly buffer VertexBuffer
     Vertex vertices[];
 };
 
+#include "includes/draw_data.glsl"
+
 layout(push_constant) uniform MNV
 {
     mat4 modelMatrix;
     VertexBuffer vertexBuffer;
+    DrawRecords drawRecords;
+    ObjectMatrices objectMatrices;
 } mnv;
 
 layout(set = 0, binding = 0) uniform UBO
@@ -37,24 +42,31 @@ layout(set = 0, binding = 0) uniform UBO
     vec3 camPos;
 } ubo;
 
-layout(set = 4, binding = 0) uniform UBONode {
-    mat4 matrix;
-    // mat4 jointMatrix[MAX_NUM_JOINTS];
-    // float jointCount;
-} node;
-
 void main()
 {
+    mat4 modelMatrix = mnv.modelMatrix;
+    uint drawIndex = gl_InstanceIndex;
+    if(GPU_CULLED)
+    {
+        uvec2 record = mnv.drawRecords.records[gl_InstanceIndex];
+        modelMatrix = mnv.objectMatrices.matrices[record.x];
+        drawIndex = record.y;
+    }
+
+    DrawData draw = draws[drawIndex];
+    MeshData node = meshes[draw.meshIndex];
+
     Vertex v = mnv.vertexBuffer.vertices[gl_VertexIndex];
 
-    vec4 locPos = ubo.projection * ubo.view * mnv.modelMatrix * node.matrix * vec4(v.position, 1.0);
+    vec4 locPos = ubo.projection * ubo.view * modelMatrix * node.matrix * vec4(v.position, 1.0);
     gl_Position = locPos;
 
-    worldPosition = (mnv.modelMatrix * vec4(v.position, 1.0)).xyz;
-    outNormal = normalize(transpose(inverse(mat3(mnv.modelMatrix * node.matrix))) * v.normal);
+    worldPosition = (modelMatrix * vec4(v.position, 1.0)).xyz;
+    outNormal = normalize(transpose(inverse(mat3(modelMatrix * node.matrix))) * v.normal);
 
     outUV0 = v.uv1;
     outUV1 = v.uv2;
     outColor = v.color;
     camPos = ubo.camPos;
+    outMaterialIndex = draw.materialIndex;
 }
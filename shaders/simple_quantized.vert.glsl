@@ -0,0 +1,77 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "includes/vertex_decode.glsl"
+
+layout(location = 0) out vec2 outUV0;
+layout(location = 1) out vec2 outUV1;
+layout(location = 2) out vec4 outColor;
+layout(location = 3) out vec3 worldPosition;
+layout(location = 4) out vec3 outNormal;
+layout(location = 5) out vec3 camPos;
+layout(location = 6) flat out uint outMaterialIndex;
+
+// Model::QuantizedVertex, 24 bytes
+struct QuantizedVertex {
+    uint positionXY;
+    uint positionZ;
+    uint normal;
+    uint uv0;
+    uint uv1;
+    uint color;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer
+{
+    QuantizedVertex vertices[];
+};
+
+#include "includes/draw_data.glsl"
+
+layout(push_constant) uniform MNV
+{
+    mat4 modelMatrix;
+    VertexBuffer vertexBuffer;
+    DrawRecords drawRecords;
+    ObjectMatrices objectMatrices;
+} mnv;
+
+layout(set = 0, binding = 0) uniform UBO
+{
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+} ubo;
+
+void main()
+{
+    mat4 modelMatrix = mnv.modelMatrix;
+    uint drawIndex = gl_InstanceIndex;
+    if(GPU_CULLED)
+    {
+        uvec2 record = mnv.drawRecords.records[gl_InstanceIndex];
+        modelMatrix = mnv.objectMatrices.matrices[record.x];
+        drawIndex = record.y;
+    }
+
+    DrawData draw = draws[drawIndex];
+    MeshData node = meshes[draw.meshIndex];
+
+    QuantizedVertex v = mnv.vertexBuffer.vertices[gl_VertexIndex];
+    vec3 quantized = vec3(unpackUnorm2x16(v.positionXY), unpackUnorm2x16(v.positionZ).x);
+    vec3 position = node.dequantOffset.xyz + node.dequantScale.xyz * quantized;
+    vec3 normal = DecodeOctahedral(v.normal);
+
+    vec4 locPos = ubo.projection * ubo.view * modelMatrix * node.matrix * vec4(position, 1.0);
+    gl_Position = locPos;
+
+    worldPosition = (modelMatrix * vec4(position, 1.0)).xyz;
+    outNormal = normalize(transpose(inverse(mat3(modelMatrix * node.matrix))) * normal);
+
+    outUV0 = unpackHalf2x16(v.uv0);
+    outUV1 = unpackHalf2x16(v.uv1);
+    outColor = unpackUnorm4x8(v.color);
+    camPos = ubo.camPos;
+    outMaterialIndex = draw.materialIndex;
+}
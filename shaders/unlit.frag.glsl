@@ -1,5 +1,6 @@
 #version 450
 #extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec2 inUV0;
 layout(location = 1) in vec2 inUV1;
@@ -7,31 +8,30 @@ layout(location = 2) in vec4 inColor0;
 layout(location = 3) in vec3 inWorldPos;
 layout(location = 4) in vec3 inNormal;
 layout(location = 5) in vec3 inCamPos;
+layout(location = 6) flat in uint inMaterialIndex;
 
 layout(location = 0) out vec4 outColor;
 
 // Textures
 
-layout(set = 2, binding = 0) uniform sampler2D colorMap;
-layout(set = 2, binding = 1) uniform sampler2D physicalDescriptorMap;
-layout(set = 2, binding = 2) uniform sampler2D normalMap;
-layout(set = 2, binding = 3) uniform sampler2D aoMap;
-layout(set = 2, binding = 4) uniform sampler2D emissiveMap;
+#include "includes/bindless.glsl"
 
 // Properties
 
 #include "includes/shadermaterial.glsl"
 
+// the material's textures, only valid where a ShaderMaterial called material is in scope
+#define colorMap BINDLESS_TEXTURE(material.colorTexture, material.colorSampler)
+#define physicalDescriptorMap BINDLESS_TEXTURE(material.physicalDescriptorTexture, material.physicalDescriptorSampler)
+#define normalMap BINDLESS_TEXTURE(material.normalTexture, material.normalSampler)
+#define aoMap BINDLESS_TEXTURE(material.occlusionTexture, material.occlusionSampler)
+#define emissiveMap BINDLESS_TEXTURE(material.emissiveTexture, material.emissiveSampler)
+
 layout(std430, set = 3, binding = 0) readonly buffer SSBO
 {
     ShaderMaterial materials[];
 };
 
-layout(push_constant) uniform Push
-{
-    layout(offset = 80) uint materialIndex;
-} push;
-
 layout(set = 1, binding = 0) uniform UBOParams {
     vec4 lightDir;
     float exposure;
@@ -46,7 +46,7 @@ layout(set = 1, binding = 0) uniform UBOParams {
 
 void main()
 {
-    ShaderMaterial material = materials[push.materialIndex];
+    ShaderMaterial material = materials[inMaterialIndex];
     vec4 baseColor;
 
     vec2 uv = material.baseColorTextureSet == 0 ? inUV0 : inUV1;